@@ -0,0 +1,94 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "async.hpp"
+
+#include "error.hpp"
+
+#include <glog/logging.h>
+
+#include <cerrno>
+
+#ifdef _WIN32
+# include <winsock2.h>
+# define poll WSAPoll
+#else
+# include <poll.h>
+#endif
+
+namespace mypp
+{
+
+AsyncOperation::AsyncOperation (MYSQL* h, std::unique_ptr<Impl> i)
+  : handle(h), impl(std::move (i))
+{
+  status = impl->Start ();
+}
+
+int
+AsyncOperation::GetSocket () const
+{
+  return mysql_get_socket (handle);
+}
+
+unsigned
+AsyncOperation::GetTimeoutMs () const
+{
+  return mysql_get_timeout_value_ms (handle);
+}
+
+void
+AsyncOperation::Continue (const int ready)
+{
+  CHECK (!IsDone ()) << "Async operation is already done";
+  status = impl->Continue (ready);
+}
+
+void
+AsyncOperation::Wait ()
+{
+  while (!IsDone ())
+    {
+      pollfd pfd;
+      pfd.fd = GetSocket ();
+      pfd.events = 0;
+      pfd.revents = 0;
+      if (status & MYSQL_WAIT_READ)
+        pfd.events |= POLLIN;
+      if (status & MYSQL_WAIT_WRITE)
+        pfd.events |= POLLOUT;
+      if (status & MYSQL_WAIT_EXCEPT)
+        pfd.events |= POLLPRI;
+
+      const int timeout = HasTimeout () ? GetTimeoutMs () : -1;
+      const int rc = poll (&pfd, 1, timeout);
+      if (rc < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          throw Error ("Failed to poll the MySQL socket");
+        }
+
+      int ready = 0;
+      if (rc == 0)
+        ready |= MYSQL_WAIT_TIMEOUT;
+      if (pfd.revents & (POLLIN | POLLERR | POLLHUP))
+        ready |= MYSQL_WAIT_READ;
+      if (pfd.revents & POLLOUT)
+        ready |= MYSQL_WAIT_WRITE;
+      if (pfd.revents & POLLPRI)
+        ready |= MYSQL_WAIT_EXCEPT;
+
+      Continue (ready);
+    }
+}
+
+bool
+AsyncOperation::GetResult () const
+{
+  CHECK (IsDone ()) << "Async operation is not done yet";
+  return impl->GetResult ();
+}
+
+} // namespace mypp
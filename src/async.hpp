@@ -0,0 +1,158 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_ASYNC_HPP
+#define MYPP_ASYNC_HPP
+
+#include <mysql.h>
+
+#include <memory>
+
+namespace mypp
+{
+
+/**
+ * A non-blocking database operation in progress, based on the _start/_cont
+ * functions of the MariaDB connector.  The operation is started when the
+ * instance is created (e.g. by Statement::ExecuteAsync).  Whenever it would
+ * block, control returns to the caller, who can then wait for the socket to
+ * become ready (e.g. in an event loop together with other connections) and
+ * continue the operation afterwards.
+ *
+ * This requires the connection to have non-blocking mode enabled (see
+ * Connection::EnableNonBlocking).  While an operation is in progress,
+ * the connection and statement it refers to must not be used for
+ * anything else, and they must outlive this instance.
+ */
+class AsyncOperation
+{
+
+public:
+
+  /**
+   * Interface for the implementation of a particular operation.
+   */
+  class Impl
+  {
+
+  public:
+
+    Impl () = default;
+    virtual ~Impl () = default;
+
+    /**
+     * Starts the operation.  Returns the wait status for the MySQL
+     * socket (a combination of MYSQL_WAIT_* flags), which is zero if the
+     * operation completed right away.  Throws mypp::Error if it fails.
+     */
+    virtual int Start () = 0;
+
+    /**
+     * Continues the operation after the socket is ready.  ready are the
+     * MYSQL_WAIT_* events that occurred.  Returns the new wait status.
+     */
+    virtual int Continue (int ready) = 0;
+
+    /**
+     * Returns the boolean result of the operation after it is done,
+     * for operations that have one (like fetching a row).
+     */
+    virtual bool
+    GetResult () const
+    {
+      return true;
+    }
+
+  };
+
+private:
+
+  /** The MySQL connection handle the operation is on.  */
+  MYSQL* handle;
+
+  /** The actual implementation.  */
+  std::unique_ptr<Impl> impl;
+
+  /** The current wait status.  */
+  int status;
+
+public:
+
+  /**
+   * Starts the operation given by the implementation.
+   */
+  explicit AsyncOperation (MYSQL* h, std::unique_ptr<Impl> i);
+
+  AsyncOperation (AsyncOperation&&) = default;
+  AsyncOperation& operator= (AsyncOperation&&) = default;
+
+  AsyncOperation (const AsyncOperation&) = delete;
+  void operator= (const AsyncOperation&) = delete;
+
+  /**
+   * Returns true if the operation has completed.
+   */
+  bool
+  IsDone () const
+  {
+    return status == 0;
+  }
+
+  /**
+   * Returns the socket file descriptor that the operation waits on.
+   */
+  int GetSocket () const;
+
+  /**
+   * Returns the MYSQL_WAIT_READ, MYSQL_WAIT_WRITE and MYSQL_WAIT_EXCEPT
+   * events the operation is waiting for.
+   */
+  int
+  GetWaitEvents () const
+  {
+    return status & (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE | MYSQL_WAIT_EXCEPT);
+  }
+
+  /**
+   * Returns true if the operation wants to be continued with
+   * MYSQL_WAIT_TIMEOUT after GetTimeoutMs, in case the socket does not
+   * become ready before.
+   */
+  bool
+  HasTimeout () const
+  {
+    return (status & MYSQL_WAIT_TIMEOUT) != 0;
+  }
+
+  /**
+   * Returns the timeout in milliseconds if HasTimeout is true.
+   */
+  unsigned GetTimeoutMs () const;
+
+  /**
+   * Continues the operation after some of the events it waits for have
+   * happened.  ready is the combination of MYSQL_WAIT_* flags for those
+   * events (or MYSQL_WAIT_TIMEOUT if the timeout expired).  Throws
+   * mypp::Error if the operation fails.
+   */
+  void Continue (int ready);
+
+  /**
+   * Blocks the calling thread until the operation is done, waiting
+   * for the socket with poll.
+   */
+  void Wait ();
+
+  /**
+   * Returns the boolean result of the completed operation, for operations
+   * that have one.  For Statement::FetchAsync, this is whether a row
+   * was fetched (like the return value of Statement::Fetch).
+   */
+  bool GetResult () const;
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_ASYNC_HPP
@@ -0,0 +1,227 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bulkload.hpp"
+
+#include "error.hpp"
+
+#include <errmsg.h>
+#include <mysql.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace mypp
+{
+
+/* ************************************************************************** */
+
+void
+BulkLoader::RowWriter::StartValue ()
+{
+  if (inRow)
+    buf.push_back ('\t');
+  inRow = true;
+}
+
+void
+BulkLoader::RowWriter::AddNull ()
+{
+  StartValue ();
+  buf.append ("\\N");
+}
+
+void
+BulkLoader::RowWriter::AddInt (const int64_t val)
+{
+  StartValue ();
+  buf.append (std::to_string (val));
+}
+
+void
+BulkLoader::RowWriter::AddUnsigned (const uint64_t val)
+{
+  StartValue ();
+  buf.append (std::to_string (val));
+}
+
+void
+BulkLoader::RowWriter::AddDouble (const double val)
+{
+  StartValue ();
+
+  /* 17 significant digits are enough to represent every double exactly.  */
+  char tmp[32];
+  const int len = std::snprintf (tmp, sizeof (tmp), "%.17g", val);
+  CHECK (len > 0 && static_cast<size_t> (len) < sizeof (tmp));
+  buf.append (tmp, len);
+}
+
+void
+BulkLoader::RowWriter::AddString (const std::string_view val)
+{
+  StartValue ();
+
+  /* The field and line separators as well as the escape character itself
+     have to be escaped.  NUL bytes are escaped as well, to be safe.  */
+  for (const char c : val)
+    switch (c)
+      {
+      case '\\':
+        buf.append ("\\\\");
+        break;
+      case '\t':
+        buf.append ("\\t");
+        break;
+      case '\n':
+        buf.append ("\\n");
+        break;
+      case '\r':
+        buf.append ("\\r");
+        break;
+      case '\0':
+        buf.append ("\\0");
+        break;
+      default:
+        buf.push_back (c);
+        break;
+      }
+}
+
+void
+BulkLoader::RowWriter::EndRow ()
+{
+  CHECK (inRow) << "Row without values";
+  buf.push_back ('\n');
+  inRow = false;
+}
+
+/* ************************************************************************** */
+
+BulkLoader::BulkLoader (Connection& c, const std::string& table,
+                        const std::vector<std::string>& columns)
+  : conn(c)
+{
+  CHECK (!columns.empty ()) << "No columns specified for BulkLoader";
+
+  /* The file name is not used by our handler, since the data comes from
+     the producer.  */
+  sql = "LOAD DATA LOCAL INFILE 'mypp-bulk-load'"
+        " INTO TABLE `" + table + "`"
+        " CHARACTER SET binary"
+        " FIELDS TERMINATED BY '\\t' ESCAPED BY '\\\\'"
+        " LINES TERMINATED BY '\\n'"
+        " (";
+  for (size_t i = 0; i < columns.size (); ++i)
+    {
+      if (i > 0)
+        sql += ", ";
+      sql += "`" + columns[i] + "`";
+    }
+  sql += ")";
+}
+
+void
+BulkLoader::SetChunkSize (const size_t sz)
+{
+  CHECK_GT (sz, 0u) << "Chunk size must be positive";
+  chunkSize = sz;
+}
+
+int
+BulkLoader::InfileInit (void** ptr, const char* filename, void* userdata)
+{
+  *ptr = userdata;
+  return 0;
+}
+
+int
+BulkLoader::InfileRead (void* ptr, char* buf, const unsigned len)
+{
+  auto* self = static_cast<BulkLoader*> (ptr);
+  try
+    {
+      return self->ReadData (buf, len);
+    }
+  catch (...)
+    {
+      self->producerError = std::current_exception ();
+      return -1;
+    }
+}
+
+void
+BulkLoader::InfileEnd (void* ptr)
+{
+  /* Nothing to clean up, the state is reset by Load.  */
+}
+
+int
+BulkLoader::InfileError (void* ptr, char* msg, const unsigned len)
+{
+  std::snprintf (msg, len, "Producer of BulkLoader failed");
+  return CR_UNKNOWN_ERROR;
+}
+
+size_t
+BulkLoader::ReadData (char* buf, const size_t len)
+{
+  while (buffer.size () - bufferPos < chunkSize && !producerDone)
+    {
+      /* Drop data that has been passed on already, so that the buffer
+         does not keep growing.  */
+      if (bufferPos > 0)
+        {
+          buffer.erase (0, bufferPos);
+          bufferPos = 0;
+        }
+
+      RowWriter w(buffer);
+      producerDone = !(*producer) (w);
+      CHECK (!w.inRow) << "Producer did not finish its last row";
+    }
+
+  const size_t n = std::min (len, buffer.size () - bufferPos);
+  std::memcpy (buf, buffer.data () + bufferPos, n);
+  bufferPos += n;
+
+  return n;
+}
+
+uint64_t
+BulkLoader::Load (const Producer& p)
+{
+  producer = &p;
+  buffer.clear ();
+  bufferPos = 0;
+  producerDone = false;
+  producerError = nullptr;
+
+  MYSQL* h = *conn;
+  mysql_set_local_infile_handler (h, &InfileInit, &InfileRead, &InfileEnd,
+                                  &InfileError, this);
+
+  try
+    {
+      conn.Execute (sql);
+    }
+  catch (const Error& exc)
+    {
+      mysql_set_local_infile_default (h);
+      producer = nullptr;
+      if (producerError != nullptr)
+        std::rethrow_exception (producerError);
+      throw;
+    }
+
+  mysql_set_local_infile_default (h);
+  producer = nullptr;
+
+  return mysql_affected_rows (h);
+}
+
+} // namespace mypp
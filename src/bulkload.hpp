@@ -0,0 +1,165 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_BULKLOAD_HPP
+#define MYPP_BULKLOAD_HPP
+
+#include "connection.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mypp
+{
+
+/**
+ * Fast path for loading many rows into a table with LOAD DATA LOCAL INFILE.
+ * The data is not read from a file, but generated by a producer function
+ * on the fly and streamed to the server directly, while the server asks
+ * for more of it.  This means that the producer is only called when the
+ * connection can actually send more data (so memory use is bounded by the
+ * chunk size), and that no temporary files are needed.
+ *
+ * The connection must have been set up with Connection::EnableLocalInfile.
+ */
+class BulkLoader
+{
+
+public:
+
+  /**
+   * Helper for writing rows of data in the format used by the loader, with
+   * the values properly escaped.  The values of each row must be added in
+   * the order of the columns, and then the row finished with EndRow.
+   */
+  class RowWriter
+  {
+
+  private:
+
+    /** The buffer the data is appended to.  */
+    std::string& buf;
+
+    /** Whether a value has been added to the current row already.  */
+    bool inRow = false;
+
+    explicit RowWriter (std::string& b)
+      : buf(b)
+    {}
+
+    /**
+     * Starts a new value, adding the separator if needed.
+     */
+    void StartValue ();
+
+    friend class BulkLoader;
+
+  public:
+
+    RowWriter (const RowWriter&) = delete;
+    void operator= (const RowWriter&) = delete;
+
+    void AddNull ();
+    void AddInt (int64_t val);
+    void AddUnsigned (uint64_t val);
+    void AddDouble (double val);
+
+    /**
+     * Adds a string or BLOB value.  It can hold arbitrary bytes.
+     */
+    void AddString (std::string_view val);
+
+    /**
+     * Finishes the current row.
+     */
+    void EndRow ();
+
+  };
+
+  /**
+   * Function that produces the rows to load.  It is called repeatedly and
+   * should write one or more complete rows each time, until it returns false
+   * to signal that there are no more rows.  (Rows written in the call
+   * returning false are still loaded.)  If it throws, loading is aborted
+   * and the exception rethrown from Load.
+   */
+  using Producer = std::function<bool (RowWriter& w)>;
+
+private:
+
+  /** The connection to use.  */
+  Connection& conn;
+
+  /** The LOAD DATA statement to execute.  */
+  std::string sql;
+
+  /**
+   * Size of data buffered from the producer before it is passed on to
+   * the connection.
+   */
+  size_t chunkSize = 1 << 16;
+
+  /** The producer of the current Load call.  */
+  const Producer* producer = nullptr;
+
+  /** The buffered data not yet passed to the connection.  */
+  std::string buffer;
+
+  /** Offset of the data in buffer that has not been passed on yet.  */
+  size_t bufferPos = 0;
+
+  /** Set when the producer has signalled that it is done.  */
+  bool producerDone = false;
+
+  /** Exception thrown by the producer, if any.  */
+  std::exception_ptr producerError;
+
+  /** The callbacks for mysql_set_local_infile_handler.  */
+  static int InfileInit (void** ptr, const char* filename, void* userdata);
+  static int InfileRead (void* ptr, char* buf, unsigned len);
+  static void InfileEnd (void* ptr);
+  static int InfileError (void* ptr, char* msg, unsigned len);
+
+  /**
+   * Copies up to len bytes of data to buf, calling the producer as needed
+   * to fill the buffer up.  Returns the number of bytes copied, which is
+   * zero once all data has been sent.
+   */
+  size_t ReadData (char* buf, size_t len);
+
+public:
+
+  /**
+   * Constructs a loader for the given table and list of columns.  Each row
+   * written by the producer must have values for exactly these columns.
+   */
+  explicit BulkLoader (Connection& c, const std::string& table,
+                       const std::vector<std::string>& columns);
+
+  BulkLoader (const BulkLoader&) = delete;
+  void operator= (const BulkLoader&) = delete;
+
+  /**
+   * Sets the size of data that is buffered from the producer before it is
+   * sent on.  Larger chunks reduce the overhead per call, smaller ones
+   * the memory use.
+   */
+  void SetChunkSize (size_t sz);
+
+  /**
+   * Loads all rows from the given producer into the table.  Returns the
+   * number of rows inserted.  Throws mypp::Error if the query fails.
+   */
+  uint64_t Load (const Producer& p);
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_BULKLOAD_HPP
@@ -0,0 +1,173 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bulkload.hpp"
+
+#include "error.hpp"
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+#include "url.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace mypp
+{
+namespace
+{
+
+class BulkLoaderTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  /** Connection to the test database with LOAD DATA LOCAL enabled.  */
+  Connection conn;
+
+  BulkLoaderTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `data` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `num` DOUBLE NULL,
+        `payload` BLOB NULL
+      );
+    )");
+
+    UrlParser url;
+    url.Parse (GetTempDbUrl ());
+    conn.EnableLocalInfile ();
+    conn.Connect (url.GetHost (), url.GetPort (),
+                  url.GetUser (), url.GetPassword (), url.GetDatabase ());
+  }
+
+};
+
+TEST_F (BulkLoaderTests, Basic)
+{
+  const std::string binary("a\tb\nc\\d\re\0f", 11);
+
+  BulkLoader loader(conn, "data", {"id", "num", "payload"});
+  const uint64_t inserted = loader.Load ([&] (BulkLoader::RowWriter& w)
+    {
+      w.AddInt (1);
+      w.AddDouble (0.1);
+      w.AddString (binary);
+      w.EndRow ();
+
+      w.AddUnsigned (2);
+      w.AddNull ();
+      w.AddNull ();
+      w.EndRow ();
+
+      w.AddInt (3);
+      w.AddDouble (-1.5);
+      w.AddString ("");
+      w.EndRow ();
+
+      return false;
+    });
+  EXPECT_EQ (inserted, 3);
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (0, R"(
+    SELECT `id`, `num`, `payload`
+      FROM `data`
+      ORDER BY `id`
+  )");
+  stmt.Query ();
+
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 1);
+  EXPECT_EQ (stmt.Get<double> ("num"), 0.1);
+  EXPECT_EQ (stmt.Get<std::string> ("payload"), binary);
+
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 2);
+  EXPECT_TRUE (stmt.IsNull ("num"));
+  EXPECT_TRUE (stmt.IsNull ("payload"));
+
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 3);
+  EXPECT_EQ (stmt.Get<double> ("num"), -1.5);
+  EXPECT_EQ (stmt.Get<std::string> ("payload"), "");
+
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (BulkLoaderTests, ManyChunks)
+{
+  constexpr int numRows = 10'000;
+
+  BulkLoader loader(conn, "data", {"id", "payload"});
+  loader.SetChunkSize (100);
+
+  int next = 0;
+  const uint64_t inserted = loader.Load ([&] (BulkLoader::RowWriter& w)
+    {
+      w.AddInt (next);
+      w.AddString ("row " + std::to_string (next));
+      w.EndRow ();
+      ++next;
+      return next < numRows;
+    });
+  EXPECT_EQ (inserted, numRows);
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (0, R"(
+    SELECT COUNT(*) AS `cnt`, CAST(SUM(`id`) AS SIGNED) AS `sum`
+      FROM `data`
+      WHERE `payload` = CONCAT('row ', `id`)
+  )");
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("cnt"), numRows);
+  EXPECT_EQ (stmt.Get<int64_t> ("sum"),
+             static_cast<int64_t> (numRows) * (numRows - 1) / 2);
+}
+
+TEST_F (BulkLoaderTests, ProducerError)
+{
+  BulkLoader loader(conn, "data", {"id"});
+  loader.SetChunkSize (1);
+
+  int calls = 0;
+  EXPECT_THROW (loader.Load ([&] (BulkLoader::RowWriter& w)
+    {
+      if (++calls > 2)
+        throw std::runtime_error ("producer failed");
+      w.AddInt (calls);
+      w.EndRow ();
+      return true;
+    }), std::runtime_error);
+
+  /* The connection is still usable afterwards.  */
+  EXPECT_EQ (loader.Load ([] (BulkLoader::RowWriter& w)
+    {
+      w.AddInt (100);
+      w.EndRow ();
+      return false;
+    }), 1);
+}
+
+TEST_F (BulkLoaderTests, QueryError)
+{
+  BulkLoader loader(conn, "data", {"invalid"});
+  EXPECT_THROW (loader.Load ([] (BulkLoader::RowWriter& w)
+    {
+      w.AddInt (1);
+      w.EndRow ();
+      return false;
+    }), Error);
+}
+
+} // anonymous namespace
+} // namespace mypp
@@ -5,10 +5,15 @@
 #include "connection.hpp"
 
 #include "error.hpp"
+#include "metrics.hpp"
+#include "resultcache.hpp"
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <sstream>
+#include <string>
+#include <thread>
 
 namespace mypp
 {
@@ -30,17 +35,108 @@ MySqlError (MYSQL* h)
   return Error (out.str ());
 }
 
+/**
+ * Async implementation of Connection::Execute.  It sends the query,
+ * and then processes all results one by one with mysql_next_result.
+ */
+class ExecuteOp : public AsyncOperation::Impl
+{
+
+private:
+
+  MYSQL* const handle;
+  const std::string sql;
+
+  /** Set to true once the query itself is done.  */
+  bool queryDone = false;
+
+  /** The return value of the current MySQL call.  */
+  int rc;
+
+  /**
+   * Processes the result of the last call after it is done, and starts
+   * the next step if needed.  Returns the wait status.
+   */
+  int
+  ProcessDone ()
+  {
+    if (!queryDone)
+      {
+        if (rc != 0)
+          throw MySqlError (handle);
+        queryDone = true;
+      }
+    else
+      {
+        if (rc == -1)
+          return 0;
+        if (rc != 0)
+          throw MySqlError (handle);
+      }
+
+    const int status = mysql_next_result_start (&rc, handle);
+    if (status != 0)
+      return status;
+    return ProcessDone ();
+  }
+
+public:
+
+  explicit ExecuteOp (MYSQL* h, const std::string& s)
+    : handle(h), sql(s)
+  {}
+
+  int
+  Start () override
+  {
+    const int status = mysql_real_query_start (&rc, handle,
+                                               sql.data (), sql.size ());
+    if (status != 0)
+      return status;
+    return ProcessDone ();
+  }
+
+  int
+  Continue (const int ready) override
+  {
+    const int status
+        = queryDone ? mysql_next_result_cont (&rc, handle, ready)
+                    : mysql_real_query_cont (&rc, handle, ready);
+    if (status != 0)
+      return status;
+    return ProcessDone ();
+  }
+
+};
+
 } // anonymous namespace
 
 Connection::Connection ()
+  : handle(new MYSQL)
 {
-  handle = mysql_init (nullptr);
-  CHECK (handle != nullptr) << "Failed to initialise MySQL";
+  CHECK (mysql_init (handle) != nullptr) << "Failed to initialise MySQL";
 }
 
 Connection::~Connection ()
 {
+  /* The statements have to be closed before the connection.  Other
+     registered statements are detached, and must not be used anymore.  */
+  ClearStatementCache ();
+  for (auto* s : statements)
+    s->conn = nullptr;
+
   mysql_close (handle);
+  delete handle;
+}
+
+void
+Connection::SetOptions (const ConnectionOptions& opt)
+{
+  CHECK (!connected) << "MySQL connection is already up";
+
+  /* The options are only set on the handle when connecting, so that they
+     can be applied again when reconnecting.  */
+  options = opt;
 }
 
 void
@@ -50,11 +146,92 @@ Connection::UseClientCertificate (const std::string& ca,
 {
   CHECK (!connected) << "MySQL connection is already up";
 
+  options.sslCa = ca;
+  options.sslCert = cert;
+  options.sslKey = key;
+}
+
+void
+Connection::EnableNonBlocking ()
+{
+  CHECK (!connected) << "MySQL connection is already up";
+  nonBlocking = true;
+}
+
+void
+Connection::EnableLocalInfile ()
+{
+  CHECK (!connected) << "MySQL connection is already up";
+  localInfile = true;
+}
+
+void
+Connection::ApplyOptions ()
+{
   /* mysql_options only fails if the option is invalid, which should not
      happen here (unless it is a bug and not runtime error).  */
-  CHECK_EQ (mysql_options (handle, MYSQL_OPT_SSL_CA, ca.c_str ()), 0);
-  CHECK_EQ (mysql_options (handle, MYSQL_OPT_SSL_CERT, cert.c_str ()), 0);
-  CHECK_EQ (mysql_options (handle, MYSQL_OPT_SSL_KEY, key.c_str ()), 0);
+  if (!options.sslCa.empty ())
+    {
+      CHECK_EQ (mysql_options (handle, MYSQL_OPT_SSL_CA,
+                               options.sslCa.c_str ()), 0);
+      CHECK_EQ (mysql_options (handle, MYSQL_OPT_SSL_CERT,
+                               options.sslCert.c_str ()), 0);
+      CHECK_EQ (mysql_options (handle, MYSQL_OPT_SSL_KEY,
+                               options.sslKey.c_str ()), 0);
+    }
+
+  const auto setTimeout = [this] (const mysql_option opt,
+                                  const std::chrono::seconds val)
+    {
+      if (val.count () == 0)
+        return;
+      const unsigned sec = val.count ();
+      CHECK_EQ (mysql_options (handle, opt, &sec), 0);
+    };
+  setTimeout (MYSQL_OPT_CONNECT_TIMEOUT, options.connectTimeout);
+  setTimeout (MYSQL_OPT_READ_TIMEOUT, options.readTimeout);
+  setTimeout (MYSQL_OPT_WRITE_TIMEOUT, options.writeTimeout);
+
+  if (options.maxAllowedPacket > 0)
+    {
+      CHECK_EQ (mysql_options (handle, MYSQL_OPT_MAX_ALLOWED_PACKET,
+                               &options.maxAllowedPacket), 0);
+    }
+  if (options.netBufferLength > 0)
+    {
+      CHECK_EQ (mysql_options (handle, MYSQL_OPT_NET_BUFFER_LENGTH,
+                               &options.netBufferLength), 0);
+    }
+
+  if (nonBlocking)
+    {
+      CHECK_EQ (mysql_options (handle, MYSQL_OPT_NONBLOCK, 0), 0);
+    }
+
+  if (localInfile)
+    {
+      const unsigned enable = 1;
+      CHECK_EQ (mysql_options (handle, MYSQL_OPT_LOCAL_INFILE, &enable), 0);
+    }
+}
+
+bool
+Connection::TryConnect ()
+{
+  ApplyOptions ();
+
+  const char* dbToUse = (database.empty () ? nullptr : database.c_str ());
+  const char* socket = (options.unixSocket.empty ()
+                          ? nullptr : options.unixSocket.c_str ());
+
+  unsigned long flags = CLIENT_MULTI_STATEMENTS;
+  if (options.compression == ConnectionOptions::Compression::ZLIB)
+    flags |= CLIENT_COMPRESS;
+
+  return mysql_real_connect (handle, host.c_str (),
+                             user.c_str (), password.c_str (),
+                             dbToUse, port, socket, flags)
+            != nullptr;
 }
 
 void
@@ -64,12 +241,14 @@ Connection::Connect (const std::string& host, const unsigned port,
 {
   CHECK (!connected) << "MySQL connection is already up";
 
-  const char* dbToUse = (db.empty () ? nullptr : db.c_str ());
-  unsigned long flags = CLIENT_COMPRESS | CLIENT_MULTI_STATEMENTS;
-  if (mysql_real_connect (handle, host.c_str (),
-                          user.c_str (), password.c_str (),
-                          dbToUse, port, nullptr, flags)
-          == nullptr)
+  this->host = host;
+  this->port = port;
+  this->user = user;
+  this->password = password;
+  database = db;
+
+  configured = true;
+  if (!TryConnect ())
     throw MySqlError (handle);
 
   connected = true;
@@ -86,12 +265,83 @@ void
 Connection::Execute (const std::string& sql)
 {
   CHECK (connected) << "MySQL is not connected";
+
+  internal::PhaseTimer timer;
+  const auto record = [&] (const bool error)
+    {
+      if (timer)
+        timer.Finish (FingerprintSql (sql), MetricsSink::Phase::EXECUTE,
+                      error);
+    };
+
   if (mysql_real_query (handle, sql.data (), sql.size ()) != 0)
-    throw MySqlError (handle);
+    {
+      record (true);
+      throw MySqlError (handle);
+    }
 
   /* Process (ignore) all potential row-count indicators.  */
   while (true)
     {
+      const int rc = mysql_next_result (handle);
+      if (rc == 0)
+        continue;
+      if (rc == -1)
+        break;
+      record (true);
+      throw MySqlError (handle);
+    }
+
+  record (false);
+}
+
+void
+Connection::Execute (const std::string& sql,
+                     const std::vector<std::string>& tags)
+{
+  const auto invalidate = [&] ()
+    {
+      if (resultCache != nullptr)
+        for (const auto& t : tags)
+          resultCache->Invalidate (t);
+    };
+
+  try
+    {
+      Execute (sql);
+    }
+  catch (...)
+    {
+      invalidate ();
+      throw;
+    }
+
+  invalidate ();
+}
+
+std::vector<Connection::BatchResult>
+Connection::QueryBatch (const std::string& sql)
+{
+  CHECK (connected) << "MySQL is not connected";
+  if (mysql_real_query (handle, sql.data (), sql.size ()) != 0)
+    throw MySqlError (handle);
+
+  std::vector<BatchResult> results;
+  while (true)
+    {
+      BatchResult cur;
+      MYSQL_RES* res = mysql_store_result (handle);
+      if (res != nullptr)
+        cur.rows = std::make_unique<ResultSet> (res);
+      else if (mysql_field_count (handle) == 0)
+        {
+          cur.affectedRows = mysql_affected_rows (handle);
+          cur.insertId = mysql_insert_id (handle);
+        }
+      else
+        throw MySqlError (handle);
+      results.push_back (std::move (cur));
+
       const int rc = mysql_next_result (handle);
       if (rc == 0)
         continue;
@@ -99,6 +349,29 @@ Connection::Execute (const std::string& sql)
         break;
       throw MySqlError (handle);
     }
+
+  return results;
+}
+
+std::vector<Connection::BatchResult>
+Connection::QueryBatch (const std::vector<std::string>& statements)
+{
+  std::string sql;
+  for (const auto& s : statements)
+    {
+      if (!sql.empty ())
+        sql += ";\n";
+      sql += s;
+    }
+
+  return QueryBatch (sql);
+}
+
+AsyncOperation
+Connection::ExecuteAsync (const std::string& sql)
+{
+  CHECK (connected) << "MySQL is not connected";
+  return AsyncOperation (handle, std::make_unique<ExecuteOp> (handle, sql));
 }
 
 void
@@ -107,6 +380,151 @@ Connection::SetDefaultDatabase (const std::string& db)
   CHECK (connected) << "MySQL is not connected";
   if (mysql_select_db (handle, db.c_str ()) != 0)
     throw MySqlError (handle);
+
+  database = db;
+  ClearStatementCache ();
+}
+
+Statement&
+Connection::GetCached (const std::string& sql, const unsigned numParams)
+{
+  CHECK (connected) << "MySQL is not connected";
+
+  const auto mit = stmtCacheBySql.find (sql);
+  if (mit != stmtCacheBySql.end ())
+    {
+      ++stmtCacheHits;
+      auto entry = mit->second;
+      CHECK_EQ (entry->numParams, numParams)
+          << "Cached statement used with different number of parameters";
+      stmtCache.splice (stmtCache.begin (), stmtCache, entry);
+
+      entry->stmt->Reset ();
+      return *entry->stmt;
+    }
+
+  ++stmtCacheMisses;
+
+  /* Prepare the statement before adding it, so that we do not add
+     anything to the cache if it fails.  */
+  auto stmt = std::make_unique<Statement> (*this);
+  stmt->Prepare (numParams, sql);
+
+  ShrinkStatementCache (stmtCacheCapacity - 1);
+  stmtCache.push_front (CachedStatement ());
+  auto& entry = stmtCache.front ();
+  entry.sql = sql;
+  entry.numParams = numParams;
+  entry.stmt = std::move (stmt);
+  stmtCacheBySql.emplace (entry.sql, stmtCache.begin ());
+
+  return *entry.stmt;
+}
+
+void
+Connection::ShrinkStatementCache (const size_t num)
+{
+  while (stmtCache.size () > num)
+    {
+      stmtCacheBySql.erase (stmtCache.back ().sql);
+      stmtCache.pop_back ();
+    }
+}
+
+void
+Connection::SetStatementCacheCapacity (const size_t capacity)
+{
+  CHECK_GT (capacity, 0u) << "Statement cache capacity must be positive";
+  stmtCacheCapacity = capacity;
+  ShrinkStatementCache (stmtCacheCapacity);
+}
+
+void
+Connection::ClearStatementCache ()
+{
+  stmtCacheBySql.clear ();
+  stmtCache.clear ();
+}
+
+bool
+Connection::Ping ()
+{
+  CHECK (connected) << "MySQL is not connected";
+  return mysql_ping (handle) == 0;
+}
+
+void
+Connection::SetReconnectPolicy (const ReconnectPolicy& p)
+{
+  CHECK_GT (p.maxAttempts, 0u) << "At least one attempt must be allowed";
+  reconnectPolicy = p;
+}
+
+void
+Connection::Reconnect ()
+{
+  CHECK (configured) << "Connect has not been called";
+  if (inTransaction)
+    throw Error ("Cannot reconnect while a transaction is active");
+
+  /* Closing the handle invalidates all statements on it (but they can
+     still be closed safely), so that they are just recreated afterwards.  */
+  connected = false;
+  auto backoff = reconnectPolicy.initialBackoff;
+  for (unsigned attempt = 1; ; ++attempt)
+    {
+      mysql_close (handle);
+      CHECK (mysql_init (handle) != nullptr) << "Failed to initialise MySQL";
+
+      if (TryConnect ())
+        break;
+
+      if (attempt >= reconnectPolicy.maxAttempts)
+        throw MySqlError (handle);
+
+      LOG (WARNING)
+          << "Reconnect attempt " << attempt << " failed: "
+          << mysql_error (handle);
+      std::this_thread::sleep_for (backoff);
+      backoff = std::min (2 * backoff, reconnectPolicy.maxBackoff);
+    }
+
+  connected = true;
+  ++numReconnects;
+
+  /* Statements that cannot be prepared again (e.g. because a table they
+     use is gone) are left unprepared.  All others are still recreated,
+     so that none of them stays on the old (closed) handle.  */
+  unsigned numFailed = 0;
+  std::string firstError;
+  for (auto* s : statements)
+    try
+      {
+        s->Reprepare ();
+      }
+    catch (const Error& exc)
+      {
+        if (numFailed == 0)
+          firstError = exc.what ();
+        ++numFailed;
+      }
+
+  /* Cached statements that failed are evicted, so that a later GetCached
+     prepares them from scratch.  This is done after the loop, since
+     destructing them unregisters them from the set.  */
+  for (auto it = stmtCache.begin (); it != stmtCache.end (); )
+    if (it->stmt->GetState () == Statement::State::INITIALISED)
+      {
+        stmtCacheBySql.erase (it->sql);
+        it = stmtCache.erase (it);
+      }
+    else
+      ++it;
+
+  if (numFailed > 0)
+    throw Error ("Failed to prepare " + std::to_string (numFailed)
+                   + " statement(s) again after reconnecting: "
+                   + firstError);
 }
 
 } // namespace mypp
@@ -5,13 +5,30 @@
 #ifndef MYPP_CONNECTION_HPP
 #define MYPP_CONNECTION_HPP
 
+#include "async.hpp"
+#include "error.hpp"
+#include "options.hpp"
+#include "result.hpp"
+#include "statement.hpp"
+
 #include <mysql.h>
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace mypp
 {
 
+class ResultCache;
+
 /**
  * RAII wrapper around a MySQL / MariaDB database connection.  This contains
  * a MYSQL* handle (which can be directly accessed by users of the library as
@@ -20,14 +37,155 @@ namespace mypp
 class Connection
 {
 
+public:
+
+  /**
+   * The result of one statement executed as part of QueryBatch.
+   */
+  struct BatchResult
+  {
+
+    /** For statements without result set, the number of affected rows.  */
+    uint64_t affectedRows = 0;
+
+    /**
+     * For statements without result set, the value generated for an
+     * AUTO_INCREMENT column (if any).
+     */
+    uint64_t insertId = 0;
+
+    /** The returned rows if the statement had a result set, null if not.  */
+    std::unique_ptr<ResultSet> rows;
+
+  };
+
+  /**
+   * Configuration for how Reconnect retries establishing the connection.
+   */
+  struct ReconnectPolicy
+  {
+
+    /** Maximum number of connection attempts.  */
+    unsigned maxAttempts = 5;
+
+    /** Delay before the second attempt.  */
+    std::chrono::milliseconds initialBackoff{100};
+
+    /** Upper bound for the delay, which is doubled after each attempt.  */
+    std::chrono::milliseconds maxBackoff{5'000};
+
+  };
+
 private:
 
-  /** The underlying MYSQL handle.  */
-  MYSQL* handle;
+  /**
+   * The underlying MYSQL handle.  The struct is allocated by us, so that
+   * it keeps its address when the connection is closed and re-initialised
+   * by Reconnect (with statements holding on to the pointer).
+   */
+  MYSQL* const handle;
 
   /** Set to true if a connection is established.  */
   bool connected = false;
 
+  /** Set to true once Connect has been called.  */
+  bool configured = false;
+
+  /** The parameters passed to Connect, for reconnecting.  */
+  std::string host;
+  unsigned port = 0;
+  std::string user;
+  std::string password;
+
+  /** The current default database (empty if none).  */
+  std::string database;
+
+  /** The options applied to the handle when connecting.  */
+  ConnectionOptions options;
+
+  /** Whether non-blocking mode has been enabled.  */
+  bool nonBlocking = false;
+
+  /** Whether LOAD DATA LOCAL INFILE has been enabled.  */
+  bool localInfile = false;
+
+  /** The policy used for reconnecting.  */
+  ReconnectPolicy reconnectPolicy;
+
+  /** Number of times the connection has been re-established.  */
+  uint64_t numReconnects = 0;
+
+  /**
+   * All statements that are registered for re-preparation on reconnect
+   * (i.e. that have been constructed from the Connection).
+   */
+  std::unordered_set<Statement*> statements;
+
+  /** Set while a Transaction is active on the connection.  */
+  bool inTransaction = false;
+
+  /**
+   * An entry in the prepared statement cache.
+   */
+  struct CachedStatement
+  {
+
+    /** The SQL string of the statement.  */
+    std::string sql;
+
+    /** The number of parameters it has been prepared with.  */
+    unsigned numParams;
+
+    /** The prepared statement itself.  */
+    std::unique_ptr<Statement> stmt;
+
+  };
+
+  /**
+   * The cached prepared statements, ordered from most recently used
+   * to least recently used.
+   */
+  std::list<CachedStatement> stmtCache;
+
+  /**
+   * Map from the SQL strings to the entries in the statement cache.
+   * The keys point to the sql strings of the list entries.
+   */
+  std::unordered_map<std::string_view,
+                     std::list<CachedStatement>::iterator> stmtCacheBySql;
+
+  /** Maximum number of statements to hold in the cache.  */
+  size_t stmtCacheCapacity = 32;
+
+  /** Number of statement cache hits.  */
+  uint64_t stmtCacheHits = 0;
+
+  /** Number of statement cache misses.  */
+  uint64_t stmtCacheMisses = 0;
+
+  /** The result cache attached to this connection, if any.  */
+  ResultCache* resultCache = nullptr;
+
+  /**
+   * Evicts the least recently used statements from the cache until
+   * at most the given number are left.
+   */
+  void ShrinkStatementCache (size_t num);
+
+  /**
+   * Sets all configured options on the (freshly initialised) handle.
+   */
+  void ApplyOptions ();
+
+  /**
+   * Tries to establish the connection on the handle with the stored
+   * parameters.  Returns false on failure.
+   */
+  bool TryConnect ();
+
+  friend class Statement;
+  friend class Transaction;
+
 public:
 
   /**
@@ -41,14 +199,44 @@ public:
    */
   ~Connection ();
 
+  /**
+   * Sets the options (like timeouts or compression) to use for the
+   * connection.  Must be called before Connect is called.
+   */
+  void SetOptions (const ConnectionOptions& opt);
+
+  /**
+   * Returns the options of the connection.
+   */
+  const ConnectionOptions&
+  GetOptions () const
+  {
+    return options;
+  }
+
   /**
    * Sets config for using a client certificate.  Must be called before
    * Connect is called.  The arguments must be paths to the corresponding
    * files holding the CA certificate, public certificate and private key.
+   * This is equivalent to setting the ssl fields of the options.
    */
   void UseClientCertificate (const std::string& ca, const std::string& cert,
                              const std::string& key);
 
+  /**
+   * Enables non-blocking mode on the connection, so that the async methods
+   * (like ExecuteAsync) can be used on it.  All normal blocking methods
+   * still work as well.  Must be called before Connect is called.
+   */
+  void EnableNonBlocking ();
+
+  /**
+   * Allows the use of LOAD DATA LOCAL INFILE on the connection (which is
+   * needed for BulkLoader).  The server must allow it as well (with the
+   * local_infile system variable).  Must be called before Connect.
+   */
+  void EnableLocalInfile ();
+
   /**
    * Establishes a connection to a MySQL database.  This must only be called
    * once (not if already connected).  If db is the empty string, then no
@@ -78,13 +266,175 @@ public:
    */
   void Execute (const std::string& sql);
 
+  /**
+   * Executes queries like Execute, and then invalidates the given tags
+   * in the attached result cache (if any).  The tags are invalidated also
+   * if executing fails, since some of the queries may have been done.
+   */
+  void Execute (const std::string& sql, const std::vector<std::string>& tags);
+
+  /**
+   * Executes one or multiple queries specified by string, and returns the
+   * results of each statement in order.  In contrast to Execute, this
+   * can be used for statements that return result sets (SELECT), and all
+   * statements are sent in a single round trip to the server.
+   */
+  std::vector<BatchResult> QueryBatch (const std::string& sql);
+
+  /**
+   * Executes all the given statements in a single round trip, and returns
+   * their results in order.
+   */
+  std::vector<BatchResult>
+    QueryBatch (const std::vector<std::string>& statements);
+
+  /**
+   * Starts executing one or multiple queries like Execute, but without
+   * blocking.  The returned operation must be driven to completion by
+   * the caller.
+   */
+  AsyncOperation ExecuteAsync (const std::string& sql);
+
   /**
    * Sets the default database to use on the connection.
    */
   void SetDefaultDatabase (const std::string& db);
 
+  /**
+   * Attaches a result cache to the connection, or detaches it if null
+   * is passed.  The cache must outlive the connection or be detached.
+   */
+  void
+  SetResultCache (ResultCache* cache)
+  {
+    resultCache = cache;
+  }
+
+  /**
+   * Returns the attached result cache, or null if there is none.
+   */
+  ResultCache*
+  GetResultCache ()
+  {
+    return resultCache;
+  }
+
+  /**
+   * Returns a prepared statement for the given SQL string from the
+   * connection's cache, preparing it first if it is not in the cache yet.
+   * The statement is returned in prepared state with all bindings cleared,
+   * ready for binding parameters and executing it.
+   *
+   * The statement is owned by the cache.  The returned reference stays valid
+   * until the statement is evicted, which only happens when other statements
+   * are requested and the cache capacity is exceeded, or when the cache
+   * is cleared.
+   */
+  Statement& GetCached (const std::string& sql, unsigned numParams);
+
+  /**
+   * Sets the maximum number of statements held in the cache.  If more are
+   * in it right now, the least recently used ones are evicted.
+   */
+  void SetStatementCacheCapacity (size_t capacity);
+
+  /**
+   * Removes all statements from the cache.  This is done automatically
+   * when the default database is changed, since the statements' SQL may
+   * refer to tables relative to it.
+   */
+  void ClearStatementCache ();
+
+  /**
+   * Returns the number of GetCached calls that found the statement in
+   * the cache already.
+   */
+  uint64_t
+  GetStatementCacheHits () const
+  {
+    return stmtCacheHits;
+  }
+
+  /**
+   * Returns the number of GetCached calls that had to prepare
+   * a new statement.
+   */
+  uint64_t
+  GetStatementCacheMisses () const
+  {
+    return stmtCacheMisses;
+  }
+
+  /**
+   * Checks whether the connection to the server is still working.
+   * Returns false if it is not (e.g. because the server has closed it).
+   */
+  bool Ping ();
+
+  /**
+   * Sets the policy used when reconnecting.
+   */
+  void SetReconnectPolicy (const ReconnectPolicy& p);
+
+  /**
+   * Closes the connection and establishes it again with the same parameters
+   * and options (and the current default database).  Connection attempts
+   * are retried with exponential backoff according to the reconnect policy,
+   * and an Error is thrown if all of them fail.  Afterwards, all registered
+   * statements (including the cached ones) are prepared again, so that
+   * they can be used just as before.  If some of them fail to prepare,
+   * they are left in initialised state (and must be prepared explicitly
+   * before being used again, while failed cached statements are removed
+   * from the cache), the others are still prepared, and an Error
+   * is thrown at the end while the connection itself stays established.
+   *
+   * If all attempts fail, the connection is left disconnected, and
+   * Reconnect may be called again later.  Session state other than the
+   * default database (like variables or temporary tables) is lost.  Since
+   * an open transaction would be lost as well, this must not be called
+   * while a Transaction is active.
+   */
+  void Reconnect ();
+
+  /**
+   * Returns how often the connection has been re-established.
+   */
+  uint64_t
+  GetNumReconnects () const
+  {
+    return numReconnects;
+  }
+
+  /**
+   * Runs the given function, and if it throws an Error because the
+   * connection to the server has been lost, reconnects and runs it
+   * once more.  This must only be used for idempotent operations
+   * (e.g. reads), since the failed attempt may or may not have been
+   * processed by the server already.  Returns the function's result.
+   */
+  template <typename Fcn>
+    auto RetryIdempotent (Fcn&& f) -> decltype (f ());
+
 };
 
+template <typename Fcn>
+  auto
+  Connection::RetryIdempotent (Fcn&& f) -> decltype (f ())
+{
+  try
+    {
+      return f ();
+    }
+  catch (const Error&)
+    {
+      if (inTransaction || (connected && Ping ()))
+        throw;
+    }
+
+  Reconnect ();
+  return f ();
+}
+
 } // namespace mypp
 
 #endif // MYPP_CONNECTION_HPP
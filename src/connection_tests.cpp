@@ -0,0 +1,494 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "connection.hpp"
+
+#include "error.hpp"
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+#include "url.hpp"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <poll.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace mypp
+{
+namespace
+{
+
+class ConnectionTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  ConnectionTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `test` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `name` VARCHAR(64) NOT NULL
+      );
+      INSERT INTO `test`
+        (`id`, `name`) VALUES
+        (1, 'foo'),
+        (2, 'bar');
+    )");
+  }
+
+  /**
+   * Looks up the name for the given ID using a cached statement.
+   */
+  std::string
+  LookupName (const int64_t id)
+  {
+    auto& stmt = db.Get ().GetCached (R"(
+      SELECT `name`
+        FROM `test`
+        WHERE `id` = ?
+    )", 1);
+    stmt.Bind (0, id);
+    stmt.Query ();
+    CHECK (stmt.Fetch ());
+    return stmt.Get<std::string> ("name");
+  }
+
+  /**
+   * Connects the given connection to our temp database, in non-blocking mode.
+   */
+  static void
+  ConnectNonBlocking (Connection& conn)
+  {
+    UrlParser url;
+    url.Parse (GetTempDbUrl ());
+
+    conn.EnableNonBlocking ();
+    conn.Connect (url.GetHost (), url.GetPort (),
+                  url.GetUser (), url.GetPassword (), url.GetDatabase ());
+  }
+
+  /**
+   * Returns the number of rows in the test table.
+   */
+  int64_t
+  CountRows ()
+  {
+    Statement stmt(db.GetMySql ());
+    stmt.Prepare (0, "SELECT COUNT(*) AS `cnt` FROM `test`");
+    stmt.Query ();
+    CHECK (stmt.Fetch ());
+    return stmt.Get<int64_t> ("cnt");
+  }
+
+  /**
+   * Kills the server-side connection of our test database from
+   * another connection, simulating a dropped connection.
+   */
+  void
+  KillConnection ()
+  {
+    UrlParser url;
+    url.Parse (GetTempDbUrl ());
+
+    Connection other;
+    other.Connect (url.GetHost (), url.GetPort (),
+                   url.GetUser (), url.GetPassword (), url.GetDatabase ());
+    other.Execute ("KILL "
+                     + std::to_string (mysql_thread_id (db.GetMySql ())));
+    CHECK (!db.Get ().Ping ());
+  }
+
+};
+
+TEST_F (ConnectionTests, StatementCacheHits)
+{
+  auto& conn = db.Get ();
+  EXPECT_EQ (conn.GetStatementCacheHits (), 0);
+  EXPECT_EQ (conn.GetStatementCacheMisses (), 0);
+
+  /* The first lookup leaves the statement with an unfinished result, which
+     is reset when the statement is returned from the cache again.  */
+  EXPECT_EQ (LookupName (1), "foo");
+  EXPECT_EQ (LookupName (2), "bar");
+  EXPECT_EQ (LookupName (1), "foo");
+
+  EXPECT_EQ (conn.GetStatementCacheHits (), 2);
+  EXPECT_EQ (conn.GetStatementCacheMisses (), 1);
+}
+
+TEST_F (ConnectionTests, StatementCacheReturnsSameInstance)
+{
+  auto& conn = db.Get ();
+  auto& a = conn.GetCached ("SELECT `id` FROM `test`", 0);
+  auto& b = conn.GetCached ("SELECT `name` FROM `test`", 0);
+  EXPECT_NE (&a, &b);
+  EXPECT_EQ (&conn.GetCached ("SELECT `id` FROM `test`", 0), &a);
+  EXPECT_EQ (a.GetState (), Statement::State::PREPARED);
+}
+
+TEST_F (ConnectionTests, StatementCacheEviction)
+{
+  auto& conn = db.Get ();
+  conn.SetStatementCacheCapacity (2);
+
+  conn.GetCached ("SELECT 1", 0);
+  conn.GetCached ("SELECT 2", 0);
+  conn.GetCached ("SELECT 1", 0);
+  /* This evicts "SELECT 2", which is the least recently used.  */
+  conn.GetCached ("SELECT 3", 0);
+  EXPECT_EQ (conn.GetStatementCacheHits (), 1);
+  EXPECT_EQ (conn.GetStatementCacheMisses (), 3);
+
+  conn.GetCached ("SELECT 1", 0);
+  conn.GetCached ("SELECT 3", 0);
+  EXPECT_EQ (conn.GetStatementCacheHits (), 3);
+  conn.GetCached ("SELECT 2", 0);
+  EXPECT_EQ (conn.GetStatementCacheMisses (), 4);
+}
+
+TEST_F (ConnectionTests, StatementCacheInvalidatedByDatabaseChange)
+{
+  auto& conn = db.Get ();
+  EXPECT_EQ (LookupName (1), "foo");
+  EXPECT_EQ (conn.GetStatementCacheMisses (), 1);
+
+  /* Switching the database (even to the same one) clears the cache.  */
+  UrlParser url;
+  url.Parse (GetTempDbUrl ());
+  conn.SetDefaultDatabase (url.GetDatabase ());
+
+  EXPECT_EQ (LookupName (1), "foo");
+  EXPECT_EQ (conn.GetStatementCacheHits (), 0);
+  EXPECT_EQ (conn.GetStatementCacheMisses (), 2);
+}
+
+TEST_F (ConnectionTests, ReconnectRepreparesStatements)
+{
+  auto& conn = db.Get ();
+  EXPECT_EQ (LookupName (1), "foo");
+
+  Statement registered(conn);
+  registered.Prepare (1, "SELECT `name` FROM `test` WHERE `id` = ?");
+  Statement direct(conn);
+  direct.PrepareDirect (1, "SELECT `name` FROM `test` WHERE `id` = ?");
+  Statement unprepared(conn);
+
+  KillConnection ();
+  conn.Reconnect ();
+  EXPECT_TRUE (conn.Ping ());
+  EXPECT_EQ (conn.GetNumReconnects (), 1);
+
+  /* The default database is kept, and cached statements still work.  */
+  EXPECT_EQ (CountRows (), 2);
+  EXPECT_EQ (LookupName (2), "bar");
+  EXPECT_EQ (conn.GetStatementCacheHits (), 1);
+
+  for (auto* stmt : {&registered, &direct})
+    {
+      EXPECT_EQ (stmt->GetState (), Statement::State::PREPARED);
+      stmt->Bind<int64_t> (0, 1);
+      stmt->Query ();
+      ASSERT_TRUE (stmt->Fetch ());
+      EXPECT_EQ (stmt->Get<std::string> ("name"), "foo");
+    }
+
+  EXPECT_EQ (unprepared.GetState (), Statement::State::INITIALISED);
+  unprepared.Prepare (0, "SELECT COUNT(*) FROM `test`");
+  unprepared.Query ();
+  EXPECT_TRUE (unprepared.Fetch ());
+}
+
+TEST_F (ConnectionTests, ReconnectWithFailingStatement)
+{
+  auto& conn = db.Get ();
+  conn.Execute (R"(
+    CREATE TABLE `other` (
+      `id` INT NOT NULL PRIMARY KEY
+    )
+  )");
+
+  Statement gone(conn);
+  gone.Prepare (0, "SELECT `id` FROM `other`");
+  Statement good(conn);
+  good.Prepare (1, "SELECT `name` FROM `test` WHERE `id` = ?");
+  const std::string cachedSql = "SELECT COUNT(*) AS `cnt` FROM `other`";
+  conn.GetCached (cachedSql, 0);
+
+  conn.Execute ("DROP TABLE `other`");
+  KillConnection ();
+  EXPECT_THROW (conn.Reconnect (), Error);
+
+  /* The connection itself is back, and only the failing statement is
+     left unprepared.  */
+  EXPECT_TRUE (conn);
+  EXPECT_TRUE (conn.Ping ());
+  EXPECT_EQ (conn.GetNumReconnects (), 1);
+  EXPECT_EQ (gone.GetState (), Statement::State::INITIALISED);
+
+  EXPECT_EQ (good.GetState (), Statement::State::PREPARED);
+  good.Bind<int64_t> (0, 1);
+  good.Query ();
+  ASSERT_TRUE (good.Fetch ());
+  EXPECT_EQ (good.Get<std::string> ("name"), "foo");
+  EXPECT_EQ (LookupName (2), "bar");
+
+  /* The failed cached statement has been evicted, and is prepared again
+     when requested.  */
+  conn.Execute (R"(
+    CREATE TABLE `other` (
+      `id` INT NOT NULL PRIMARY KEY
+    )
+  )");
+  const auto misses = conn.GetStatementCacheMisses ();
+  auto& cached = conn.GetCached (cachedSql, 0);
+  EXPECT_EQ (conn.GetStatementCacheMisses (), misses + 1);
+  cached.Query ();
+  ASSERT_TRUE (cached.Fetch ());
+  EXPECT_EQ (cached.Get<int64_t> ("cnt"), 0);
+}
+
+TEST_F (ConnectionTests, ReconnectFailure)
+{
+  UrlParser url;
+  url.Parse (GetTempDbUrl ());
+
+  Connection conn;
+  conn.Connect (url.GetHost (), url.GetPort (),
+                url.GetUser (), url.GetPassword (), "");
+
+  Connection::ReconnectPolicy policy;
+  policy.maxAttempts = 2;
+  policy.initialBackoff = std::chrono::milliseconds (1);
+  conn.SetReconnectPolicy (policy);
+
+  /* Reconnecting fails when the default database does not exist anymore.  */
+  conn.Execute ("CREATE DATABASE `mypp_reconnect_test`");
+  conn.SetDefaultDatabase ("mypp_reconnect_test");
+  conn.Execute ("DROP DATABASE `mypp_reconnect_test`");
+
+  EXPECT_THROW (conn.Reconnect (), Error);
+  EXPECT_FALSE (conn);
+  EXPECT_EQ (conn.GetNumReconnects (), 0);
+}
+
+TEST_F (ConnectionTests, RetryIdempotent)
+{
+  auto& conn = db.Get ();
+  Statement stmt(conn);
+  stmt.Prepare (0, "SELECT COUNT(*) AS `cnt` FROM `test`");
+
+  unsigned calls = 0;
+  const auto count = [&] ()
+    {
+      ++calls;
+      stmt.Reset ();
+      stmt.Query ();
+      CHECK (stmt.Fetch ());
+      return stmt.Get<int64_t> ("cnt");
+    };
+
+  EXPECT_EQ (conn.RetryIdempotent (count), 2);
+  EXPECT_EQ (calls, 1);
+
+  KillConnection ();
+  EXPECT_EQ (conn.RetryIdempotent (count), 2);
+  EXPECT_EQ (calls, 3);
+  EXPECT_EQ (conn.GetNumReconnects (), 1);
+
+  /* Errors other than a lost connection are not retried.  */
+  calls = 0;
+  EXPECT_THROW (conn.RetryIdempotent ([&] ()
+    {
+      ++calls;
+      conn.Execute ("SELECT * FROM `invalid`");
+    }), Error);
+  EXPECT_EQ (calls, 1);
+}
+
+TEST_F (ConnectionTests, QueryBatch)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `auto` (
+      `id` INT NOT NULL AUTO_INCREMENT PRIMARY KEY,
+      `value` INT NULL
+    )
+  )");
+
+  auto results = db.Get ().QueryBatch ({
+    "INSERT INTO `auto` (`value`) VALUES (5), (NULL)",
+    "SELECT `id`, `value` FROM `auto` ORDER BY `id`",
+    "UPDATE `test` SET `name` = 'baz'",
+    "SELECT `name` FROM `test` WHERE `id` = 42",
+  });
+  ASSERT_EQ (results.size (), 4);
+
+  EXPECT_EQ (results[0].rows, nullptr);
+  EXPECT_EQ (results[0].affectedRows, 2);
+  EXPECT_EQ (results[0].insertId, 1);
+
+  auto& rows = *results[1].rows;
+  EXPECT_EQ (rows.GetNumRows (), 2);
+  EXPECT_EQ (rows.GetNumColumns (), 2);
+  ASSERT_TRUE (rows.Next ());
+  EXPECT_EQ (rows.Get<int64_t> ("id"), 1);
+  EXPECT_FALSE (rows.IsNull ("value"));
+  EXPECT_EQ (rows.Get<int64_t> ("value"), 5);
+  ASSERT_TRUE (rows.Next ());
+  EXPECT_EQ (rows.Get<std::string> ("id"), "2");
+  EXPECT_TRUE (rows.IsNull ("value"));
+  EXPECT_FALSE (rows.Next ());
+
+  EXPECT_EQ (results[2].rows, nullptr);
+  EXPECT_EQ (results[2].affectedRows, 2);
+
+  ASSERT_NE (results[3].rows, nullptr);
+  EXPECT_EQ (results[3].rows->GetNumRows (), 0);
+  EXPECT_FALSE (results[3].rows->Next ());
+}
+
+TEST_F (ConnectionTests, QueryBatchError)
+{
+  EXPECT_THROW (db.Get ().QueryBatch ("SELECT 1; INVALID SQL"), Error);
+
+  /* The connection is still usable afterwards.  */
+  EXPECT_EQ (LookupName (1), "foo");
+}
+
+TEST_F (ConnectionTests, AsyncExecute)
+{
+  Connection conn;
+  ConnectNonBlocking (conn);
+
+  auto op = conn.ExecuteAsync (R"(
+    INSERT INTO `test` (`id`, `name`) VALUES (10, 'a');
+    INSERT INTO `test` (`id`, `name`) VALUES (11, 'b');
+  )");
+  op.Wait ();
+  EXPECT_TRUE (op.IsDone ());
+  EXPECT_EQ (CountRows (), 4);
+
+  /* Blocking calls still work on the connection as well.  */
+  conn.Execute ("DELETE FROM `test` WHERE `id` >= 10");
+  EXPECT_EQ (CountRows (), 2);
+}
+
+TEST_F (ConnectionTests, AsyncExecuteError)
+{
+  Connection conn;
+  ConnectNonBlocking (conn);
+
+  EXPECT_THROW (
+    {
+      auto op = conn.ExecuteAsync ("INVALID SQL");
+      op.Wait ();
+    }, Error);
+}
+
+TEST_F (ConnectionTests, AsyncEventLoop)
+{
+  constexpr unsigned num = 3;
+
+  std::vector<std::unique_ptr<Connection>> conns;
+  std::vector<AsyncOperation> ops;
+  std::vector<std::string> queries;
+  for (unsigned i = 0; i < num; ++i)
+    {
+      conns.push_back (std::make_unique<Connection> ());
+      ConnectNonBlocking (*conns.back ());
+      queries.push_back ("DO SLEEP(0.1); INSERT INTO `test` (`id`, `name`)"
+                         " VALUES (" + std::to_string (100 + i) + ", 'x')");
+    }
+  for (unsigned i = 0; i < num; ++i)
+    ops.push_back (conns[i]->ExecuteAsync (queries[i]));
+
+  /* Drive all operations concurrently from a single poll loop.  */
+  while (true)
+    {
+      std::vector<pollfd> fds;
+      std::vector<AsyncOperation*> pending;
+      for (auto& op : ops)
+        {
+          if (op.IsDone ())
+            continue;
+          pollfd pfd;
+          pfd.fd = op.GetSocket ();
+          pfd.events = 0;
+          pfd.revents = 0;
+          if (op.GetWaitEvents () & MYSQL_WAIT_READ)
+            pfd.events |= POLLIN;
+          if (op.GetWaitEvents () & MYSQL_WAIT_WRITE)
+            pfd.events |= POLLOUT;
+          fds.push_back (pfd);
+          pending.push_back (&op);
+        }
+      if (pending.empty ())
+        break;
+
+      ASSERT_GE (poll (fds.data (), fds.size (), 10'000), 0);
+      for (unsigned i = 0; i < pending.size (); ++i)
+        {
+          int ready = 0;
+          if (fds[i].revents & (POLLIN | POLLERR | POLLHUP))
+            ready |= MYSQL_WAIT_READ;
+          if (fds[i].revents & POLLOUT)
+            ready |= MYSQL_WAIT_WRITE;
+          if (ready != 0)
+            pending[i]->Continue (ready);
+        }
+    }
+
+  EXPECT_EQ (CountRows (), 2 + num);
+}
+
+TEST_F (ConnectionTests, AsyncStatement)
+{
+  Connection conn;
+  ConnectNonBlocking (conn);
+
+  Statement stmt(*conn);
+  stmt.Prepare (2, R"(
+    INSERT INTO `test`
+      (`id`, `name`) VALUES (?, ?)
+  )");
+  stmt.Bind<int64_t> (0, 3);
+  stmt.Bind<std::string> (1, "baz");
+  stmt.ExecuteAsync ().Wait ();
+  EXPECT_EQ (stmt.GetState (), Statement::State::FINISHED);
+
+  stmt.Prepare (0, R"(
+    SELECT `id`, `name`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  for (const auto mode : {Statement::ResultMode::BUFFERED,
+                          Statement::ResultMode::STREAMING})
+    {
+      stmt.Reset ();
+      stmt.QueryAsync (mode).Wait ();
+
+      std::vector<std::string> names;
+      while (true)
+        {
+          auto op = stmt.FetchAsync ();
+          op.Wait ();
+          if (!op.GetResult ())
+            break;
+          names.push_back (stmt.Get<std::string> ("name"));
+        }
+      EXPECT_EQ (names, std::vector<std::string> ({"foo", "bar", "baz"}));
+    }
+}
+
+} // anonymous namespace
+} // namespace mypp
@@ -0,0 +1,107 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "decimal.hpp"
+
+#include "error.hpp"
+
+#include <glog/logging.h>
+
+#include <cmath>
+#include <limits>
+
+namespace mypp
+{
+
+Decimal::Decimal (const int64_t u, const unsigned s)
+  : unscaled(u), scale(s)
+{
+  CHECK_LE (scale, MAX_SCALE) << "Decimal scale too large";
+}
+
+Decimal
+Decimal::Parse (const std::string_view str)
+{
+  const auto invalid = [str] ()
+    {
+      return Error ("Invalid decimal: '" + std::string (str) + "'");
+    };
+
+  size_t pos = 0;
+  const bool neg = (!str.empty () && str[0] == '-');
+  if (neg)
+    ++pos;
+
+  /* We accumulate the absolute value as unsigned, so that also the minimum
+     int64_t value can be represented.  */
+  constexpr uint64_t maxAbs
+      = static_cast<uint64_t> (std::numeric_limits<int64_t>::max ()) + 1;
+  uint64_t abs = 0;
+  unsigned digits = 0;
+  unsigned scale = 0;
+  bool haveDot = false;
+  for (; pos < str.size (); ++pos)
+    {
+      const char c = str[pos];
+      if (c == '.' && !haveDot)
+        {
+          haveDot = true;
+          continue;
+        }
+      if (c < '0' || c > '9')
+        throw invalid ();
+
+      const unsigned d = c - '0';
+      if (abs > (maxAbs - d) / 10)
+        throw Error ("Decimal out of range: '" + std::string (str) + "'");
+      abs = 10 * abs + d;
+
+      ++digits;
+      if (haveDot)
+        ++scale;
+    }
+
+  if (digits == 0)
+    throw invalid ();
+  if (scale > MAX_SCALE)
+    throw Error ("Decimal scale too large: '" + std::string (str) + "'");
+  if (!neg && abs == maxAbs)
+    throw Error ("Decimal out of range: '" + std::string (str) + "'");
+
+  const int64_t unscaled
+      = neg ? static_cast<int64_t> (-abs) : static_cast<int64_t> (abs);
+  return Decimal (unscaled, scale);
+}
+
+std::string
+Decimal::ToString () const
+{
+  const bool neg = (unscaled < 0);
+  const uint64_t abs = neg ? -static_cast<uint64_t> (unscaled)
+                           : static_cast<uint64_t> (unscaled);
+
+  std::string digits = std::to_string (abs);
+  if (digits.size () <= scale)
+    digits.insert (0, scale + 1 - digits.size (), '0');
+
+  std::string res;
+  if (neg)
+    res.push_back ('-');
+  res.append (digits, 0, digits.size () - scale);
+  if (scale > 0)
+    {
+      res.push_back ('.');
+      res.append (digits, digits.size () - scale, scale);
+    }
+
+  return res;
+}
+
+double
+Decimal::ToDouble () const
+{
+  return static_cast<double> (unscaled) / std::pow (10.0, scale);
+}
+
+} // namespace mypp
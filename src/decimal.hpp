@@ -0,0 +1,98 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_DECIMAL_HPP
+#define MYPP_DECIMAL_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace mypp
+{
+
+/**
+ * A fixed-point decimal number, as used for DECIMAL columns.  It is stored
+ * as an unscaled integer value together with the number of digits after the
+ * decimal point, i.e. the value is unscaled * 10^(-scale).  This can hold
+ * values with up to 18 significant digits exactly.
+ */
+class Decimal
+{
+
+private:
+
+  /** The unscaled integer value.  */
+  int64_t unscaled = 0;
+
+  /** The number of digits after the decimal point.  */
+  unsigned scale = 0;
+
+public:
+
+  /** The maximum supported scale.  */
+  static constexpr unsigned MAX_SCALE = 18;
+
+  Decimal () = default;
+
+  /**
+   * Constructs a decimal with the given unscaled value and scale.
+   */
+  Decimal (int64_t u, unsigned s);
+
+  Decimal (const Decimal&) = default;
+  Decimal& operator= (const Decimal&) = default;
+
+  /**
+   * Parses a decimal from its string form (as returned by MySQL), e.g.
+   * "-12.340".  The scale of the result is the number of digits after the
+   * decimal point in the string.  Throws an Error if the string is invalid
+   * or the value does not fit.
+   */
+  static Decimal Parse (std::string_view str);
+
+  /**
+   * Returns the string form of the value, with exactly scale digits after
+   * the decimal point.
+   */
+  std::string ToString () const;
+
+  /**
+   * Returns the (possibly rounded) value as floating-point number.
+   */
+  double ToDouble () const;
+
+  int64_t
+  GetUnscaled () const
+  {
+    return unscaled;
+  }
+
+  unsigned
+  GetScale () const
+  {
+    return scale;
+  }
+
+  /**
+   * Compares the representation of two decimals, i.e. 1.5 and 1.50 are
+   * different (because they have a different scale).
+   */
+  friend bool
+  operator== (const Decimal& a, const Decimal& b)
+  {
+    return a.unscaled == b.unscaled && a.scale == b.scale;
+  }
+
+  friend bool
+  operator!= (const Decimal& a, const Decimal& b)
+  {
+    return !(a == b);
+  }
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_DECIMAL_HPP
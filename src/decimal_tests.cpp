@@ -0,0 +1,64 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "decimal.hpp"
+
+#include "error.hpp"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+namespace mypp
+{
+namespace
+{
+
+using DecimalTests = testing::Test;
+
+TEST_F (DecimalTests, Parse)
+{
+  EXPECT_EQ (Decimal::Parse ("0"), Decimal (0, 0));
+  EXPECT_EQ (Decimal::Parse ("42"), Decimal (42, 0));
+  EXPECT_EQ (Decimal::Parse ("-12.340"), Decimal (-12'340, 3));
+  EXPECT_EQ (Decimal::Parse ("0.001"), Decimal (1, 3));
+  EXPECT_EQ (Decimal::Parse (".5"), Decimal (5, 1));
+  EXPECT_EQ (Decimal::Parse ("9223372036854775807"),
+             Decimal (std::numeric_limits<int64_t>::max (), 0));
+  EXPECT_EQ (Decimal::Parse ("-922337203685477580.8"),
+             Decimal (std::numeric_limits<int64_t>::min (), 1));
+}
+
+TEST_F (DecimalTests, ParseInvalid)
+{
+  EXPECT_THROW (Decimal::Parse (""), Error);
+  EXPECT_THROW (Decimal::Parse ("-"), Error);
+  EXPECT_THROW (Decimal::Parse ("."), Error);
+  EXPECT_THROW (Decimal::Parse ("1.2.3"), Error);
+  EXPECT_THROW (Decimal::Parse ("1e5"), Error);
+  EXPECT_THROW (Decimal::Parse (" 1"), Error);
+  EXPECT_THROW (Decimal::Parse ("9223372036854775808"), Error);
+  EXPECT_THROW (Decimal::Parse ("0.0000000000000000001"), Error);
+}
+
+TEST_F (DecimalTests, ToString)
+{
+  EXPECT_EQ (Decimal (0, 0).ToString (), "0");
+  EXPECT_EQ (Decimal (0, 2).ToString (), "0.00");
+  EXPECT_EQ (Decimal (42, 0).ToString (), "42");
+  EXPECT_EQ (Decimal (-12'340, 3).ToString (), "-12.340");
+  EXPECT_EQ (Decimal (1, 3).ToString (), "0.001");
+  EXPECT_EQ (Decimal (-5, 1).ToString (), "-0.5");
+  EXPECT_EQ (Decimal (std::numeric_limits<int64_t>::min (), 1).ToString (),
+             "-922337203685477580.8");
+}
+
+TEST_F (DecimalTests, ToDouble)
+{
+  EXPECT_DOUBLE_EQ (Decimal (-12'340, 3).ToDouble (), -12.34);
+  EXPECT_DOUBLE_EQ (Decimal (5, 1).ToDouble (), 0.5);
+}
+
+} // anonymous namespace
+} // namespace mypp
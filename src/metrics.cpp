@@ -0,0 +1,181 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "metrics.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace mypp
+{
+
+namespace internal
+{
+std::atomic<MetricsSink*> metricsSink(nullptr);
+} // namespace internal
+
+void
+SetMetricsSink (MetricsSink* sink)
+{
+  internal::metricsSink.store (sink, std::memory_order_release);
+}
+
+namespace
+{
+
+/**
+ * Returns true if the character can be part of an identifier.
+ */
+bool
+IsIdentifierChar (const char c)
+{
+  return std::isalnum (static_cast<unsigned char> (c)) || c == '_' || c == '$';
+}
+
+} // anonymous namespace
+
+std::string
+FingerprintSql (const std::string_view sql)
+{
+  std::string res;
+  res.reserve (sql.size ());
+
+  bool pendingSpace = false;
+  size_t i = 0;
+  while (i < sql.size ())
+    {
+      const char c = sql[i];
+
+      if (std::isspace (static_cast<unsigned char> (c)))
+        {
+          pendingSpace = !res.empty ();
+          ++i;
+          continue;
+        }
+
+      if (pendingSpace)
+        {
+          res.push_back (' ');
+          pendingSpace = false;
+        }
+
+      /* String literals are replaced, while quoted identifiers are
+         copied as they are.  Inside quotes, backslash escapes and doubled
+         quote characters are skipped over.  */
+      if (c == '\'' || c == '"' || c == '`')
+        {
+          const size_t start = i++;
+          while (i < sql.size ())
+            {
+              if (sql[i] == '\\' && c != '`')
+                i += 2;
+              else if (sql[i] == c)
+                {
+                  ++i;
+                  if (i < sql.size () && sql[i] == c)
+                    ++i;
+                  else
+                    break;
+                }
+              else
+                ++i;
+            }
+          i = std::min (i, sql.size ());
+
+          if (c == '`')
+            res.append (sql, start, i - start);
+          else
+            res.push_back ('?');
+          continue;
+        }
+
+      /* Numbers are replaced if they are not part of an identifier.  */
+      if (std::isdigit (static_cast<unsigned char> (c))
+            && (res.empty () || !IsIdentifierChar (res.back ())))
+        {
+          while (i < sql.size ()
+                   && (IsIdentifierChar (sql[i]) || sql[i] == '.'))
+            ++i;
+          res.push_back ('?');
+          continue;
+        }
+
+      res.push_back (c);
+      ++i;
+    }
+
+  return res;
+}
+
+void
+MetricsRegistry::Histogram::Add (const std::chrono::nanoseconds duration)
+{
+  const auto micros
+      = std::chrono::duration_cast<std::chrono::microseconds> (duration);
+
+  size_t bucket = 0;
+  for (uint64_t val = micros.count (); val > 0 && bucket + 1 < NUM_BUCKETS;
+       val >>= 1)
+    ++bucket;
+
+  ++buckets[bucket];
+  ++count;
+  total += duration;
+}
+
+std::chrono::microseconds
+MetricsRegistry::Histogram::Percentile (const double p) const
+{
+  CHECK_GE (p, 0.0);
+  CHECK_LE (p, 1.0);
+
+  if (count == 0)
+    return std::chrono::microseconds (0);
+
+  const double target = p * count;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+      seen += buckets[i];
+      if (seen > 0 && seen >= target)
+        return std::chrono::microseconds (uint64_t (1) << i);
+    }
+
+  return std::chrono::microseconds (uint64_t (1) << (NUM_BUCKETS - 1));
+}
+
+void
+MetricsRegistry::Record (const Event& ev)
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  auto mit = stats.find (ev.fingerprint);
+  if (mit == stats.end ())
+    mit = stats.emplace (std::string (ev.fingerprint), Stats ()).first;
+  auto& s = mit->second;
+
+  s.latency[static_cast<size_t> (ev.phase)].Add (ev.duration);
+  s.rows += ev.rows;
+  s.bytes += ev.bytes;
+  if (ev.error)
+    ++s.errors;
+}
+
+MetricsRegistry::Snapshot
+MetricsRegistry::GetSnapshot () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return stats;
+}
+
+void
+MetricsRegistry::Clear ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+  stats.clear ();
+}
+
+} // namespace mypp
@@ -0,0 +1,304 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_METRICS_HPP
+#define MYPP_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace mypp
+{
+
+/**
+ * Interface for receiving instrumentation data about the database calls
+ * made through mypp.  An instance can be installed globally with
+ * SetMetricsSink.  When no sink is installed, the instrumentation
+ * costs just one atomic load per call.  Defining MYPP_DISABLE_METRICS
+ * when building removes it completely.
+ *
+ * Record may be called concurrently from all threads that use mypp,
+ * so implementations must be thread-safe.
+ */
+class MetricsSink
+{
+
+public:
+
+  /**
+   * The phase of processing a query that an event is about.
+   */
+  enum class Phase
+  {
+    /** Preparing a statement on the server.  */
+    PREPARE,
+    /** Executing a statement or plain SQL query.  */
+    EXECUTE,
+    /** Receiving a buffered result set.  */
+    STORE_RESULT,
+    /**
+     * Fetching the rows of a result.  This is reported once per result
+     * set (when all rows have been fetched or the statement is reset),
+     * with the total time spent in Fetch calls for it.
+     */
+    FETCH,
+  };
+
+  /** Number of distinct phases.  */
+  static constexpr size_t NUM_PHASES = 4;
+
+  /**
+   * Data about one completed phase.
+   */
+  struct Event
+  {
+
+    /**
+     * Fingerprint of the SQL that was processed (see FingerprintSql).
+     * This is only valid during the call to Record.
+     */
+    std::string_view fingerprint;
+
+    /** The phase this is about.  */
+    Phase phase;
+
+    /** Time spent in the phase.  */
+    std::chrono::nanoseconds duration;
+
+    /** For FETCH, the number of rows fetched.  */
+    uint64_t rows = 0;
+
+    /** For FETCH, the number of bytes of values fetched.  */
+    uint64_t bytes = 0;
+
+    /** Whether or not the phase failed with an error.  */
+    bool error = false;
+
+  };
+
+  virtual ~MetricsSink () = default;
+
+  /**
+   * Records data about a completed phase.
+   */
+  virtual void Record (const Event& ev) = 0;
+
+};
+
+/**
+ * Installs the given sink for receiving instrumentation data, or disables
+ * instrumentation if null is passed.  The sink must stay alive until it has
+ * been uninstalled and no more calls to it are in progress.
+ */
+void SetMetricsSink (MetricsSink* sink);
+
+namespace internal
+{
+
+/** The currently installed metrics sink (if any).  */
+extern std::atomic<MetricsSink*> metricsSink;
+
+} // namespace internal
+
+/**
+ * Returns the currently installed metrics sink, or null if there is none.
+ */
+inline MetricsSink*
+GetMetricsSink ()
+{
+#ifdef MYPP_DISABLE_METRICS
+  return nullptr;
+#else
+  return internal::metricsSink.load (std::memory_order_acquire);
+#endif
+}
+
+/**
+ * Returns a normalised form of the given SQL, which identifies queries of
+ * the same shape:  Whitespace is collapsed, and string and numeric literals
+ * are replaced by "?".
+ */
+std::string FingerprintSql (std::string_view sql);
+
+/**
+ * A MetricsSink that aggregates all events in memory per SQL fingerprint,
+ * with call counts and latency histograms per phase and counters for
+ * rows, bytes and errors.
+ */
+class MetricsRegistry : public MetricsSink
+{
+
+public:
+
+  /**
+   * Number of buckets in a latency histogram.  The bucket i > 0 holds
+   * durations in [2^(i-1), 2^i) microseconds, the bucket 0 those below one
+   * microsecond, and the last one everything larger.
+   */
+  static constexpr size_t NUM_BUCKETS = 32;
+
+  /**
+   * A histogram of latencies with logarithmic buckets.
+   */
+  struct Histogram
+  {
+
+    /** The number of events per bucket.  */
+    std::array<uint64_t, NUM_BUCKETS> buckets = {};
+
+    /** Total number of events.  */
+    uint64_t count = 0;
+
+    /** Sum of all durations.  */
+    std::chrono::nanoseconds total{0};
+
+    /**
+     * Adds an event to the histogram.
+     */
+    void Add (std::chrono::nanoseconds duration);
+
+    /**
+     * Returns an upper bound for the given percentile (in [0, 1]) of the
+     * recorded durations, based on the bucket boundaries.
+     */
+    std::chrono::microseconds Percentile (double p) const;
+
+  };
+
+  /**
+   * The aggregated data for one SQL fingerprint.
+   */
+  struct Stats
+  {
+
+    /** Latencies of each phase (indexed by Phase).  */
+    std::array<Histogram, NUM_PHASES> latency;
+
+    /** Total rows fetched.  */
+    uint64_t rows = 0;
+
+    /** Total bytes fetched.  */
+    uint64_t bytes = 0;
+
+    /** Number of errors.  */
+    uint64_t errors = 0;
+
+    const Histogram&
+    GetLatency (const Phase p) const
+    {
+      return latency[static_cast<size_t> (p)];
+    }
+
+  };
+
+  /** Aggregated data for all fingerprints.  */
+  using Snapshot = std::map<std::string, Stats, std::less<>>;
+
+private:
+
+  /** Lock for the data.  */
+  mutable std::mutex mut;
+
+  /** The aggregated data.  */
+  Snapshot stats;
+
+public:
+
+  MetricsRegistry () = default;
+
+  MetricsRegistry (const MetricsRegistry&) = delete;
+  void operator= (const MetricsRegistry&) = delete;
+
+  void Record (const Event& ev) override;
+
+  /**
+   * Returns a copy of the data aggregated so far.
+   */
+  Snapshot GetSnapshot () const;
+
+  /**
+   * Clears all aggregated data.
+   */
+  void Clear ();
+
+};
+
+namespace internal
+{
+
+/**
+ * Helper for timing a phase.  It checks for an installed sink when
+ * constructed, and only takes the time if there is one.
+ */
+class PhaseTimer
+{
+
+private:
+
+  /** The sink to report to, null if disabled.  */
+  MetricsSink* const sink;
+
+  /** The start time.  */
+  std::chrono::steady_clock::time_point start;
+
+public:
+
+  PhaseTimer ()
+    : sink(GetMetricsSink ())
+  {
+    if (sink != nullptr)
+      start = std::chrono::steady_clock::now ();
+  }
+
+  PhaseTimer (const PhaseTimer&) = delete;
+  void operator= (const PhaseTimer&) = delete;
+
+  /**
+   * Returns true if metrics are enabled for this phase.
+   */
+  explicit operator bool () const
+  {
+    return sink != nullptr;
+  }
+
+  /**
+   * Returns the time elapsed since construction.
+   */
+  std::chrono::nanoseconds
+  Elapsed () const
+  {
+    return std::chrono::steady_clock::now () - start;
+  }
+
+  /**
+   * Reports the phase as finished to the sink.  Must only be called
+   * if metrics are enabled.
+   */
+  void
+  Finish (const std::string_view fingerprint,
+          const MetricsSink::Phase phase, const bool error) const
+  {
+    MetricsSink::Event ev;
+    ev.fingerprint = fingerprint;
+    ev.phase = phase;
+    ev.duration = Elapsed ();
+    ev.error = error;
+    sink->Record (ev);
+  }
+
+};
+
+} // namespace internal
+
+} // namespace mypp
+
+#endif // MYPP_METRICS_HPP
@@ -0,0 +1,154 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "metrics.hpp"
+
+#include "error.hpp"
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+
+namespace mypp
+{
+namespace
+{
+
+using Phase = MetricsSink::Phase;
+
+TEST (FingerprintSqlTests, Works)
+{
+  EXPECT_EQ (FingerprintSql ("  SELECT *\n\t FROM `test`  "),
+             "SELECT * FROM `test`");
+  EXPECT_EQ (FingerprintSql ("SELECT `a b`, `x1` FROM `t2` WHERE `id` = 42"),
+             "SELECT `a b`, `x1` FROM `t2` WHERE `id` = ?");
+  EXPECT_EQ (FingerprintSql ("UPDATE t SET x = 'it''s', y = \"a\\\"b\""),
+             "UPDATE t SET x = ?, y = ?");
+  EXPECT_EQ (FingerprintSql ("SELECT col1 FROM tab2 WHERE v = -1.5"),
+             "SELECT col1 FROM tab2 WHERE v = -?");
+  EXPECT_EQ (FingerprintSql ("SELECT ? + 1"), "SELECT ? + ?");
+  EXPECT_EQ (FingerprintSql ("SELECT 'unterminated"), "SELECT ?");
+}
+
+TEST (MetricsHistogramTests, Percentiles)
+{
+  MetricsRegistry::Histogram h;
+  EXPECT_EQ (h.Percentile (0.5).count (), 0);
+
+  for (int i = 0; i < 90; ++i)
+    h.Add (std::chrono::microseconds (3));
+  for (int i = 0; i < 10; ++i)
+    h.Add (std::chrono::milliseconds (1));
+
+  EXPECT_EQ (h.count, 100);
+  EXPECT_EQ (h.total, std::chrono::microseconds (90 * 3 + 10 * 1'000));
+  EXPECT_EQ (h.Percentile (0.5).count (), 4);
+  EXPECT_EQ (h.Percentile (0.9).count (), 4);
+  EXPECT_EQ (h.Percentile (0.99).count (), 1'024);
+}
+
+class MetricsTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+  MetricsRegistry registry;
+
+  MetricsTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `test` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `name` VARCHAR(64) NOT NULL
+      )
+    )");
+    SetMetricsSink (&registry);
+  }
+
+  ~MetricsTests ()
+  {
+    SetMetricsSink (nullptr);
+  }
+
+};
+
+TEST_F (MetricsTests, ConnectionExecute)
+{
+  db.Get ().Execute ("INSERT INTO `test` (`id`, `name`) VALUES (1, 'foo')");
+  db.Get ().Execute ("INSERT INTO `test` (`id`, `name`) VALUES (2, 'bar')");
+  EXPECT_THROW (db.Get ().Execute ("INSERT INTO `test` (`id`) VALUES ()"),
+                Error);
+
+  const auto snapshot = registry.GetSnapshot ();
+  const auto mit = snapshot.find (
+      "INSERT INTO `test` (`id`, `name`) VALUES (?, ?)");
+  ASSERT_NE (mit, snapshot.end ());
+  EXPECT_EQ (mit->second.GetLatency (Phase::EXECUTE).count, 2);
+  EXPECT_EQ (mit->second.errors, 0);
+
+  const auto mitErr = snapshot.find ("INSERT INTO `test` (`id`) VALUES ()");
+  ASSERT_NE (mitErr, snapshot.end ());
+  EXPECT_EQ (mitErr->second.errors, 1);
+}
+
+TEST_F (MetricsTests, StatementPhases)
+{
+  db.Get ().Execute (R"(
+    INSERT INTO `test`
+      (`id`, `name`) VALUES (1, 'foo'), (2, 'bar'), (3, 'baz')
+  )");
+  registry.Clear ();
+
+  const std::string sql = "SELECT `id`, `name` FROM `test` WHERE `id` >= ?";
+  Statement stmt(*db.Get ());
+  stmt.Prepare (1, sql);
+  for (int i = 0; i < 2; ++i)
+    {
+      stmt.Reset ();
+      stmt.Bind<int64_t> (0, 2);
+      stmt.Query ();
+      while (stmt.Fetch ())
+        ;
+    }
+
+  /* A result that is not fetched in full is reported on reset.  */
+  stmt.Reset ();
+  stmt.Bind<int64_t> (0, 1);
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  stmt.Reset ();
+
+  const auto snapshot = registry.GetSnapshot ();
+  ASSERT_EQ (snapshot.size (), 1);
+  const auto& stats = snapshot.at (sql);
+  EXPECT_EQ (stats.GetLatency (Phase::PREPARE).count, 1);
+  EXPECT_EQ (stats.GetLatency (Phase::EXECUTE).count, 3);
+  EXPECT_EQ (stats.GetLatency (Phase::STORE_RESULT).count, 3);
+  EXPECT_EQ (stats.GetLatency (Phase::FETCH).count, 3);
+  EXPECT_EQ (stats.rows, 2 + 2 + 1);
+  EXPECT_EQ (stats.bytes, 2 * (8 + 3 + 8 + 3) + 8 + 3);
+  EXPECT_EQ (stats.errors, 0);
+}
+
+TEST_F (MetricsTests, Disabled)
+{
+  SetMetricsSink (nullptr);
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (0, "SELECT `id` FROM `test`");
+  stmt.Query ();
+  EXPECT_FALSE (stmt.Fetch ());
+
+  EXPECT_TRUE (registry.GetSnapshot ().empty ());
+}
+
+} // anonymous namespace
+} // namespace mypp
@@ -0,0 +1,89 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "options.hpp"
+
+#include "error.hpp"
+
+#include <limits>
+
+namespace mypp
+{
+
+namespace
+{
+
+/**
+ * Parses a timeout in seconds from a URL option, if it is present.
+ */
+void
+ParseTimeout (const UrlParser& url, const std::string& name,
+              std::chrono::seconds& value)
+{
+  unsigned long long parsed;
+  if (!url.GetUnsignedOption (name, parsed))
+    return;
+
+  /* The client library takes the timeouts as unsigned int.  */
+  if (parsed > std::numeric_limits<unsigned>::max ())
+    throw Error ("Value for URL option '" + name + "' is too large");
+
+  value = std::chrono::seconds (parsed);
+}
+
+/**
+ * Parses a size in bytes from a URL option, if it is present.
+ */
+void
+ParseSize (const UrlParser& url, const std::string& name,
+           unsigned long& value)
+{
+  unsigned long long parsed;
+  if (!url.GetUnsignedOption (name, parsed))
+    return;
+
+  if (parsed > std::numeric_limits<unsigned long>::max ())
+    throw Error ("Value for URL option '" + name + "' is too large");
+
+  value = parsed;
+}
+
+} // anonymous namespace
+
+void
+ConnectionOptions::ParseUrl (const UrlParser& url)
+{
+  if (url.HasOption ("compress"))
+    {
+      const std::string val = url.GetOption ("compress");
+      if (val == "none")
+        compression = Compression::NONE;
+      else if (val == "zlib")
+        compression = Compression::ZLIB;
+      else if (val == "zstd")
+        throw Error ("zstd compression is not supported by MariaDB");
+      else
+        throw Error ("Invalid value for URL option 'compress'");
+    }
+
+  ParseTimeout (url, "connect_timeout", connectTimeout);
+  ParseTimeout (url, "read_timeout", readTimeout);
+  ParseTimeout (url, "write_timeout", writeTimeout);
+
+  ParseSize (url, "max_allowed_packet", maxAllowedPacket);
+  ParseSize (url, "net_buffer_length", netBufferLength);
+
+  if (url.HasOption ("socket"))
+    unixSocket = url.GetOption ("socket");
+
+  if (url.HasOption ("ssl_ca") || url.HasOption ("ssl_cert")
+        || url.HasOption ("ssl_key"))
+    {
+      sslCa = url.GetOption ("ssl_ca");
+      sslCert = url.GetOption ("ssl_cert");
+      sslKey = url.GetOption ("ssl_key");
+    }
+}
+
+} // namespace mypp
@@ -0,0 +1,70 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_OPTIONS_HPP
+#define MYPP_OPTIONS_HPP
+
+#include "url.hpp"
+
+#include <chrono>
+#include <string>
+
+namespace mypp
+{
+
+/**
+ * Tunable settings for a Connection, which are applied to the handle
+ * before connecting (see Connection::SetOptions).  Zero / empty values
+ * mean that the client library's default is used.
+ *
+ * They can be read from these URL options (see UrlParser):
+ *
+ *  - compress:  "zlib" (the default) or "none" to turn off compression
+ *    of the client/server protocol.
+ *  - connect_timeout, read_timeout, write_timeout:  Timeouts in seconds.
+ *  - max_allowed_packet:  Maximum size of a packet in bytes.
+ *  - net_buffer_length:  Size of the network buffer in bytes.
+ *  - socket:  Path of the unix socket to connect to (instead of TCP).
+ *  - ssl_ca, ssl_cert, ssl_key:  Paths to the files for using a TLS client
+ *    certificate (see Connection::UseClientCertificate).
+ */
+struct ConnectionOptions
+{
+
+  /**
+   * The compression algorithms for the protocol.  MariaDB only
+   * supports zlib.
+   */
+  enum class Compression
+  {
+    NONE,
+    ZLIB,
+  };
+
+  Compression compression = Compression::ZLIB;
+
+  std::chrono::seconds connectTimeout{0};
+  std::chrono::seconds readTimeout{0};
+  std::chrono::seconds writeTimeout{0};
+
+  unsigned long maxAllowedPacket = 0;
+  unsigned long netBufferLength = 0;
+
+  std::string unixSocket;
+
+  std::string sslCa;
+  std::string sslCert;
+  std::string sslKey;
+
+  /**
+   * Sets all options that are present in the given URL, keeping the
+   * others as they are.  Throws mypp::Error if a value is invalid.
+   */
+  void ParseUrl (const UrlParser& url);
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_OPTIONS_HPP
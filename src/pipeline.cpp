@@ -0,0 +1,132 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pipeline.hpp"
+
+#include <glog/logging.h>
+
+#include <chrono>
+
+namespace mypp
+{
+
+namespace
+{
+
+/**
+ * Helper for waiting on the other side of the ring.  It yields for a number
+ * of rounds first, and then sleeps briefly between the checks, so that a
+ * side that has to wait for long does not keep a CPU core busy.
+ */
+class Backoff
+{
+
+private:
+
+  /** Number of rounds to just yield.  */
+  static constexpr unsigned SPIN_ROUNDS = 1'000;
+
+  /** Number of rounds waited so far.  */
+  unsigned rounds = 0;
+
+public:
+
+  void
+  Wait ()
+  {
+    if (rounds < SPIN_ROUNDS)
+      {
+        ++rounds;
+        std::this_thread::yield ();
+      }
+    else
+      std::this_thread::sleep_for (std::chrono::microseconds (50));
+  }
+
+};
+
+} // anonymous namespace
+
+RowPipeline::RowPipeline (Statement& s, const size_t r, const size_t n)
+  : stmt(s), batchRows(r), ring(n),
+    produced(0), consumed(0), done(false), stop(false)
+{
+  CHECK (stmt.GetState () == Statement::State::QUERIED)
+      << "Statement is not in queried state";
+  CHECK_GT (batchRows, 0u);
+  CHECK_GT (ring.size (), 0u);
+
+  producer = std::thread ([this] () { Produce (); });
+}
+
+RowPipeline::~RowPipeline ()
+{
+  stop = true;
+  producer.join ();
+}
+
+void
+RowPipeline::Produce ()
+{
+  try
+    {
+      Backoff backoff;
+      while (!stop.load (std::memory_order_relaxed))
+        {
+          const size_t seq = produced.load (std::memory_order_relaxed);
+          if (seq - consumed.load (std::memory_order_acquire) >= ring.size ())
+            {
+              backoff.Wait ();
+              continue;
+            }
+          backoff = Backoff ();
+
+          auto& batch = ring[seq % ring.size ()];
+          if (stmt.FetchBatch (batch, batchRows) == 0)
+            break;
+
+          produced.store (seq + 1, std::memory_order_release);
+        }
+    }
+  catch (...)
+    {
+      error = std::current_exception ();
+    }
+
+  done.store (true, std::memory_order_release);
+}
+
+const ResultBatch*
+RowPipeline::Next ()
+{
+  if (holding)
+    {
+      consumed.fetch_add (1, std::memory_order_release);
+      holding = false;
+    }
+
+  const size_t seq = consumed.load (std::memory_order_relaxed);
+  Backoff backoff;
+  while (produced.load (std::memory_order_acquire) == seq)
+    {
+      /* The producer may have produced a last batch between our check of
+         produced and reading done, so we have to check again once
+         it is done.  */
+      if (done.load (std::memory_order_acquire))
+        {
+          if (produced.load (std::memory_order_acquire) != seq)
+            break;
+          if (error != nullptr)
+            std::rethrow_exception (error);
+          return nullptr;
+        }
+
+      backoff.Wait ();
+    }
+
+  holding = true;
+  return &ring[seq % ring.size ()];
+}
+
+} // namespace mypp
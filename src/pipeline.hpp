@@ -0,0 +1,115 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_PIPELINE_HPP
+#define MYPP_PIPELINE_HPP
+
+#include "resultbatch.hpp"
+#include "statement.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace mypp
+{
+
+/**
+ * Pipelined consumption of the result of a queried statement:  A producer
+ * thread fetches the rows in batches (see Statement::FetchBatch) into a
+ * bounded ring of reusable ResultBatch buffers, while the consuming thread
+ * processes earlier batches.  This overlaps the network latency and row
+ * decoding with the processing of the rows on large scans.
+ *
+ *   stmt.Query (Statement::ResultMode::STREAMING);
+ *   RowPipeline pipeline(stmt);
+ *   while (const ResultBatch* batch = pipeline.Next ())
+ *     process (*batch);
+ *
+ * The ring is lock-free with a single producer and a single consumer, i.e.
+ * Next must only be called from one thread at a time.  (Batches can of
+ * course be passed on to a pool of workers from there.)  While the pipeline
+ * exists, the statement must not be used otherwise.  If the pipeline is
+ * destructed before all rows have been consumed, the producer is stopped
+ * and the statement is left with the remaining rows unfetched.
+ */
+class RowPipeline
+{
+
+private:
+
+  /** The statement being consumed.  */
+  Statement& stmt;
+
+  /** The maximum number of rows per batch.  */
+  const size_t batchRows;
+
+  /** The ring of batch buffers.  */
+  std::vector<ResultBatch> ring;
+
+  /**
+   * Number of batches produced so far.  The batch with sequence number i
+   * is held in ring[i % ring.size ()].  This is written only by the
+   * producer, and read by the consumer.
+   */
+  std::atomic<size_t> produced;
+
+  /**
+   * Number of batches the consumer is done with (and which can thus be
+   * reused by the producer).  This is written only by the consumer.
+   */
+  std::atomic<size_t> consumed;
+
+  /** Set by the producer when all rows have been fetched (or on error).  */
+  std::atomic<bool> done;
+
+  /** Set by the consumer to stop the producer early.  */
+  std::atomic<bool> stop;
+
+  /** Error that occurred in the producer, if any.  */
+  std::exception_ptr error;
+
+  /** Whether the consumer currently holds a batch from Next.  */
+  bool holding = false;
+
+  /** The producer thread.  */
+  std::thread producer;
+
+  /**
+   * Main loop of the producer thread.
+   */
+  void Produce ();
+
+public:
+
+  /**
+   * Starts the pipeline on the given statement, which must be queried.
+   * Up to numBuffers batches of batchRows rows each are fetched ahead.
+   */
+  explicit RowPipeline (Statement& s, size_t batchRows = 1'024,
+                        size_t numBuffers = 4);
+
+  /**
+   * Stops the producer (if still running) and waits for it.
+   */
+  ~RowPipeline ();
+
+  RowPipeline (const RowPipeline&) = delete;
+  void operator= (const RowPipeline&) = delete;
+
+  /**
+   * Returns the next batch of rows, blocking until it is available, or null
+   * if all rows have been consumed.  The returned batch stays valid until
+   * the next call.  If fetching failed in the producer, the error is
+   * rethrown here (after all batches fetched before it).
+   */
+  const ResultBatch* Next ();
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_PIPELINE_HPP
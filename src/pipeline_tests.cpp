@@ -0,0 +1,126 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pipeline.hpp"
+
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace mypp
+{
+namespace
+{
+
+class RowPipelineTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  /** Number of rows in the test table.  */
+  static constexpr int64_t NUM_ROWS = 1'000;
+
+  RowPipelineTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `test` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `name` VARCHAR(64) NOT NULL
+      )
+    )");
+
+    Statement stmt(db.Get ());
+    stmt.Prepare (2, R"(
+      INSERT INTO `test` (`id`, `name`) VALUES (?, ?)
+    )");
+    for (int64_t i = 0; i < NUM_ROWS; ++i)
+      {
+        stmt.Bind<int64_t> (0, i);
+        stmt.Bind<std::string> (1, "name " + std::to_string (i));
+        stmt.AddBatchRow ();
+      }
+    stmt.ExecuteBatch ();
+  }
+
+  /**
+   * Prepares the given statement for selecting all rows.
+   */
+  static void
+  PrepareSelect (Statement& stmt)
+  {
+    stmt.Prepare (0, R"(
+      SELECT `id`, `name`
+        FROM `test`
+        ORDER BY `id`
+    )");
+  }
+
+};
+
+TEST_F (RowPipelineTests, ConsumesAllRows)
+{
+  Statement stmt(db.Get ());
+  PrepareSelect (stmt);
+
+  for (const auto mode : {Statement::ResultMode::BUFFERED,
+                          Statement::ResultMode::STREAMING})
+    {
+      stmt.Reset ();
+      stmt.Query (mode);
+
+      RowPipeline pipeline(stmt, 64, 3);
+      int64_t next = 0;
+      while (const ResultBatch* batch = pipeline.Next ())
+        {
+          ASSERT_GT (batch->GetNumRows (), 0);
+          for (size_t r = 0; r < batch->GetNumRows (); ++r, ++next)
+            {
+              EXPECT_EQ (batch->GetInts (0)[r], next);
+              EXPECT_EQ (batch->GetView (1, r),
+                         "name " + std::to_string (next));
+            }
+
+          /* Slow down the consumer sometimes, so that the ring fills up
+             and the producer has to wait.  */
+          if (next % 256 == 0)
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+
+      EXPECT_EQ (next, NUM_ROWS);
+      EXPECT_EQ (pipeline.Next (), nullptr);
+      EXPECT_EQ (stmt.GetState (), Statement::State::FINISHED);
+    }
+}
+
+TEST_F (RowPipelineTests, StopsEarly)
+{
+  Statement stmt(db.Get ());
+  PrepareSelect (stmt);
+  stmt.Query (Statement::ResultMode::STREAMING);
+  {
+    RowPipeline pipeline(stmt, 10, 2);
+    const ResultBatch* batch = pipeline.Next ();
+    ASSERT_NE (batch, nullptr);
+    EXPECT_EQ (batch->GetInts (0)[0], 0);
+  }
+
+  /* The statement can be reused afterwards.  */
+  stmt.Reset ();
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 0);
+}
+
+} // anonymous namespace
+} // namespace mypp
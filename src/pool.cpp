@@ -0,0 +1,460 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pool.hpp"
+
+#include "error.hpp"
+
+#include <glog/logging.h>
+
+namespace mypp
+{
+
+namespace
+{
+
+/**
+ * Returns an index for the current thread, which is used to select the shard
+ * of idle connections it should use first.  Each thread gets assigned
+ * the next index when it first calls this, so that threads are spread evenly
+ * across shards.
+ */
+size_t
+ThreadIndex ()
+{
+  static std::atomic<size_t> next(0);
+  thread_local const size_t index = next++;
+  return index;
+}
+
+/**
+ * Returns a fresh ID for a connection pool.
+ */
+uint64_t
+NextPoolId ()
+{
+  static std::atomic<uint64_t> next(0);
+  return next++;
+}
+
+/**
+ * Parses an unsigned integer from a URL option, if it is present.
+ * Throws if the value is invalid.
+ */
+template <typename T>
+  void
+  ParseOption (const UrlParser& url, const std::string& name, T& value)
+{
+  unsigned long long parsed;
+  if (url.GetUnsignedOption (name, parsed))
+    value = T (parsed);
+}
+
+} // anonymous namespace
+
+/* ************************************************************************** */
+
+ConnectionPool::Lease::Lease (ConnectionPool& p, std::unique_ptr<Entry> e)
+  : pool(&p), entry(std::move (e))
+{}
+
+ConnectionPool::Lease&
+ConnectionPool::Lease::operator= (Lease&& o)
+{
+  if (this == &o)
+    return *this;
+
+  if (entry != nullptr)
+    pool->Release (std::move (entry));
+
+  pool = o.pool;
+  entry = std::move (o.entry);
+
+  return *this;
+}
+
+ConnectionPool::Lease::~Lease ()
+{
+  if (entry != nullptr)
+    pool->Release (std::move (entry));
+}
+
+void
+ConnectionPool::Lease::Discard ()
+{
+  CHECK (entry != nullptr) << "Lease does not hold a connection";
+  pool->Discard (std::move (entry));
+}
+
+/* ************************************************************************** */
+
+/**
+ * The connections bound to one thread.  When the thread exits, they are
+ * returned to their pools (unless those are gone already).
+ */
+struct ConnectionPool::ThreadBindings
+{
+
+  /**
+   * Data about one bound connection.
+   */
+  struct Binding
+  {
+    std::weak_ptr<BoundState> state;
+    Entry* entry;
+  };
+
+  /** The bindings by pool ID.  */
+  std::unordered_map<uint64_t, Binding> byPool;
+
+  ThreadBindings () = default;
+
+  ThreadBindings (const ThreadBindings&) = delete;
+  void operator= (const ThreadBindings&) = delete;
+
+  ~ThreadBindings ()
+  {
+    for (const auto& entry : byPool)
+      {
+        const auto state = entry.second.state.lock ();
+        if (state != nullptr)
+          Unbind (*state, entry.second.entry, false);
+      }
+  }
+
+};
+
+ConnectionPool::ThreadBindings&
+ConnectionPool::GetThreadBindings ()
+{
+  thread_local ThreadBindings bindings;
+  return bindings;
+}
+
+/* ************************************************************************** */
+
+ConnectionPool::ConnectionPool (const std::string& u)
+  : numConnections(0), numWaiting(0), waitGeneration(0),
+    id(NextPoolId ()), boundState(std::make_shared<BoundState> ())
+{
+  boundState->pool = this;
+  url.Parse (u);
+
+  ParseOption (url, "pool_min", config.minSize);
+  ParseOption (url, "pool_max", config.maxSize);
+  ParseOption (url, "pool_idle_timeout", config.idleTimeout);
+  ParseOption (url, "pool_ping_interval", config.pingInterval);
+
+  Construct ();
+}
+
+ConnectionPool::ConnectionPool (const std::string& u, const Config& cfg)
+  : config(cfg), numConnections(0), numWaiting(0), waitGeneration(0),
+    id(NextPoolId ()), boundState(std::make_shared<BoundState> ())
+{
+  boundState->pool = this;
+  url.Parse (u);
+  Construct ();
+}
+
+ConnectionPool::~ConnectionPool ()
+{
+  /* Connections bound to threads are closed here.  Threads exiting later
+     see that the pool is gone and leave them alone.  A thread returning
+     its connection right now holds the lock, so we wait for it.  */
+  GetThreadBindings ().byPool.erase (id);
+  size_t numIdle;
+  {
+    std::lock_guard<std::mutex> lock(boundState->lock);
+    boundState->pool = nullptr;
+    numIdle = boundState->bound.size ();
+    boundState->bound.clear ();
+  }
+
+  for (auto& shard : shards)
+    {
+      std::lock_guard<std::mutex> lock(shard.lock);
+      numIdle += shard.idle.size ();
+    }
+
+  CHECK_EQ (numIdle, numConnections)
+      << "Connection pool destructed while leases are still active";
+}
+
+void
+ConnectionPool::Construct ()
+{
+  options.ParseUrl (url);
+
+  if (config.maxSize == 0)
+    throw Error ("Connection pool must have a positive maximum size");
+  if (config.minSize > config.maxSize)
+    throw Error ("Connection pool minimum size is larger than the maximum");
+
+  for (size_t i = 0; i < config.minSize; ++i)
+    {
+      auto entry = OpenConnection ();
+      entry->lastUsed = std::chrono::steady_clock::now ();
+      shards[i % NUM_SHARDS].idle.push_back (std::move (entry));
+      ++numConnections;
+    }
+}
+
+std::unique_ptr<ConnectionPool::Entry>
+ConnectionPool::OpenConnection () const
+{
+  auto entry = std::make_unique<Entry> ();
+
+  entry->connection.SetOptions (options);
+  entry->connection.Connect (url.GetHost (), url.GetPort (),
+                             url.GetUser (), url.GetPassword (),
+                             url.GetDatabase ());
+
+  return entry;
+}
+
+std::unique_ptr<ConnectionPool::Entry>
+ConnectionPool::TakeIdle ()
+{
+  const size_t start = ThreadIndex ();
+  for (size_t i = 0; i < NUM_SHARDS; ++i)
+    {
+      auto& shard = shards[(start + i) % NUM_SHARDS];
+      while (true)
+        {
+          std::unique_ptr<Entry> entry;
+          {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            if (shard.idle.empty ())
+              break;
+            entry = std::move (shard.idle.back ());
+            shard.idle.pop_back ();
+          }
+
+          const auto idleFor
+              = std::chrono::steady_clock::now () - entry->lastUsed;
+
+          if (idleFor > config.idleTimeout
+                && numConnections > config.minSize)
+            {
+              Discard (std::move (entry));
+              continue;
+            }
+
+          if (idleFor > config.pingInterval && !entry->connection.Ping ())
+            {
+              LOG (WARNING) << "Dropping broken connection from the pool";
+              Discard (std::move (entry));
+              continue;
+            }
+
+          return entry;
+        }
+    }
+
+  return nullptr;
+}
+
+std::unique_ptr<ConnectionPool::Entry>
+ConnectionPool::TryOpen ()
+{
+  size_t cur = numConnections;
+  while (cur < config.maxSize)
+    {
+      if (!numConnections.compare_exchange_weak (cur, cur + 1))
+        continue;
+
+      try
+        {
+          return OpenConnection ();
+        }
+      catch (...)
+        {
+          --numConnections;
+          NotifyWaiting ();
+          throw;
+        }
+    }
+
+  return nullptr;
+}
+
+ConnectionPool::Lease
+ConnectionPool::Acquire ()
+{
+  auto entry = TakeIdle ();
+  if (entry == nullptr)
+    entry = TryOpen ();
+  if (entry != nullptr)
+    return Lease (*this, std::move (entry));
+
+  /* The pool is fully in use, so we have to wait until some connection is
+     released.  Threads returning a connection check numWaiting, and only
+     if it is non-zero, they take the wait lock and notify us.  Since we
+     increment numWaiting before checking the shards again, we cannot
+     miss a connection that is being returned concurrently.  */
+  ++numWaiting;
+  while (true)
+    {
+      const uint64_t gen = waitGeneration;
+
+      try
+        {
+          entry = TakeIdle ();
+          if (entry == nullptr)
+            entry = TryOpen ();
+        }
+      catch (...)
+        {
+          --numWaiting;
+          throw;
+        }
+
+      if (entry != nullptr)
+        break;
+
+      /* The timeout is just a safety net, we should be woken up
+         explicitly anyway when a connection becomes available.  */
+      std::unique_lock<std::mutex> lock(waitLock);
+      waitCv.wait_for (lock, std::chrono::milliseconds (100), [this, gen] ()
+        {
+          return waitGeneration != gen;
+        });
+    }
+  --numWaiting;
+
+  return Lease (*this, std::move (entry));
+}
+
+void
+ConnectionPool::Release (std::unique_ptr<Entry> entry)
+{
+  entry->lastUsed = std::chrono::steady_clock::now ();
+
+  auto& shard = shards[ThreadIndex () % NUM_SHARDS];
+  {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.idle.push_back (std::move (entry));
+  }
+
+  NotifyWaiting ();
+}
+
+void
+ConnectionPool::Discard (std::unique_ptr<Entry> entry)
+{
+  entry.reset ();
+  --numConnections;
+  NotifyWaiting ();
+}
+
+Connection&
+ConnectionPool::GetThreadConnection ()
+{
+  auto& bindings = GetThreadBindings ().byPool;
+
+  auto mit = bindings.find (id);
+  if (mit != bindings.end ())
+    return mit->second.entry->connection;
+
+  /* Drop bindings of pools that have been destructed in the mean time, so
+     that they do not accumulate for long-running threads.  Since pool IDs
+     are never reused, they would not be found again anyway.  */
+  for (auto it = bindings.begin (); it != bindings.end (); )
+    if (it->second.state.expired ())
+      it = bindings.erase (it);
+    else
+      ++it;
+
+  auto lease = Acquire ();
+  Entry* const entry = lease.entry.get ();
+  {
+    std::lock_guard<std::mutex> lock(boundState->lock);
+    boundState->bound.emplace (entry, std::move (lease.entry));
+  }
+
+  ThreadBindings::Binding b;
+  b.state = boundState;
+  b.entry = entry;
+  bindings.emplace (id, std::move (b));
+
+  return entry->connection;
+}
+
+void
+ConnectionPool::ReleaseThreadConnection (const bool discard)
+{
+  auto& bindings = GetThreadBindings ().byPool;
+
+  auto mit = bindings.find (id);
+  if (mit == bindings.end ())
+    return;
+
+  Entry* const entry = mit->second.entry;
+  bindings.erase (mit);
+  Unbind (*boundState, entry, discard);
+}
+
+void
+ConnectionPool::Unbind (BoundState& state, Entry* entry, const bool discard)
+{
+  std::lock_guard<std::mutex> lock(state.lock);
+
+  /* If the pool is being destructed, it has closed the connection
+     already (or will do so).  */
+  if (state.pool == nullptr)
+    return;
+
+  auto mit = state.bound.find (entry);
+  CHECK (mit != state.bound.end ()) << "Connection is not bound";
+  auto owned = std::move (mit->second);
+  state.bound.erase (mit);
+
+  /* The lock is kept while using the pool, which makes the destructor
+     wait until we are done.  */
+  if (discard)
+    state.pool->Discard (std::move (owned));
+  else
+    state.pool->Release (std::move (owned));
+}
+
+void
+ConnectionPool::NotifyWaiting ()
+{
+  if (numWaiting == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(waitLock);
+  ++waitGeneration;
+  waitCv.notify_all ();
+}
+
+void
+ConnectionPool::PruneIdle ()
+{
+  const auto now = std::chrono::steady_clock::now ();
+
+  for (auto& shard : shards)
+    {
+      std::vector<std::unique_ptr<Entry>> toClose;
+      {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto& idle = shard.idle;
+        for (auto it = idle.begin (); it != idle.end (); )
+          {
+            if (now - (*it)->lastUsed > config.idleTimeout
+                  && numConnections > config.minSize)
+              {
+                toClose.push_back (std::move (*it));
+                it = idle.erase (it);
+                --numConnections;
+              }
+            else
+              ++it;
+          }
+      }
+    }
+}
+
+} // namespace mypp
@@ -0,0 +1,353 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_POOL_HPP
+#define MYPP_POOL_HPP
+
+#include "connection.hpp"
+#include "options.hpp"
+#include "url.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mypp
+{
+
+/**
+ * A thread-safe pool of database connections to one server and database.
+ * Threads acquire connections as RAII leases, which return the connection
+ * to the pool when they go out of scope.  New connections are established
+ * lazily as needed (up to a maximum size), and idle connections are checked
+ * with a ping before they are handed out again.
+ *
+ * Idle connections are kept in multiple shards, each with its own lock,
+ * so that concurrent threads acquiring and releasing connections do not
+ * contend on a single global lock.
+ *
+ * The pool can be configured from a URL (see UrlParser), with these
+ * options in addition to the connection parameters:
+ *
+ *  - pool_min:  Number of connections to establish right away and to keep
+ *    even when idle (default 0).
+ *  - pool_max:  Maximum number of connections (default 16).
+ *  - pool_idle_timeout:  Seconds after which idle connections above the
+ *    minimum size are closed (default 300).
+ *  - pool_ping_interval:  Connections idle for longer than this many
+ *    seconds are pinged before being handed out (default 30).
+ *
+ * Options for the connections themselves (like TLS client certificates or
+ * timeouts) are supported as well, see ConnectionOptions.
+ */
+class ConnectionPool
+{
+
+public:
+
+  /**
+   * Configuration settings for the pool.
+   */
+  struct Config
+  {
+    size_t minSize = 0;
+    size_t maxSize = 16;
+    std::chrono::seconds idleTimeout = std::chrono::seconds (300);
+    std::chrono::seconds pingInterval = std::chrono::seconds (30);
+  };
+
+private:
+
+  /**
+   * A connection managed by the pool, together with the associated data.
+   */
+  struct Entry
+  {
+
+    /** The actual connection.  */
+    Connection connection;
+
+    /** The time when the connection was last returned to the pool.  */
+    std::chrono::steady_clock::time_point lastUsed;
+
+  };
+
+  /**
+   * One shard of idle connections.  It is aligned to avoid false sharing
+   * between the locks of different shards.
+   */
+  struct alignas (64) Shard
+  {
+    std::mutex lock;
+    std::vector<std::unique_ptr<Entry>> idle;
+  };
+
+  /** Number of shards used for the idle connections.  */
+  static constexpr size_t NUM_SHARDS = 16;
+
+  /** The parsed URL with the connection settings.  */
+  UrlParser url;
+
+  /** The connection options parsed from the URL.  */
+  ConnectionOptions options;
+
+  /** The pool configuration.  */
+  Config config;
+
+  /** The shards holding idle connections.  */
+  Shard shards[NUM_SHARDS];
+
+  /** Total number of connections (idle and leased).  */
+  std::atomic<size_t> numConnections;
+
+  /** Number of threads currently waiting for a connection.  */
+  std::atomic<size_t> numWaiting;
+
+  /**
+   * Counter incremented (while holding waitLock) whenever waiting threads
+   * are notified.  Waiters use it to detect notifications that happened
+   * between checking for connections and starting to wait.
+   */
+  std::atomic<uint64_t> waitGeneration;
+
+  /**
+   * Lock used together with waitCv for threads that wait for a connection
+   * to become available.  This is only used on the slow path, when the
+   * pool is fully in use.
+   */
+  std::mutex waitLock;
+
+  /** Condition variable notified when connections become available.  */
+  std::condition_variable waitCv;
+
+  /**
+   * Unique ID of this pool (never reused), which identifies it in the
+   * thread-local bindings.
+   */
+  const uint64_t id;
+
+  /**
+   * The connections bound to threads (see GetThreadConnection).  This is
+   * shared with the threads holding bindings, so that a thread exiting
+   * concurrently with the pool's destruction can safely tell whether
+   * the pool is still there.
+   */
+  struct BoundState
+  {
+
+    /** Lock for the data.  */
+    std::mutex lock;
+
+    /** The pool, or null once it is being destructed.  */
+    ConnectionPool* pool;
+
+    /** The bound connections.  */
+    std::unordered_map<Entry*, std::unique_ptr<Entry>> bound;
+
+  };
+
+  /** The state of bound connections.  */
+  const std::shared_ptr<BoundState> boundState;
+
+  /**
+   * The connections bound to the calling thread, for all pools.
+   */
+  struct ThreadBindings;
+
+  /**
+   * Returns the thread-local bindings of the calling thread.
+   */
+  static ThreadBindings& GetThreadBindings ();
+
+  /**
+   * Takes a bound connection out of the bound set, and returns it to the
+   * pool or discards it (depending on discard).  If the pool is gone
+   * already, nothing is done.  The pool is used while the state's lock
+   * is held, so that it cannot be destructed concurrently.
+   */
+  static void Unbind (BoundState& state, Entry* entry, bool discard);
+
+  /**
+   * Opens a new connection based on the URL.
+   */
+  std::unique_ptr<Entry> OpenConnection () const;
+
+  /**
+   * Tries to take an idle connection from one of the shards.  Returns null
+   * if there is none.  Idle connections that are timed out or fail the
+   * health check are closed.
+   */
+  std::unique_ptr<Entry> TakeIdle ();
+
+  /**
+   * Tries to open a new connection if the pool is not at its maximum size
+   * yet.  Returns null if it is.
+   */
+  std::unique_ptr<Entry> TryOpen ();
+
+  /**
+   * Returns a connection from a lease back to the pool.
+   */
+  void Release (std::unique_ptr<Entry> entry);
+
+  /**
+   * Closes a connection from a lease, removing it from the pool.
+   */
+  void Discard (std::unique_ptr<Entry> entry);
+
+  /**
+   * Wakes up a thread waiting for a connection, if there is any.
+   */
+  void NotifyWaiting ();
+
+  /**
+   * Performs the shared construction logic.
+   */
+  void Construct ();
+
+public:
+
+  /**
+   * RAII lease of a connection from the pool.  While the lease is active,
+   * the calling thread has exclusive use of the connection.  When it is
+   * destructed, the connection is returned to the pool.
+   */
+  class Lease
+  {
+
+  private:
+
+    /** The pool this belongs to.  */
+    ConnectionPool* pool = nullptr;
+
+    /** The pool entry held.  */
+    std::unique_ptr<Entry> entry;
+
+    explicit Lease (ConnectionPool& p, std::unique_ptr<Entry> e);
+
+    friend class ConnectionPool;
+
+  public:
+
+    Lease () = default;
+    Lease (Lease&&) = default;
+    Lease& operator= (Lease&& o);
+
+    Lease (const Lease&) = delete;
+    void operator= (const Lease&) = delete;
+
+    ~Lease ();
+
+    /**
+     * Returns true if this lease holds a connection.
+     */
+    explicit
+    operator bool () const
+    {
+      return entry != nullptr;
+    }
+
+    Connection&
+    operator* ()
+    {
+      return entry->connection;
+    }
+
+    Connection*
+    operator-> ()
+    {
+      return &entry->connection;
+    }
+
+    /**
+     * Closes the connection instead of returning it to the pool.  This
+     * should be used if the connection is known to be broken, or has been
+     * left in a state that should not leak to other users.
+     */
+    void Discard ();
+
+  };
+
+  /**
+   * Constructs the pool from a URL, including the pool settings
+   * specified as options on it.  Throws mypp::Error if the options
+   * are invalid.
+   */
+  explicit ConnectionPool (const std::string& url);
+
+  /**
+   * Constructs the pool with an explicit configuration.  Pool options
+   * on the URL are ignored in this case.
+   */
+  explicit ConnectionPool (const std::string& url, const Config& cfg);
+
+  /**
+   * Closes all connections.  All leases must have been returned already.
+   */
+  ~ConnectionPool ();
+
+  ConnectionPool (const ConnectionPool&) = delete;
+  void operator= (const ConnectionPool&) = delete;
+
+  /**
+   * Acquires a connection from the pool.  If none is idle and the pool is
+   * at its maximum size, this blocks until one is released.  Throws
+   * mypp::Error if a new connection needs to be established and that fails.
+   */
+  Lease Acquire ();
+
+  /**
+   * Returns a connection bound to the calling thread.  On the first call
+   * from a thread, a connection is acquired (like with Acquire) and bound
+   * to the thread.  Later calls return the same connection without any
+   * locking, until it is released with ReleaseThreadConnection or when
+   * the thread exits.  Connections still bound are closed when the pool
+   * is destructed, which must not happen while other threads use them.
+   */
+  Connection& GetThreadConnection ();
+
+  /**
+   * Returns the connection bound to the calling thread (if any) to
+   * the pool.  If discard is true, it is closed instead (e.g. because
+   * it is known to be broken).
+   */
+  void ReleaseThreadConnection (bool discard = false);
+
+  /**
+   * Closes idle connections that have timed out, as long as the pool has
+   * more than its minimum size.  This is done lazily also when acquiring
+   * connections, but can be called explicitly (e.g. periodically).
+   */
+  void PruneIdle ();
+
+  /**
+   * Returns the total number of connections currently open.
+   */
+  size_t
+  GetNumConnections () const
+  {
+    return numConnections;
+  }
+
+  /**
+   * Returns the configuration in use.
+   */
+  const Config&
+  GetConfig () const
+  {
+    return config;
+  }
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_POOL_HPP
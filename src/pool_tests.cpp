@@ -0,0 +1,260 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pool.hpp"
+
+#include "error.hpp"
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mypp
+{
+namespace
+{
+
+class PoolTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  PoolTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+  }
+
+  /**
+   * Returns the URL for our temp db with the given options.
+   */
+  static std::string
+  GetUrl (const std::string& opt)
+  {
+    return AddUrlOption (GetTempDbUrl (), opt);
+  }
+
+};
+
+TEST_F (PoolTests, ReusesConnections)
+{
+  ConnectionPool pool(GetUrl ("pool_max=2"));
+  EXPECT_EQ (pool.GetConfig ().maxSize, 2);
+  EXPECT_EQ (pool.GetNumConnections (), 0);
+
+  Connection* first;
+  {
+    auto lease = pool.Acquire ();
+    ASSERT_TRUE (lease);
+    first = &*lease;
+    lease->Execute ("DO 1");
+  }
+  EXPECT_EQ (pool.GetNumConnections (), 1);
+
+  auto lease = pool.Acquire ();
+  EXPECT_EQ (&*lease, first);
+  EXPECT_EQ (pool.GetNumConnections (), 1);
+
+  /* While the first lease is active, another connection is opened.  */
+  auto other = pool.Acquire ();
+  EXPECT_NE (&*other, first);
+  EXPECT_EQ (pool.GetNumConnections (), 2);
+}
+
+TEST_F (PoolTests, LeaseSelfMoveAssignment)
+{
+  ConnectionPool pool(GetUrl ("pool_max=1"));
+
+  auto lease = pool.Acquire ();
+  Connection* conn = &*lease;
+
+  /* Go through a reference so that the compiler does not warn.  */
+  auto& same = lease;
+  lease = std::move (same);
+  ASSERT_TRUE (lease);
+  EXPECT_EQ (&*lease, conn);
+  lease->Execute ("DO 1");
+  EXPECT_EQ (pool.GetNumConnections (), 1);
+}
+
+TEST_F (PoolTests, MinimumSize)
+{
+  ConnectionPool pool(GetUrl ("pool_min=3&pool_max=5"));
+  EXPECT_EQ (pool.GetNumConnections (), 3);
+
+  /* With a zero timeout, all idle connections are timed out, but the pool
+     keeps the minimum number open.  */
+  ConnectionPool::Config cfg;
+  cfg.minSize = 1;
+  cfg.maxSize = 3;
+  cfg.idleTimeout = std::chrono::seconds (0);
+  ConnectionPool pruned(GetTempDbUrl (), cfg);
+  {
+    auto a = pruned.Acquire ();
+    auto b = pruned.Acquire ();
+    auto c = pruned.Acquire ();
+  }
+  EXPECT_EQ (pruned.GetNumConnections (), 3);
+  std::this_thread::sleep_for (std::chrono::milliseconds (10));
+  pruned.PruneIdle ();
+  EXPECT_EQ (pruned.GetNumConnections (), 1);
+}
+
+TEST_F (PoolTests, InvalidOptions)
+{
+  EXPECT_THROW (ConnectionPool pool(GetUrl ("pool_max=abc")), Error);
+  EXPECT_THROW (ConnectionPool pool(GetUrl ("pool_max=-1")), Error);
+  EXPECT_THROW (ConnectionPool pool(GetUrl ("pool_max=0")), Error);
+  EXPECT_THROW (ConnectionPool pool(GetUrl ("pool_min=5&pool_max=2")), Error);
+}
+
+TEST_F (PoolTests, Discard)
+{
+  ConnectionPool pool(GetUrl ("pool_max=2"));
+
+  auto lease = pool.Acquire ();
+  EXPECT_EQ (pool.GetNumConnections (), 1);
+  lease.Discard ();
+  EXPECT_FALSE (lease);
+  EXPECT_EQ (pool.GetNumConnections (), 0);
+}
+
+TEST_F (PoolTests, BlocksWhenExhausted)
+{
+  ConnectionPool pool(GetUrl ("pool_max=1"));
+
+  auto lease = pool.Acquire ();
+  std::atomic<bool> acquired(false);
+  std::thread waiter([&] ()
+    {
+      auto other = pool.Acquire ();
+      acquired = true;
+    });
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (50));
+  EXPECT_FALSE (acquired);
+
+  lease = ConnectionPool::Lease ();
+  waiter.join ();
+  EXPECT_TRUE (acquired);
+  EXPECT_EQ (pool.GetNumConnections (), 1);
+}
+
+TEST_F (PoolTests, ConcurrentUse)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY
+    )
+  )");
+
+  constexpr int numThreads = 8;
+  constexpr int perThread = 50;
+
+  ConnectionPool pool(GetUrl ("pool_max=4"));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; ++t)
+    threads.emplace_back ([&pool, t] ()
+      {
+        for (int i = 0; i < perThread; ++i)
+          {
+            auto lease = pool.Acquire ();
+            Statement stmt(**lease);
+            stmt.Prepare (1, "INSERT INTO `test` (`id`) VALUES (?)");
+            stmt.Bind<int64_t> (0, t * perThread + i);
+            stmt.Execute ();
+          }
+      });
+  for (auto& t : threads)
+    t.join ();
+
+  EXPECT_LE (pool.GetNumConnections (), 4);
+
+  Statement stmt(db.GetMySql ());
+  stmt.Prepare (0, "SELECT COUNT(*) AS `cnt` FROM `test`");
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("cnt"), numThreads * perThread);
+}
+
+TEST_F (PoolTests, ThreadConnection)
+{
+  ConnectionPool pool(GetUrl ("pool_max=2"));
+
+  Connection& conn = pool.GetThreadConnection ();
+  EXPECT_EQ (&pool.GetThreadConnection (), &conn);
+  EXPECT_EQ (pool.GetNumConnections (), 1);
+
+  /* Another thread gets its own connection.  */
+  Connection* other = nullptr;
+  std::thread ([&pool, &other] ()
+    {
+      other = &pool.GetThreadConnection ();
+    }).join ();
+  EXPECT_NE (other, &conn);
+  EXPECT_EQ (pool.GetNumConnections (), 2);
+
+  /* The other thread's connection has been returned when it exited, and
+     our own is returned explicitly.  */
+  auto lease = pool.Acquire ();
+  EXPECT_EQ (&*lease, other);
+  pool.ReleaseThreadConnection ();
+  auto second = pool.Acquire ();
+  EXPECT_EQ (&*second, &conn);
+  EXPECT_EQ (pool.GetNumConnections (), 2);
+}
+
+TEST_F (PoolTests, DiscardThreadConnection)
+{
+  ConnectionPool pool(GetUrl ("pool_max=1"));
+  pool.GetThreadConnection ();
+  EXPECT_EQ (pool.GetNumConnections (), 1);
+  pool.ReleaseThreadConnection (true);
+  EXPECT_EQ (pool.GetNumConnections (), 0);
+
+  /* Releasing without a bound connection does nothing.  */
+  pool.ReleaseThreadConnection ();
+}
+
+TEST_F (PoolTests, DestructedWithThreadConnections)
+{
+  /* Bound connections are closed with the pool, and a thread exiting
+     after the pool is gone does not touch it.  */
+  auto pool = std::make_unique<ConnectionPool> (GetUrl ("pool_max=2"));
+  pool->GetThreadConnection ().Execute ("DO 1");
+
+  std::atomic<bool> bound(false);
+  std::atomic<bool> destructed(false);
+  std::thread thread([&pool, &bound, &destructed] ()
+    {
+      pool->GetThreadConnection ();
+      bound = true;
+      while (!destructed)
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    });
+
+  while (!bound)
+    std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  pool.reset ();
+  destructed = true;
+  thread.join ();
+
+  /* A new pool does not pick up stale bindings of the old one.  */
+  ConnectionPool fresh(GetUrl ("pool_max=1"));
+  fresh.GetThreadConnection ().Execute ("DO 1");
+  EXPECT_EQ (fresh.GetNumConnections (), 1);
+}
+
+} // anonymous namespace
+} // namespace mypp
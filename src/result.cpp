@@ -0,0 +1,109 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "result.hpp"
+
+#include <glog/logging.h>
+
+#include <charconv>
+
+namespace mypp
+{
+
+ResultSet::ResultSet (MYSQL_RES* r)
+  : res(r)
+{
+  CHECK (res != nullptr);
+
+  const unsigned numFields = mysql_num_fields (res);
+  for (unsigned i = 0; i < numFields; ++i)
+    columnsByName.emplace (mysql_fetch_field_direct (res, i)->name, i);
+}
+
+ResultSet::~ResultSet ()
+{
+  mysql_free_result (res);
+}
+
+uint64_t
+ResultSet::GetNumRows () const
+{
+  return mysql_num_rows (res);
+}
+
+unsigned
+ResultSet::GetNumColumns () const
+{
+  return mysql_num_fields (res);
+}
+
+bool
+ResultSet::Next ()
+{
+  row = mysql_fetch_row (res);
+  if (row == nullptr)
+    {
+      lengths = nullptr;
+      return false;
+    }
+
+  lengths = mysql_fetch_lengths (res);
+  CHECK (lengths != nullptr);
+  return true;
+}
+
+unsigned
+ResultSet::GetIndex (const std::string& col) const
+{
+  CHECK (row != nullptr) << "There is no current row";
+  auto mit = columnsByName.find (col);
+  CHECK (mit != columnsByName.end ())
+      << "Column '" << col << "' is not in the result set";
+  return mit->second;
+}
+
+bool
+ResultSet::IsNull (const std::string& col) const
+{
+  return row[GetIndex (col)] == nullptr;
+}
+
+std::string_view
+ResultSet::GetView (const std::string& col) const
+{
+  const unsigned ind = GetIndex (col);
+  CHECK (row[ind] != nullptr) << "Column '" << col << "' is null";
+  return std::string_view (row[ind], lengths[ind]);
+}
+
+template <>
+  int64_t
+  ResultSet::Get<int64_t> (const std::string& col) const
+{
+  const auto str = GetView (col);
+
+  int64_t res;
+  const auto parsed = std::from_chars (str.data (), str.data () + str.size (),
+                                       res);
+  CHECK (parsed.ec == std::errc () && parsed.ptr == str.data () + str.size ())
+      << "Value of '" << col << "' is not a valid int64_t: " << str;
+
+  return res;
+}
+
+template <>
+  bool
+  ResultSet::Get<bool> (const std::string& col) const
+{
+  return Get<int64_t> (col) != 0;
+}
+
+template <>
+  std::string
+  ResultSet::Get<std::string> (const std::string& col) const
+{
+  return std::string (GetView (col));
+}
+
+} // namespace mypp
@@ -0,0 +1,97 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_RESULT_HPP
+#define MYPP_RESULT_HPP
+
+#include <mysql.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace mypp
+{
+
+/**
+ * RAII wrapper around a MYSQL_RES result set of a query sent through
+ * the text protocol (e.g. as part of Connection::QueryBatch).  All rows
+ * are stored on the client, and can be stepped through with Next.
+ * Values are accessed without copying out of the underlying result.
+ */
+class ResultSet
+{
+
+private:
+
+  /** The underlying result.  */
+  MYSQL_RES* res;
+
+  /** The current row, if any.  */
+  MYSQL_ROW row = nullptr;
+
+  /** The lengths of the values in the current row.  */
+  unsigned long* lengths = nullptr;
+
+  /** Map of column names to their indices.  */
+  std::unordered_map<std::string, unsigned> columnsByName;
+
+  /**
+   * Returns the index of the named column, and verifies that we have
+   * a current row.
+   */
+  unsigned GetIndex (const std::string& col) const;
+
+public:
+
+  /**
+   * Constructs the instance, taking ownership of the given result.
+   */
+  explicit ResultSet (MYSQL_RES* r);
+
+  ~ResultSet ();
+
+  ResultSet (const ResultSet&) = delete;
+  void operator= (const ResultSet&) = delete;
+
+  /**
+   * Returns the total number of rows in the result.
+   */
+  uint64_t GetNumRows () const;
+
+  /**
+   * Returns the number of columns in the result.
+   */
+  unsigned GetNumColumns () const;
+
+  /**
+   * Steps to the next row.  Returns false if there are no more.
+   */
+  bool Next ();
+
+  /**
+   * Checks if the given column of the current row is null.
+   */
+  bool IsNull (const std::string& col) const;
+
+  /**
+   * Returns a view of the given column's value in the current row, which
+   * is valid as long as this instance exists.
+   */
+  std::string_view GetView (const std::string& col) const;
+
+  /**
+   * Returns the value of the given column in the current row, parsed to
+   * the given type (int64_t, bool or std::string).  The value must not
+   * be null.
+   */
+  template <typename T>
+    T Get (const std::string& col) const;
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_RESULT_HPP
@@ -0,0 +1,224 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "resultbatch.hpp"
+
+#include <glog/logging.h>
+
+namespace mypp
+{
+
+void
+ResultBatch::Reset (const size_t n)
+{
+  if (columns.size () < n)
+    columns.resize (n);
+
+  numColumns = n;
+  numRows = 0;
+
+  for (size_t i = 0; i < numColumns; ++i)
+    {
+      auto& c = columns[i];
+      c.ints.clear ();
+      c.uints.clear ();
+      c.doubles.clear ();
+      c.times.clear ();
+      c.nulls.clear ();
+      c.offsets.clear ();
+      c.data.clear ();
+    }
+}
+
+void
+ResultBatch::SetType (const size_t col, const Type t)
+{
+  CHECK_LT (col, numColumns);
+  CHECK_EQ (numRows, 0u) << "Column type can only be set before adding rows";
+
+  auto& c = columns[col];
+  c.type = t;
+  if (t == Type::STRING)
+    c.offsets.push_back (0);
+}
+
+void
+ResultBatch::AddRow ()
+{
+  if (numRows % 8 == 0)
+    for (size_t i = 0; i < numColumns; ++i)
+      columns[i].nulls.push_back (0);
+
+  ++numRows;
+}
+
+void
+ResultBatch::AppendNull (const size_t col)
+{
+  auto& c = columns[col];
+  const size_t row = numRows - 1;
+  c.nulls[row / 8] |= (1 << (row % 8));
+
+  switch (c.type)
+    {
+    case Type::INT:
+      c.ints.push_back (0);
+      break;
+    case Type::UINT:
+      c.uints.push_back (0);
+      break;
+    case Type::DOUBLE:
+      c.doubles.push_back (0.0);
+      break;
+    case Type::TIME:
+      c.times.push_back (MYSQL_TIME ());
+      break;
+    case Type::STRING:
+      c.offsets.push_back (c.data.size ());
+      break;
+    }
+}
+
+void
+ResultBatch::AppendInt (const size_t col, const int64_t val)
+{
+  columns[col].ints.push_back (val);
+}
+
+void
+ResultBatch::AppendUint (const size_t col, const uint64_t val)
+{
+  columns[col].uints.push_back (val);
+}
+
+void
+ResultBatch::AppendDouble (const size_t col, const double val)
+{
+  columns[col].doubles.push_back (val);
+}
+
+void
+ResultBatch::AppendTime (const size_t col, const MYSQL_TIME& val)
+{
+  columns[col].times.push_back (val);
+}
+
+void
+ResultBatch::AppendString (const size_t col, const char* val,
+                           const size_t len)
+{
+  auto& c = columns[col];
+  c.data.insert (c.data.end (), val, val + len);
+  c.offsets.push_back (c.data.size ());
+}
+
+char*
+ResultBatch::AppendStringSpace (const size_t col, const size_t len)
+{
+  auto& c = columns[col];
+  const size_t start = c.data.size ();
+  c.data.resize (start + len);
+  c.offsets.push_back (c.data.size ());
+  return c.data.data () + start;
+}
+
+const ResultBatch::ColumnData&
+ResultBatch::GetColumn (const size_t col) const
+{
+  CHECK_LT (col, numColumns) << "Column index out of range";
+  return columns[col];
+}
+
+const ResultBatch::ColumnData&
+ResultBatch::GetColumn (const size_t col, const Type t) const
+{
+  const auto& c = GetColumn (col);
+  CHECK (c.type == t) << "Column " << col << " has a different type";
+  return c;
+}
+
+ResultBatch::Type
+ResultBatch::GetType (const size_t col) const
+{
+  return GetColumn (col).type;
+}
+
+bool
+ResultBatch::IsNull (const size_t col, const size_t row) const
+{
+  const auto& c = GetColumn (col);
+  CHECK_LT (row, numRows) << "Row index out of range";
+  return (c.nulls[row / 8] & (1 << (row % 8))) != 0;
+}
+
+const uint8_t*
+ResultBatch::GetNullBitmap (const size_t col) const
+{
+  return GetColumn (col).nulls.data ();
+}
+
+const int64_t*
+ResultBatch::GetInts (const size_t col) const
+{
+  return GetColumn (col, Type::INT).ints.data ();
+}
+
+const uint64_t*
+ResultBatch::GetUints (const size_t col) const
+{
+  return GetColumn (col, Type::UINT).uints.data ();
+}
+
+const double*
+ResultBatch::GetDoubles (const size_t col) const
+{
+  return GetColumn (col, Type::DOUBLE).doubles.data ();
+}
+
+const MYSQL_TIME*
+ResultBatch::GetTimes (const size_t col) const
+{
+  return GetColumn (col, Type::TIME).times.data ();
+}
+
+const size_t*
+ResultBatch::GetOffsets (const size_t col) const
+{
+  return GetColumn (col, Type::STRING).offsets.data ();
+}
+
+const char*
+ResultBatch::GetData (const size_t col) const
+{
+  return GetColumn (col, Type::STRING).data.data ();
+}
+
+std::string_view
+ResultBatch::GetView (const size_t col, const size_t row) const
+{
+  const auto& c = GetColumn (col, Type::STRING);
+  CHECK_LT (row, numRows) << "Row index out of range";
+
+  const size_t start = c.offsets[row];
+  return std::string_view (c.data.data () + start,
+                           c.offsets[row + 1] - start);
+}
+
+size_t
+ResultBatch::GetMemoryUsage () const
+{
+  size_t res = sizeof (*this) + columns.capacity () * sizeof (ColumnData);
+  for (const auto& c : columns)
+    res += c.ints.capacity () * sizeof (int64_t)
+              + c.uints.capacity () * sizeof (uint64_t)
+              + c.doubles.capacity () * sizeof (double)
+              + c.times.capacity () * sizeof (MYSQL_TIME)
+              + c.nulls.capacity () * sizeof (uint8_t)
+              + c.offsets.capacity () * sizeof (size_t)
+              + c.data.capacity ();
+
+  return res;
+}
+
+} // namespace mypp
@@ -0,0 +1,267 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_RESULTBATCH_HPP
+#define MYPP_RESULTBATCH_HPP
+
+#include <mysql.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace mypp
+{
+
+class Statement;
+
+/**
+ * A batch of result rows stored column-major, as filled in by
+ * Statement::FetchBatch.  Each numeric or date/time column is a contiguous
+ * array of values, and each string column is a contiguous buffer of bytes
+ * together with an array of offsets into it (like in Apache Arrow).
+ * Every column also has a bitmap of null values.
+ *
+ * An instance can be reused for multiple batches, in which case the memory
+ * allocated for earlier batches is reused as well.
+ */
+class ResultBatch
+{
+
+public:
+
+  /**
+   * The type of data held in a column.
+   */
+  enum class Type
+  {
+    /** Integer values (including booleans).  */
+    INT,
+    /**
+     * Unsigned 64-bit integer values (BIGINT UNSIGNED).  Smaller unsigned
+     * integer types always fit into INT and are stored as such.
+     */
+    UINT,
+    /** Floating-point values (FLOAT and DOUBLE).  */
+    DOUBLE,
+    /** Date and time values (DATE, TIME, DATETIME and TIMESTAMP).  */
+    TIME,
+    /** String or BLOB values (including DECIMAL in its text form).  */
+    STRING,
+  };
+
+private:
+
+  /**
+   * The data stored for one column.  The vectors are never shrunk between
+   * batches, only the number of used entries is reset.
+   */
+  struct ColumnData
+  {
+
+    /** The type of this column.  */
+    Type type = Type::INT;
+
+    /** The values of an integer column (zero for null entries).  */
+    std::vector<int64_t> ints;
+
+    /** The values of an unsigned column (zero for null entries).  */
+    std::vector<uint64_t> uints;
+
+    /** The values of a floating-point column (zero for null entries).  */
+    std::vector<double> doubles;
+
+    /** The values of a date/time column (zeroed for null entries).  */
+    std::vector<MYSQL_TIME> times;
+
+    /**
+     * Bitmap of null values.  The bit (row % 8) of byte (row / 8) is set if
+     * the value in that row is null.
+     */
+    std::vector<uint8_t> nulls;
+
+    /**
+     * For string columns, the start offsets of each value into data,
+     * plus a final entry with the total size.  The value in some row is
+     * thus data[offsets[row]] up to data[offsets[row + 1]].
+     */
+    std::vector<size_t> offsets;
+
+    /** The bytes of all values of a string column.  */
+    std::vector<char> data;
+
+  };
+
+  /**
+   * The data for all columns.  This may have more entries than the number
+   * of columns actually in use, from earlier batches.
+   */
+  std::vector<ColumnData> columns;
+
+  /** Number of columns in the current batch.  */
+  size_t numColumns = 0;
+
+  /** Number of rows in the current batch.  */
+  size_t numRows = 0;
+
+  /**
+   * Clears the batch and sets it up for the given number of columns,
+   * whose types are then set with SetType.
+   */
+  void Reset (size_t n);
+
+  /**
+   * Sets the type of a column, after Reset.
+   */
+  void SetType (size_t col, Type t);
+
+  /**
+   * Adds a new (initially all non-null) row to the batch, whose values
+   * are then filled in with the Append methods.
+   */
+  void AddRow ();
+
+  /**
+   * Appends a null value to the given column in the last row.
+   */
+  void AppendNull (size_t col);
+
+  /**
+   * Appends an integer value to the given column in the last row.
+   */
+  void AppendInt (size_t col, int64_t val);
+
+  /**
+   * Appends an unsigned integer value to the given column in the last row.
+   */
+  void AppendUint (size_t col, uint64_t val);
+
+  /**
+   * Appends a floating-point value to the given column in the last row.
+   */
+  void AppendDouble (size_t col, double val);
+
+  /**
+   * Appends a date/time value to the given column in the last row.
+   */
+  void AppendTime (size_t col, const MYSQL_TIME& val);
+
+  /**
+   * Appends a string value to the given column in the last row.
+   */
+  void AppendString (size_t col, const char* val, size_t len);
+
+  /**
+   * Appends a string value of the given length to the column in the last
+   * row, and returns a pointer to the (uninitialised) memory for it.  This
+   * is used to fetch values directly into the batch.  The pointer is only
+   * valid until the next value is appended.
+   */
+  char* AppendStringSpace (size_t col, size_t len);
+
+  /**
+   * Returns the data for the given column, verifying that it is valid.
+   */
+  const ColumnData& GetColumn (size_t col) const;
+
+  /**
+   * Returns the data for the given column, verifying that it is valid
+   * and of the expected type.
+   */
+  const ColumnData& GetColumn (size_t col, Type t) const;
+
+  friend class Statement;
+
+public:
+
+  ResultBatch () = default;
+
+  ResultBatch (ResultBatch&&) = default;
+  ResultBatch& operator= (ResultBatch&&) = default;
+
+  ResultBatch (const ResultBatch&) = delete;
+  void operator= (const ResultBatch&) = delete;
+
+  size_t
+  GetNumRows () const
+  {
+    return numRows;
+  }
+
+  size_t
+  GetNumColumns () const
+  {
+    return numColumns;
+  }
+
+  /**
+   * Returns the type of the given column.
+   */
+  Type GetType (size_t col) const;
+
+  /**
+   * Checks if the value in the given column and row is null.
+   */
+  bool IsNull (size_t col, size_t row) const;
+
+  /**
+   * Returns the null bitmap of a column, with (GetNumRows () + 7) / 8 bytes.
+   * The bit (row % 8) of byte (row / 8) is set if the value is null.
+   */
+  const uint8_t* GetNullBitmap (size_t col) const;
+
+  /**
+   * Returns the contiguous array of GetNumRows () values of an
+   * integer column.  Null entries have the value zero.
+   */
+  const int64_t* GetInts (size_t col) const;
+
+  /**
+   * Returns the contiguous array of GetNumRows () values of an
+   * unsigned integer column.  Null entries have the value zero.
+   */
+  const uint64_t* GetUints (size_t col) const;
+
+  /**
+   * Returns the contiguous array of GetNumRows () values of a
+   * floating-point column.  Null entries have the value zero.
+   */
+  const double* GetDoubles (size_t col) const;
+
+  /**
+   * Returns the contiguous array of GetNumRows () values of a date/time
+   * column.  Null entries are zeroed.
+   */
+  const MYSQL_TIME* GetTimes (size_t col) const;
+
+  /**
+   * Returns the GetNumRows () + 1 offsets of a string column into the
+   * array returned by GetData.
+   */
+  const size_t* GetOffsets (size_t col) const;
+
+  /**
+   * Returns the contiguous buffer with all bytes of a string column.
+   */
+  const char* GetData (size_t col) const;
+
+  /**
+   * Returns a view of the string value in the given column and row.
+   * It points into the batch's memory, and is valid until the batch is
+   * filled again or destructed.  Null values are returned as empty string.
+   */
+  std::string_view GetView (size_t col, size_t row) const;
+
+  /**
+   * Returns the number of bytes of memory allocated by the batch (for all
+   * columns, including capacity retained from earlier batches).
+   */
+  size_t GetMemoryUsage () const;
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_RESULTBATCH_HPP
@@ -0,0 +1,189 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "resultcache.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+namespace mypp
+{
+
+ResultCache::ResultCache ()
+  : ResultCache(Config ())
+{}
+
+ResultCache::ResultCache (const Config& cfg)
+  : config(cfg)
+{}
+
+void
+ResultCache::Remove (const std::list<Entry>::iterator it)
+{
+  for (const auto& t : it->tags)
+    {
+      const auto mit = byTag.find (t);
+      CHECK (mit != byTag.end ());
+      mit->second.erase (it->key);
+      if (mit->second.empty ())
+        byTag.erase (mit);
+    }
+
+  byKey.erase (it->key);
+  totalBytes -= it->bytes;
+  entries.erase (it);
+}
+
+std::vector<uint64_t>
+ResultCache::GetGenerations (const std::vector<std::string>& tags) const
+{
+  std::vector<uint64_t> res;
+  res.reserve (tags.size ());
+  for (const auto& t : tags)
+    {
+      const auto mit = tagGenerations.find (t);
+      res.push_back (mit == tagGenerations.end () ? 0 : mit->second);
+    }
+  return res;
+}
+
+ResultCache::Rows
+ResultCache::Query (Statement& stmt, const std::vector<std::string>& tags)
+{
+  std::string key;
+  stmt.AppendCacheKey (key);
+
+  /* Each tag must only be registered once for the entry, since Remove
+     expects to find the key exactly once per tag.  */
+  std::vector<std::string> uniqueTags = tags;
+  std::sort (uniqueTags.begin (), uniqueTags.end ());
+  uniqueTags.erase (std::unique (uniqueTags.begin (), uniqueTags.end ()),
+                    uniqueTags.end ());
+
+  std::vector<uint64_t> generations;
+  {
+    std::lock_guard<std::mutex> lock(mut);
+
+    const auto mit = byKey.find (key);
+    if (mit != byKey.end ())
+      {
+        const auto it = mit->second;
+        if (std::chrono::steady_clock::now () < it->expires)
+          {
+            ++hits;
+            entries.splice (entries.begin (), entries, it);
+            return it->rows;
+          }
+        Remove (it);
+      }
+
+    ++misses;
+    generations = GetGenerations (uniqueTags);
+  }
+
+  /* The query is run without holding the lock.  If the same query is
+     run concurrently, the last result stored wins.  If one of the tags
+     is invalidated in the mean time, the result may be stale and is
+     not stored at all.  */
+  stmt.Query (Statement::ResultMode::BUFFERED);
+  auto batch = std::make_shared<ResultBatch> ();
+  stmt.FetchBatch (*batch, std::numeric_limits<size_t>::max ());
+  const Rows rows = batch;
+
+  Entry entry;
+  entry.bytes = key.size () + batch->GetMemoryUsage ();
+  if (entry.bytes > config.maxBytes)
+    return rows;
+
+  entry.key = std::move (key);
+  entry.rows = rows;
+  entry.expires = std::chrono::steady_clock::now () + config.ttl;
+  entry.tags = std::move (uniqueTags);
+
+  std::lock_guard<std::mutex> lock(mut);
+
+  if (GetGenerations (entry.tags) != generations)
+    return rows;
+
+  const auto mit = byKey.find (entry.key);
+  if (mit != byKey.end ())
+    Remove (mit->second);
+
+  while (totalBytes + entry.bytes > config.maxBytes)
+    Remove (std::prev (entries.end ()));
+
+  entries.push_front (std::move (entry));
+  const auto it = entries.begin ();
+  byKey.emplace (it->key, it);
+  for (const auto& t : it->tags)
+    byTag[t].insert (it->key);
+  totalBytes += it->bytes;
+
+  return rows;
+}
+
+void
+ResultCache::Invalidate (const std::string& tag)
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  ++tagGenerations[tag];
+
+  const auto mit = byTag.find (tag);
+  if (mit == byTag.end ())
+    return;
+
+  /* Remove modifies the set, so we have to take a copy.  */
+  const auto keys = mit->second;
+  for (const auto& k : keys)
+    {
+      const auto kit = byKey.find (k);
+      CHECK (kit != byKey.end ());
+      Remove (kit->second);
+    }
+}
+
+void
+ResultCache::Clear ()
+{
+  std::lock_guard<std::mutex> lock(mut);
+
+  byKey.clear ();
+  byTag.clear ();
+  entries.clear ();
+  totalBytes = 0;
+}
+
+size_t
+ResultCache::GetNumEntries () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return entries.size ();
+}
+
+size_t
+ResultCache::GetBytes () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return totalBytes;
+}
+
+uint64_t
+ResultCache::GetHits () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return hits;
+}
+
+uint64_t
+ResultCache::GetMisses () const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  return misses;
+}
+
+} // namespace mypp
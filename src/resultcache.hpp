@@ -0,0 +1,191 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_RESULTCACHE_HPP
+#define MYPP_RESULTCACHE_HPP
+
+#include "resultbatch.hpp"
+#include "statement.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace mypp
+{
+
+/**
+ * A client-side cache of query results, for read queries that are run
+ * often and return the same data (like configuration tables).  Results
+ * are keyed by the prepared SQL together with the bound parameter values,
+ * and stored as ResultBatch.  Entries expire after a TTL, and the least
+ * recently used ones are evicted when the total size exceeds a bound.
+ *
+ * Each entry is associated with a list of tags (typically the names of
+ * the tables the query reads), and can be invalidated by them explicitly
+ * when the data changes.  When the cache is attached to a Connection (see
+ * Connection::SetResultCache), writes done with Connection::Execute can
+ * invalidate tags automatically.
+ *
+ * This class is thread-safe, so that a single cache can be shared by
+ * multiple connections to the same database.
+ */
+class ResultCache
+{
+
+public:
+
+  /**
+   * Configuration of the cache.
+   */
+  struct Config
+  {
+
+    /** Maximum total size of all entries in bytes.  */
+    size_t maxBytes = 64 << 20;
+
+    /** Time after which entries expire.  */
+    std::chrono::milliseconds ttl{60'000};
+
+  };
+
+  /** The rows of a cached result.  */
+  using Rows = std::shared_ptr<const ResultBatch>;
+
+private:
+
+  /**
+   * A cached result.
+   */
+  struct Entry
+  {
+
+    /** The key identifying the query.  */
+    std::string key;
+
+    /** The result rows.  */
+    Rows rows;
+
+    /** The size accounted for this entry.  */
+    size_t bytes;
+
+    /** The time when the entry expires.  */
+    std::chrono::steady_clock::time_point expires;
+
+    /** The tags of this entry.  */
+    std::vector<std::string> tags;
+
+  };
+
+  /** The configuration.  */
+  const Config config;
+
+  /** Lock for the data below.  */
+  mutable std::mutex mut;
+
+  /** All entries, from most to least recently used.  */
+  std::list<Entry> entries;
+
+  /** The entries by key.  The keys point into the entries.  */
+  std::unordered_map<std::string_view, std::list<Entry>::iterator> byKey;
+
+  /** The keys of all entries with a given tag.  */
+  std::unordered_map<std::string, std::unordered_set<std::string_view>> byTag;
+
+  /**
+   * Number of times each tag has been invalidated.  This lets Query detect
+   * invalidations that happen while it runs a statement unlocked, so that
+   * it does not store a stale result afterwards.
+   */
+  std::unordered_map<std::string, uint64_t> tagGenerations;
+
+  /** Total size of all entries.  */
+  size_t totalBytes = 0;
+
+  /** Number of queries served from the cache.  */
+  uint64_t hits = 0;
+
+  /** Number of queries that had to be run.  */
+  uint64_t misses = 0;
+
+  /**
+   * Removes the given entry.  Must be called with the lock held.
+   */
+  void Remove (std::list<Entry>::iterator it);
+
+  /**
+   * Returns the current generations of the given tags.  Must be called
+   * with the lock held.
+   */
+  std::vector<uint64_t> GetGenerations (
+      const std::vector<std::string>& tags) const;
+
+public:
+
+  /**
+   * Constructs the cache with the default configuration.
+   */
+  ResultCache ();
+
+  /**
+   * Constructs the cache with the given configuration.
+   */
+  explicit ResultCache (const Config& cfg);
+
+  ResultCache (const ResultCache&) = delete;
+  void operator= (const ResultCache&) = delete;
+
+  /**
+   * Returns the result of querying the given statement, which must be
+   * prepared and have all parameters bound.  If a valid result for the
+   * same SQL and parameters is cached, it is returned directly.  Otherwise
+   * the statement is queried, and its full result stored in the cache with
+   * the given tags (duplicates are ignored).  Afterwards, the statement
+   * must be reset before it can be used again.
+   */
+  Rows Query (Statement& stmt, const std::vector<std::string>& tags);
+
+  /**
+   * Removes all entries with the given tag.
+   */
+  void Invalidate (const std::string& tag);
+
+  /**
+   * Removes all entries.
+   */
+  void Clear ();
+
+  /**
+   * Returns the number of entries currently cached.
+   */
+  size_t GetNumEntries () const;
+
+  /**
+   * Returns the total size of all entries currently cached.
+   */
+  size_t GetBytes () const;
+
+  /**
+   * Returns the number of queries served from the cache.
+   */
+  uint64_t GetHits () const;
+
+  /**
+   * Returns the number of queries that were not cached.
+   */
+  uint64_t GetMisses () const;
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_RESULTCACHE_HPP
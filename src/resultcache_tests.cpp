@@ -0,0 +1,278 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "resultcache.hpp"
+
+#include "connection.hpp"
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+#include "tracing.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace mypp
+{
+namespace
+{
+
+class ResultCacheTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  ResultCacheTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `config` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `value` VARCHAR(64) NOT NULL
+      );
+      INSERT INTO `config` (`id`, `value`) VALUES (1, 'foo'), (2, 'bar');
+    )");
+  }
+
+  /**
+   * Looks up a value by ID through the cache with the given statement.
+   * Returns the empty string if there is no row.
+   */
+  static std::string
+  Lookup (ResultCache& cache, Statement& stmt, const int64_t id)
+  {
+    stmt.Reset ();
+    stmt.Bind (0, id);
+    const auto rows = cache.Query (stmt, {"config"});
+    if (rows->GetNumRows () == 0)
+      return "";
+    return std::string (rows->GetView (0, 0));
+  }
+
+};
+
+TEST_F (ResultCacheTests, CachesByParameters)
+{
+  ResultCache cache;
+  Statement stmt(db.Get ());
+  stmt.Prepare (1, "SELECT `value` FROM `config` WHERE `id` = ?");
+
+  EXPECT_EQ (Lookup (cache, stmt, 1), "foo");
+  EXPECT_EQ (Lookup (cache, stmt, 2), "bar");
+  EXPECT_EQ (Lookup (cache, stmt, 3), "");
+  EXPECT_EQ (cache.GetMisses (), 3);
+  EXPECT_EQ (cache.GetNumEntries (), 3);
+
+  /* Changes are not seen without invalidation.  */
+  db.Get ().Execute ("UPDATE `config` SET `value` = 'baz' WHERE `id` = 1");
+  EXPECT_EQ (Lookup (cache, stmt, 1), "foo");
+  EXPECT_EQ (Lookup (cache, stmt, 2), "bar");
+  EXPECT_EQ (cache.GetHits (), 2);
+
+  /* The same query through a different statement is cached as well.  */
+  Statement other(db.Get ());
+  other.Prepare (1, "SELECT `value` FROM `config` WHERE `id` = ?");
+  EXPECT_EQ (Lookup (cache, other, 1), "foo");
+  EXPECT_EQ (cache.GetHits (), 3);
+}
+
+TEST_F (ResultCacheTests, StringParameters)
+{
+  ResultCache cache;
+  Statement stmt(db.Get ());
+  stmt.Prepare (1, "SELECT `id` FROM `config` WHERE `value` = ?");
+
+  for (const std::string val : {"foo", "bar", "foo"})
+    {
+      stmt.Reset ();
+      stmt.Bind (0, val);
+      const auto rows = cache.Query (stmt, {"config"});
+      ASSERT_EQ (rows->GetNumRows (), 1);
+      EXPECT_EQ (rows->GetInts (0)[0], val == "foo" ? 1 : 2);
+    }
+
+  EXPECT_EQ (cache.GetHits (), 1);
+  EXPECT_EQ (cache.GetMisses (), 2);
+}
+
+TEST_F (ResultCacheTests, OtherColumnTypes)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `rates` (
+      `id` BIGINT UNSIGNED NOT NULL PRIMARY KEY,
+      `rate` DOUBLE NOT NULL,
+      `updated` DATETIME NOT NULL,
+      `price` DECIMAL(10, 2) NOT NULL
+    );
+    INSERT INTO `rates` (`id`, `rate`, `updated`, `price`)
+      VALUES (18446744073709551615, 0.25, '2024-01-02 03:04:05', 12.50);
+  )");
+
+  ResultCache cache;
+  Statement stmt(db.Get ());
+  stmt.Prepare (0, "SELECT `id`, `rate`, `updated`, `price` FROM `rates`");
+
+  for (int i = 0; i < 2; ++i)
+    {
+      stmt.Reset ();
+      const auto rows = cache.Query (stmt, {"rates"});
+      ASSERT_EQ (rows->GetNumRows (), 1);
+      EXPECT_EQ (rows->GetUints (0)[0], 18'446'744'073'709'551'615u);
+      EXPECT_EQ (rows->GetDoubles (1)[0], 0.25);
+      EXPECT_EQ (rows->GetTimes (2)[0].year, 2024);
+      EXPECT_EQ (rows->GetTimes (2)[0].second, 5);
+      EXPECT_EQ (rows->GetView (3, 0), "12.50");
+    }
+
+  EXPECT_EQ (cache.GetHits (), 1);
+  EXPECT_EQ (cache.GetMisses (), 1);
+}
+
+TEST_F (ResultCacheTests, DuplicateTags)
+{
+  ResultCache cache;
+  Statement stmt(db.Get ());
+  stmt.Prepare (1, "SELECT `value` FROM `config` WHERE `id` = ?");
+
+  stmt.Bind<int64_t> (0, 1);
+  cache.Query (stmt, {"config", "other", "config"});
+  EXPECT_EQ (cache.GetNumEntries (), 1);
+
+  cache.Invalidate ("config");
+  EXPECT_EQ (cache.GetNumEntries (), 0);
+  EXPECT_EQ (cache.GetBytes (), 0);
+  cache.Invalidate ("other");
+}
+
+TEST_F (ResultCacheTests, Invalidation)
+{
+  ResultCache cache;
+  db.Get ().SetResultCache (&cache);
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (1, "SELECT `value` FROM `config` WHERE `id` = ?");
+  EXPECT_EQ (Lookup (cache, stmt, 1), "foo");
+
+  db.Get ().Execute ("UPDATE `config` SET `value` = 'baz' WHERE `id` = 1",
+                     {"other"});
+  EXPECT_EQ (Lookup (cache, stmt, 1), "foo");
+
+  db.Get ().Execute ("UPDATE `config` SET `value` = 'baz' WHERE `id` = 1",
+                     {"config"});
+  EXPECT_EQ (cache.GetNumEntries (), 0);
+  EXPECT_EQ (cache.GetBytes (), 0);
+  EXPECT_EQ (Lookup (cache, stmt, 1), "baz");
+
+  cache.Invalidate ("config");
+  db.Get ().Execute ("UPDATE `config` SET `value` = 'abc' WHERE `id` = 1");
+  EXPECT_EQ (Lookup (cache, stmt, 1), "abc");
+
+  db.Get ().SetResultCache (nullptr);
+}
+
+/**
+ * Trace sink that invalidates a tag on a cache whenever a query finishes.
+ * This is used to invalidate while ResultCache::Query has run the query,
+ * but not yet stored the result.
+ */
+class InvalidatingSink : public TraceSink
+{
+
+private:
+
+  ResultCache& cache;
+
+public:
+
+  explicit InvalidatingSink (ResultCache& c)
+    : TraceSink(std::chrono::nanoseconds (0), 1.0), cache(c)
+  {}
+
+  void
+  Emit (const Span&) override
+  {
+    cache.Invalidate ("config");
+  }
+
+};
+
+TEST_F (ResultCacheTests, InvalidatedWhileQuerying)
+{
+  ResultCache cache;
+  Statement stmt(db.Get ());
+  stmt.Prepare (1, "SELECT `value` FROM `config` WHERE `id` = ?");
+
+  InvalidatingSink sink(cache);
+  SetTraceSink (&sink);
+  EXPECT_EQ (Lookup (cache, stmt, 1), "foo");
+  SetTraceSink (nullptr);
+
+  /* The result was returned, but not cached.  */
+  EXPECT_EQ (cache.GetNumEntries (), 0);
+  EXPECT_EQ (cache.GetMisses (), 1);
+
+  /* Without invalidation, it is cached again.  */
+  EXPECT_EQ (Lookup (cache, stmt, 1), "foo");
+  EXPECT_EQ (cache.GetNumEntries (), 1);
+  EXPECT_EQ (Lookup (cache, stmt, 1), "foo");
+  EXPECT_EQ (cache.GetHits (), 1);
+}
+
+TEST_F (ResultCacheTests, Expiry)
+{
+  ResultCache::Config cfg;
+  cfg.ttl = std::chrono::milliseconds (10);
+  ResultCache cache(cfg);
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (1, "SELECT `value` FROM `config` WHERE `id` = ?");
+  EXPECT_EQ (Lookup (cache, stmt, 1), "foo");
+
+  db.Get ().Execute ("UPDATE `config` SET `value` = 'baz' WHERE `id` = 1");
+  std::this_thread::sleep_for (std::chrono::milliseconds (20));
+  EXPECT_EQ (Lookup (cache, stmt, 1), "baz");
+  EXPECT_EQ (cache.GetHits (), 0);
+  EXPECT_EQ (cache.GetNumEntries (), 1);
+}
+
+TEST_F (ResultCacheTests, EvictionBySize)
+{
+  /* All results should have the same size.  */
+  db.Get ().Execute ("INSERT INTO `config` (`id`, `value`) VALUES (3, 'baz')");
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (1, "SELECT `value` FROM `config` WHERE `id` = ?");
+
+  ResultCache probe;
+  Lookup (probe, stmt, 1);
+  const size_t entryBytes = probe.GetBytes ();
+  ASSERT_GT (entryBytes, 0);
+
+  ResultCache::Config cfg;
+  cfg.maxBytes = 2 * entryBytes + entryBytes / 2;
+  ResultCache cache(cfg);
+
+  Lookup (cache, stmt, 1);
+  Lookup (cache, stmt, 2);
+  /* Touch the first entry, so that the second is evicted.  */
+  Lookup (cache, stmt, 1);
+  Lookup (cache, stmt, 3);
+  EXPECT_EQ (cache.GetNumEntries (), 2);
+  EXPECT_LE (cache.GetBytes (), cfg.maxBytes);
+  EXPECT_EQ (cache.GetHits (), 1);
+
+  Lookup (cache, stmt, 1);
+  EXPECT_EQ (cache.GetHits (), 2);
+  Lookup (cache, stmt, 2);
+  EXPECT_EQ (cache.GetHits (), 2);
+}
+
+} // anonymous namespace
+} // namespace mypp
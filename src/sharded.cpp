@@ -0,0 +1,103 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sharded.hpp"
+
+#include "error.hpp"
+#include "url.hpp"
+
+#include <glog/logging.h>
+
+namespace mypp
+{
+
+namespace
+{
+
+/**
+ * Parses the shard index from the options of a URL.  Throws if it is
+ * missing or invalid.
+ */
+size_t
+ParseShardIndex (const UrlParser& url)
+{
+  unsigned long long parsed;
+  if (!url.GetUnsignedOption ("shard", parsed))
+    throw Error ("Missing 'shard' option on URL for sharded connection");
+
+  return parsed;
+}
+
+} // anonymous namespace
+
+ShardedConnection::ShardedConnection (const std::vector<std::string>& urls)
+{
+  for (const auto& u : urls)
+    {
+      UrlParser url;
+      url.Parse (u);
+
+      const size_t index = ParseShardIndex (url);
+      if (index >= urls.size ())
+        throw Error ("Shard index is out of range");
+      if (index >= shards.size ())
+        shards.resize (index + 1);
+      if (shards[index] == nullptr)
+        shards[index] = std::make_unique<Shard> ();
+      auto& shard = *shards[index];
+
+      auto pool = std::make_unique<ConnectionPool> (u);
+      if (url.GetOption ("replica") == "1")
+        shard.replicas.push_back (std::move (pool));
+      else
+        {
+          if (shard.primary != nullptr)
+            throw Error ("Multiple primaries for the same shard");
+          shard.primary = std::move (pool);
+        }
+    }
+
+  if (shards.empty ())
+    throw Error ("No shards configured");
+  for (const auto& s : shards)
+    if (s == nullptr || s->primary == nullptr)
+      throw Error ("Shards are not numbered consecutively with a primary");
+}
+
+size_t
+ShardedConnection::GetNumReplicas (const size_t shard) const
+{
+  CHECK_LT (shard, shards.size ()) << "Invalid shard index";
+  return shards[shard]->replicas.size ();
+}
+
+size_t
+ShardedConnection::GetShardForKey (const std::string_view key) const
+{
+  /* We use 64-bit FNV-1a, which (unlike std::hash) is the same
+     everywhere, so that all processes agree on the mapping.  */
+  uint64_t hash = 14'695'981'039'346'656'037ull;
+  for (const char c : key)
+    {
+      hash ^= static_cast<unsigned char> (c);
+      hash *= 1'099'511'628'211ull;
+    }
+
+  return hash % shards.size ();
+}
+
+ConnectionPool::Lease
+ShardedConnection::Acquire (const size_t shard, const Access access)
+{
+  CHECK_LT (shard, shards.size ()) << "Invalid shard index";
+  auto& s = *shards[shard];
+
+  if (access == Access::WRITE || s.replicas.empty ())
+    return s.primary->Acquire ();
+
+  const size_t replica = s.nextReplica++ % s.replicas.size ();
+  return s.replicas[replica]->Acquire ();
+}
+
+} // namespace mypp
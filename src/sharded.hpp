@@ -0,0 +1,183 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_SHARDED_HPP
+#define MYPP_SHARDED_HPP
+
+#include "connection.hpp"
+#include "pool.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mypp
+{
+
+/**
+ * Routing layer for data that is sharded across multiple database servers.
+ * It is configured from a list of URLs (see UrlParser), one per server,
+ * with these options:
+ *
+ *  - shard:  The index of the shard the server holds (required).  The
+ *    shards must be numbered consecutively starting from zero.
+ *  - replica:  If set to 1, the server is a read replica of the shard.
+ *    Otherwise it is the primary, of which each shard must have exactly one.
+ *
+ * All other options (e.g. for the connection pool) apply to the server's
+ * ConnectionPool as usual.  Keys are mapped to shards with a stable hash,
+ * so that the mapping is the same across processes and builds.
+ *
+ * This class is thread-safe.
+ */
+class ShardedConnection
+{
+
+public:
+
+  /**
+   * Whether a connection is needed for writing (and must go to the primary)
+   * or only for reading (and may use a replica).
+   */
+  enum class Access
+  {
+    WRITE,
+    READ,
+  };
+
+private:
+
+  /**
+   * The servers for one shard.
+   */
+  struct Shard
+  {
+
+    /** The shard's primary server.  */
+    std::unique_ptr<ConnectionPool> primary;
+
+    /** The read replicas (if any).  */
+    std::vector<std::unique_ptr<ConnectionPool>> replicas;
+
+    /** Counter used to spread reads across the replicas.  */
+    std::atomic<size_t> nextReplica{0};
+
+  };
+
+  /** The shards, indexed by their number.  */
+  std::vector<std::unique_ptr<Shard>> shards;
+
+public:
+
+  /**
+   * Constructs the router from the given URLs.  Throws mypp::Error if
+   * the configuration is invalid.
+   */
+  explicit ShardedConnection (const std::vector<std::string>& urls);
+
+  ShardedConnection (const ShardedConnection&) = delete;
+  void operator= (const ShardedConnection&) = delete;
+
+  /**
+   * Returns the number of shards.
+   */
+  size_t
+  GetNumShards () const
+  {
+    return shards.size ();
+  }
+
+  /**
+   * Returns the number of read replicas of the given shard.
+   */
+  size_t GetNumReplicas (size_t shard) const;
+
+  /**
+   * Returns the shard that the given key is mapped to.
+   */
+  size_t GetShardForKey (std::string_view key) const;
+
+  /**
+   * Acquires a connection to the given shard.  For reads, this uses one of
+   * the replicas (round robin), or the primary if there are none.
+   */
+  ConnectionPool::Lease Acquire (size_t shard, Access access);
+
+  /**
+   * Acquires a connection to the shard holding the given key.
+   */
+  ConnectionPool::Lease
+  AcquireForKey (const std::string_view key, const Access access)
+  {
+    return Acquire (GetShardForKey (key), access);
+  }
+
+  /**
+   * Runs the given function on each shard in parallel, in its own thread
+   * and with a connection acquired for the given access.  The function is
+   * called with the shard index and the connection, and returns a vector
+   * of results (e.g. rows read from the shard).  The results of all shards
+   * are concatenated in order of the shards and returned.  If the function
+   * throws for any shard, the first such exception is rethrown after all
+   * threads are finished.
+   */
+  template <typename Fcn>
+    auto ScatterGather (Fcn&& f, Access access = Access::READ)
+        -> decltype (f (size_t (), std::declval<Connection&> ()));
+
+};
+
+template <typename Fcn>
+  auto
+  ShardedConnection::ScatterGather (Fcn&& f, const Access access)
+      -> decltype (f (size_t (), std::declval<Connection&> ()))
+{
+  using Result = decltype (f (size_t (), std::declval<Connection&> ()));
+
+  const size_t num = shards.size ();
+  std::vector<Result> results(num);
+  std::vector<std::exception_ptr> errors(num);
+
+  std::vector<std::thread> threads;
+  threads.reserve (num);
+  for (size_t i = 0; i < num; ++i)
+    threads.emplace_back ([&, i] ()
+      {
+        try
+          {
+            auto lease = Acquire (i, access);
+            results[i] = f (i, *lease);
+          }
+        catch (...)
+          {
+            errors[i] = std::current_exception ();
+          }
+      });
+
+  for (auto& t : threads)
+    t.join ();
+
+  for (const auto& e : errors)
+    if (e != nullptr)
+      std::rethrow_exception (e);
+
+  Result merged;
+  for (auto& r : results)
+    merged.insert (merged.end (), std::make_move_iterator (r.begin ()),
+                   std::make_move_iterator (r.end ()));
+
+  return merged;
+}
+
+} // namespace mypp
+
+#endif // MYPP_SHARDED_HPP
@@ -0,0 +1,203 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sharded.hpp"
+
+#include "error.hpp"
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+#include "url.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mypp
+{
+namespace
+{
+
+class ShardedConnectionTests : public testing::Test
+{
+
+protected:
+
+  /** The parsed URL of the test database server.  */
+  UrlParser url;
+
+  /** Databases for the two shards and a replica of shard 1.  */
+  std::vector<std::unique_ptr<TempDb>> dbs;
+
+  ShardedConnectionTests ()
+  {
+    url.Parse (GetTempDbUrl ());
+
+    for (const auto* suffix : {"_shard0", "_shard1", "_shard1r"})
+      {
+        dbs.push_back (std::make_unique<TempDb> (
+            url.GetHost (), url.GetPort (), url.GetUser (), url.GetPassword (),
+            url.GetDatabase () + suffix));
+        auto& db = *dbs.back ();
+        db.Initialise ();
+        db.Get ().Execute (R"(
+          CREATE TABLE `test` (
+            `id` INT NOT NULL PRIMARY KEY,
+            `server` VARCHAR(16) NOT NULL
+          )
+        )");
+      }
+  }
+
+  /**
+   * Returns the URL for the given suffix of the database, with
+   * the given options.
+   */
+  std::string
+  GetUrl (const std::string& suffix, const std::string& opt) const
+  {
+    return "mysql://" + url.GetUser () + ":" + url.GetPassword ()
+              + "@" + url.GetHost () + ":" + std::to_string (url.GetPort ())
+              + "/" + url.GetDatabase () + suffix + "?" + opt;
+  }
+
+  /**
+   * Returns the URLs for our default configuration.
+   */
+  std::vector<std::string>
+  GetUrls () const
+  {
+    return {
+      GetUrl ("_shard1r", "shard=1&replica=1"),
+      GetUrl ("_shard0", "shard=0"),
+      GetUrl ("_shard1", "shard=1"),
+    };
+  }
+
+  /**
+   * Inserts a row into the table of the given connection, recording
+   * the server name.
+   */
+  static void
+  Insert (Connection& conn, const int64_t id, const std::string& server)
+  {
+    auto& stmt = conn.GetCached (R"(
+      INSERT INTO `test` (`id`, `server`) VALUES (?, ?)
+    )", 2);
+    stmt.Bind (0, id);
+    stmt.Bind (1, server);
+    stmt.Execute ();
+  }
+
+  /**
+   * Reads the server names of all rows in the connection's table.
+   */
+  static std::vector<std::string>
+  ReadServers (Connection& conn)
+  {
+    auto& stmt = conn.GetCached (R"(
+      SELECT `server` FROM `test` ORDER BY `id`
+    )", 0);
+    stmt.Query ();
+
+    std::vector<std::string> res;
+    while (stmt.Fetch ())
+      res.push_back (stmt.Get<std::string> ("server"));
+    return res;
+  }
+
+};
+
+TEST_F (ShardedConnectionTests, Configuration)
+{
+  ShardedConnection sharded(GetUrls ());
+  EXPECT_EQ (sharded.GetNumShards (), 2);
+  EXPECT_EQ (sharded.GetNumReplicas (0), 0);
+  EXPECT_EQ (sharded.GetNumReplicas (1), 1);
+}
+
+TEST_F (ShardedConnectionTests, InvalidConfiguration)
+{
+  EXPECT_THROW (ShardedConnection ({}), Error);
+  EXPECT_THROW (ShardedConnection ({GetUrl ("_shard0", "foo=bar")}), Error);
+  EXPECT_THROW (ShardedConnection ({GetUrl ("_shard0", "shard=x")}), Error);
+  EXPECT_THROW (ShardedConnection ({GetUrl ("_shard0", "shard=1")}), Error);
+  EXPECT_THROW (ShardedConnection ({
+    GetUrl ("_shard0", "shard=0"),
+    GetUrl ("_shard1", "shard=0"),
+  }), Error);
+  EXPECT_THROW (ShardedConnection ({
+    GetUrl ("_shard0", "shard=0"),
+    GetUrl ("_shard1r", "shard=1&replica=1"),
+  }), Error);
+}
+
+TEST_F (ShardedConnectionTests, KeyMapping)
+{
+  ShardedConnection sharded(GetUrls ());
+
+  /* The mapping is stable, and spreads keys across the shards.  */
+  std::vector<unsigned> counts(2);
+  for (int i = 0; i < 100; ++i)
+    {
+      const std::string key = "key " + std::to_string (i);
+      const size_t shard = sharded.GetShardForKey (key);
+      ASSERT_LT (shard, 2);
+      EXPECT_EQ (sharded.GetShardForKey (key), shard);
+      ++counts[shard];
+    }
+  EXPECT_GT (counts[0], 20);
+  EXPECT_GT (counts[1], 20);
+
+  EXPECT_EQ (sharded.GetShardForKey ("foo"), 1);
+  EXPECT_EQ (sharded.GetShardForKey ("bar"), 0);
+}
+
+TEST_F (ShardedConnectionTests, ReadsFromReplicas)
+{
+  ShardedConnection sharded(GetUrls ());
+
+  using Access = ShardedConnection::Access;
+
+  Insert (*sharded.Acquire (0, Access::WRITE), 1, "p0");
+  Insert (*sharded.Acquire (1, Access::WRITE), 1, "p1");
+  Insert (dbs[2]->Get (), 1, "r1");
+
+  EXPECT_EQ (ReadServers (*sharded.Acquire (0, Access::READ)),
+             std::vector<std::string> ({"p0"}));
+  EXPECT_EQ (ReadServers (*sharded.Acquire (1, Access::READ)),
+             std::vector<std::string> ({"r1"}));
+  EXPECT_EQ (ReadServers (*sharded.AcquireForKey ("foo", Access::WRITE)),
+             std::vector<std::string> ({"p1"}));
+}
+
+TEST_F (ShardedConnectionTests, ScatterGather)
+{
+  ShardedConnection sharded(GetUrls ());
+  Insert (dbs[0]->Get (), 1, "p0");
+  Insert (dbs[0]->Get (), 2, "p0");
+  Insert (dbs[1]->Get (), 1, "p1");
+
+  const auto read = [] (const size_t, Connection& conn)
+    {
+      return ReadServers (conn);
+    };
+
+  EXPECT_EQ (sharded.ScatterGather (read, ShardedConnection::Access::WRITE),
+             std::vector<std::string> ({"p0", "p0", "p1"}));
+  EXPECT_EQ (sharded.ScatterGather (read),
+             std::vector<std::string> ({"p0", "p0"}));
+
+  EXPECT_THROW (sharded.ScatterGather ([] (const size_t shard, Connection&)
+    {
+      if (shard == 1)
+        throw Error ("failed");
+      return std::vector<int> ();
+    }), Error);
+}
+
+} // anonymous namespace
+} // namespace mypp
@@ -4,10 +4,12 @@
 
 #include "statement.hpp"
 
+#include "connection.hpp"
 #include "error.hpp"
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <cstring>
 #include <limits>
 #include <sstream>
@@ -47,16 +49,113 @@ template <typename T>
   return reinterpret_cast<bndSizeT*> (mem);
 }
 
+/**
+ * Initial size of the buffers for string output columns when a query result
+ * is streamed (and thus the maximum length of values is not known up front).
+ * The buffers are grown as needed if larger values are fetched.
+ */
+constexpr unsigned long STREAMING_BUFFER_SIZE = 256;
+
+/**
+ * Maximum size of a single packet of long data sent to the server.  Larger
+ * writes are split up, so that they stay below max_allowed_packet.
+ */
+constexpr size_t LONG_DATA_CHUNK_SIZE = 1 << 20;
+
+/**
+ * Returns the number of days since the Unix epoch for a date in the
+ * proleptic Gregorian calendar.
+ */
+int64_t
+DaysFromCivil (int64_t year, const unsigned month, const unsigned day)
+{
+  /* See http://howardhinnant.github.io/date_algorithms.html.  */
+  year -= (month <= 2);
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned yoe = static_cast<unsigned> (year - era * 400);
+  const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5
+                          + day - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146'097 + static_cast<int64_t> (doe) - 719'468;
+}
+
+/**
+ * Converts a number of days since the Unix epoch to year, month and day
+ * in the proleptic Gregorian calendar.  This is the inverse of DaysFromCivil.
+ */
+void
+CivilFromDays (int64_t days, MYSQL_TIME& out)
+{
+  days += 719'468;
+  const int64_t era = (days >= 0 ? days : days - 146'096) / 146'097;
+  const unsigned doe = static_cast<unsigned> (days - era * 146'097);
+  const unsigned yoe
+      = (doe - doe / 1'460 + doe / 36'524 - doe / 146'096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  out.day = doy - (153 * mp + 2) / 5 + 1;
+  out.month = mp < 10 ? mp + 3 : mp - 9;
+  out.year = static_cast<int64_t> (yoe) + era * 400 + (out.month <= 2);
+}
+
+/**
+ * Returns the buffer type to use for binding a MYSQL_TIME value.
+ */
+enum_field_types
+GetTimeBufferType (const MYSQL_TIME& t)
+{
+  switch (t.time_type)
+    {
+    case MYSQL_TIMESTAMP_DATE:
+      return MYSQL_TYPE_DATE;
+    case MYSQL_TIMESTAMP_TIME:
+      return MYSQL_TYPE_TIME;
+    default:
+      return MYSQL_TYPE_DATETIME;
+    }
+}
+
+/**
+ * Returns true if the given buffer type is one for MYSQL_TIME values.
+ */
+bool
+IsTimeBufferType (const enum_field_types type)
+{
+  switch (type)
+    {
+    case MYSQL_TYPE_DATE:
+    case MYSQL_TYPE_TIME:
+    case MYSQL_TYPE_DATETIME:
+    case MYSQL_TYPE_TIMESTAMP:
+      return true;
+    default:
+      return false;
+    }
+}
+
 } // anonymous namespace
 
-Statement::Statement (MYSQL* h)
-  : handle(h)
+Statement::Statement (MYSQL* h, std::pmr::memory_resource* mem)
+  : handle(h), memory(mem),
+    params(mem), intParams(mem), resultBuffers(mem), overflowed(mem),
+    doubleParams(mem), timeParams(mem), isNull(mem), truncated(mem),
+    resFields(mem), columnNames(mem), columnsByName(mem)
 {
+  CHECK (memory != nullptr);
   Init ();
 }
 
+Statement::Statement (Connection& c, std::pmr::memory_resource* mem)
+  : Statement(c.handle, mem)
+{
+  conn = &c;
+  conn->statements.insert (this);
+}
+
 Statement::~Statement ()
 {
+  if (conn != nullptr)
+    conn->statements.erase (this);
   CleanUp ();
 }
 
@@ -67,11 +166,47 @@ Statement::Init ()
   stmt = mysql_stmt_init (handle);
   CHECK (stmt != nullptr) << "Failed to initialise statement";
   state = State::INITIALISED;
+
+  /* When buffering the result, we want to get the maximum length of the
+     values in each column, so that our buffers can be sized to hold
+     all of them.  */
+  my_bool update = 1;
+  CHECK_EQ (mysql_stmt_attr_set (stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &update),
+            0);
+}
+
+void
+Statement::Reprepare ()
+{
+  const bool wasPrepared = (state != State::INITIALISED);
+  const std::string sql = preparedSql;
+
+  CleanUp ();
+  Init ();
+
+  if (!wasPrepared)
+    return;
+
+  /* A direct statement that has not been executed yet is not known to
+     the server, so there is nothing to redo for it.  Otherwise it has been
+     prepared on the server as part of execute_direct.  */
+  if (directPending)
+    {
+      SetPrepared (numParams, sql, true);
+      return;
+    }
+
+  if (mysql_stmt_prepare (stmt, sql.data (), sql.size ()) != 0)
+    throw StmtError (stmt);
+  SetPrepared (numParams, sql, false);
 }
 
 void
 Statement::CleanUp ()
 {
+  RecordFetchMetrics (false);
+  FinishTrace (false);
+
   if (resMeta != nullptr)
     {
       mysql_free_result (resMeta);
@@ -85,12 +220,23 @@ Statement::CleanUp ()
 void
 Statement::ResizeParams (const size_t num)
 {
-  params.resize (num);
-  std::memset (params.data (), 0, num * sizeof (MYSQL_BIND));
+  /* The vectors are never shrunk, so that the allocated strings (and their
+     capacities) are retained when re-executing the statement.  */
+  if (params.size () < num)
+    {
+      params.resize (num);
+      intParams.resize (num);
+      stringParams.resize (num);
+      resultBuffers.resize (num);
+      overflowBuffers.resize (num);
+      overflowed.resize (num);
+      doubleParams.resize (num);
+      timeParams.resize (num);
+      isNull.resize (num);
+      truncated.resize (num);
+    }
 
-  intParams.resize (num);
-  stringParams.resize (num);
-  isNull.resize (num);
+  std::memset (params.data (), 0, params.size () * sizeof (MYSQL_BIND));
 }
 
 MYSQL_STMT*
@@ -112,12 +258,47 @@ Statement::Prepare (unsigned n, const std::string& sql)
 
   CHECK (state == State::INITIALISED) << "Statement is already prepared";
 
+  internal::PhaseTimer timer;
+  trace.BeginPrepare ();
   if (mysql_stmt_prepare (stmt, sql.data (), sql.size ()) != 0)
-    throw StmtError (stmt);
+    {
+      if (timer)
+        timer.Finish (FingerprintSql (sql), MetricsSink::Phase::PREPARE, true);
+      throw StmtError (stmt);
+    }
+
+  SetPrepared (n, sql, false);
+  trace.EndPrepare ();
+  if (timer)
+    timer.Finish (GetFingerprint (), MetricsSink::Phase::PREPARE, false);
+}
+
+void
+Statement::PrepareDirect (unsigned n, const std::string& sql)
+{
+  if (state == State::FINISHED)
+    {
+      CleanUp ();
+      Init ();
+    }
+
+  CHECK (state == State::INITIALISED) << "Statement is already prepared";
 
+  SetPrepared (n, sql, true);
+}
+
+void
+Statement::SetPrepared (const unsigned n, const std::string& sql,
+                        const bool direct)
+{
   state = State::PREPARED;
   numParams = n;
+  preparedSql = sql;
+  fingerprint.clear ();
+  directPending = direct;
+  longDataBound = false;
   ResizeParams (numParams);
+  ClearBatch ();
 }
 
 void
@@ -125,24 +306,33 @@ Statement::Reset ()
 {
   CHECK (state != State::INITIALISED) << "Statement is not prepared yet";
 
+  RecordFetchMetrics (false);
+  FinishTrace (false);
+
   if (resMeta != nullptr)
     {
       mysql_free_result (resMeta);
       resMeta = nullptr;
     }
 
-  if (mysql_stmt_reset (stmt) != 0)
+  /* If the statement is not yet prepared on the server, there is nothing
+     to reset there.  */
+  if (!directPending && mysql_stmt_reset (stmt) != 0)
     throw StmtError (stmt);
 
   state = State::PREPARED;
+  longDataBound = false;
   ResizeParams (numParams);
+  ClearBatch ();
 }
 
 MYSQL_BIND*
 Statement::BindRaw (const unsigned num)
 {
   CHECK (state == State::PREPARED) << "Statement is not in prepared state";
-  CHECK_LT (num, params.size ()) << "Parameter index out of bounds";
+  CHECK_LT (num, numParams) << "Parameter index out of bounds";
+  CHECK (!longDataBound)
+      << "Parameters cannot be bound after long data has been sent";
   return &params[num];
 }
 
@@ -166,6 +356,101 @@ template <>
   CHECK_LE (val, std::numeric_limits<decltype (intParams)::value_type>::max ())
       << "Bound integer out of bounds for param type";
   bnd->buffer = &intParams[num];
+  bnd->is_unsigned = 0;
+}
+
+template <>
+  void
+  Statement::Bind<uint64_t> (const unsigned num, const uint64_t& val)
+{
+  auto* bnd = BindRaw (num);
+
+  /* The value is stored in the memory of the signed intParams entry,
+     and MySQL is told to interpret it as unsigned.  */
+  using unsignedT = std::make_unsigned_t<decltype (intParams)::value_type>;
+  static_assert (sizeof (unsignedT) >= sizeof (val),
+                 "unsigned param type cannot hold uint64_t");
+  *reinterpret_cast<unsignedT*> (&intParams[num]) = val;
+
+  bnd->buffer_type = MYSQL_TYPE_LONGLONG;
+  bnd->buffer = &intParams[num];
+  bnd->is_unsigned = 1;
+}
+
+template <>
+  void
+  Statement::Bind<double> (const unsigned num, const double& val)
+{
+  auto* bnd = BindRaw (num);
+
+  doubleParams[num] = val;
+
+  bnd->buffer_type = MYSQL_TYPE_DOUBLE;
+  bnd->buffer = &doubleParams[num];
+}
+
+template <>
+  void
+  Statement::Bind<float> (const unsigned num, const float& val)
+{
+  Bind<double> (num, val);
+}
+
+template <>
+  void
+  Statement::Bind<MYSQL_TIME> (const unsigned num, const MYSQL_TIME& val)
+{
+  auto* bnd = BindRaw (num);
+
+  timeParams[num] = val;
+
+  bnd->buffer_type = GetTimeBufferType (val);
+  bnd->buffer = &timeParams[num];
+}
+
+template <>
+  void
+  Statement::Bind<std::chrono::system_clock::time_point> (
+      const unsigned num, const std::chrono::system_clock::time_point& val)
+{
+  using namespace std::chrono;
+  constexpr int64_t microsPerDay = 86'400'000'000;
+
+  /* Split the time into days and microseconds within the day, making sure
+     to round towards the past also for times before the epoch.  */
+  const int64_t micros
+      = floor<microseconds> (val.time_since_epoch ()).count ();
+  int64_t days = micros / microsPerDay;
+  int64_t rest = micros % microsPerDay;
+  if (rest < 0)
+    {
+      --days;
+      rest += microsPerDay;
+    }
+
+  MYSQL_TIME t;
+  std::memset (&t, 0, sizeof (t));
+  CivilFromDays (days, t);
+  t.second_part = rest % 1'000'000;
+  rest /= 1'000'000;
+  t.second = rest % 60;
+  rest /= 60;
+  t.minute = rest % 60;
+  t.hour = rest / 60;
+  t.time_type = MYSQL_TIMESTAMP_DATETIME;
+
+  Bind<MYSQL_TIME> (num, t);
+}
+
+template <>
+  void
+  Statement::Bind<Decimal> (const unsigned num, const Decimal& val)
+{
+  /* DECIMAL values are always transferred as strings in MySQL's
+     binary protocol.  */
+  BindRaw (num);
+  stringParams[num] = val.ToString ();
+  BindStringParam (num, MYSQL_TYPE_NEWDECIMAL);
 }
 
 template <>
@@ -179,157 +464,1245 @@ template <>
   void
   Statement::Bind<std::string> (const unsigned num, const std::string& val)
 {
-  BindBlob (num, val);
-  BindRaw (num)->buffer_type = MYSQL_TYPE_STRING;
+  BindRaw (num);
+  stringParams[num] = val;
+  BindStringParam (num, MYSQL_TYPE_STRING);
 }
 
 void
-Statement::BindBlob (const unsigned num, const std::string& val)
+Statement::Bind (const unsigned num, std::string&& val)
 {
-  auto* bnd = BindRaw (num);
+  BindRaw (num);
+  stringParams[num] = std::move (val);
+  BindStringParam (num, MYSQL_TYPE_STRING);
+}
 
+void
+Statement::BindBlob (const unsigned num, const std::string& val)
+{
+  BindRaw (num);
   stringParams[num] = val;
-  auto* sizePtr = GetBindLengthPtr (&intParams[num]);
-  *sizePtr = val.size ();
+  BindStringParam (num, MYSQL_TYPE_BLOB);
+}
 
-  bnd->buffer_type = MYSQL_TYPE_BLOB;
-  bnd->buffer = const_cast<char*> (stringParams[num].data ());
-  bnd->length = sizePtr;
+void
+Statement::BindBlob (const unsigned num, std::string&& val)
+{
+  BindRaw (num);
+  stringParams[num] = std::move (val);
+  BindStringParam (num, MYSQL_TYPE_BLOB);
 }
 
 void
-Statement::Execute ()
+Statement::BindView (const unsigned num, const std::string_view val)
+{
+  BindViewParam (num, val, MYSQL_TYPE_STRING);
+}
+
+void
+Statement::BindBlobView (const unsigned num, const std::string_view val)
+{
+  BindViewParam (num, val, MYSQL_TYPE_BLOB);
+}
+
+Statement::LongDataWriter
+Statement::BindLongData (const unsigned num)
+{
+  CHECK (!directPending) << "Long data requires a prepared statement";
+  BindViewParam (num, "", MYSQL_TYPE_BLOB);
+  return LongDataWriter (*this, num);
+}
+
+void
+Statement::LongDataWriter::Write (const std::string_view data)
+{
+  stmt.SendLongData (num, data);
+}
+
+void
+Statement::SendLongData (const unsigned num, std::string_view data)
 {
   CHECK (state == State::PREPARED) << "Statement is not in prepared state";
-  if (!params.empty () && mysql_stmt_bind_param (stmt, params.data ()) != 0)
-    throw StmtError (stmt);
+  CHECK_LT (num, numParams) << "Parameter index out of bounds";
 
-  if (mysql_stmt_execute (stmt) != 0)
-    throw StmtError (stmt);
+  /* The connector requires the parameters to be bound before long data
+     is sent for them.  */
+  if (!longDataBound)
+    {
+      if (mysql_stmt_bind_param (stmt, params.data ()) != 0)
+        throw StmtError (stmt);
+      longDataBound = true;
+    }
 
-  state = State::FINISHED;
+  while (!data.empty ())
+    {
+      const size_t len = std::min (data.size (), LONG_DATA_CHUNK_SIZE);
+      if (mysql_stmt_send_long_data (stmt, num, data.data (), len) != 0)
+        throw StmtError (stmt);
+      data.remove_prefix (len);
+    }
+}
 
-  params.clear ();
-  intParams.clear ();
-  stringParams.clear ();
+void
+Statement::BindStringParam (const unsigned num, const enum_field_types type)
+{
+  BindViewParam (num, stringParams[num], type);
 }
 
 void
-Statement::Query ()
+Statement::BindViewParam (const unsigned num, const std::string_view val,
+                          const enum_field_types type)
 {
-  Execute ();
-  state = State::QUERIED;
+  auto* bnd = BindRaw (num);
 
-  my_bool update = 1;
-  CHECK_EQ (mysql_stmt_attr_set (stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &update),
-            0);
+  auto* sizePtr = GetBindLengthPtr (&intParams[num]);
+  *sizePtr = val.size ();
 
-  if (mysql_stmt_store_result (stmt) != 0)
-    throw StmtError (stmt);
+  /* An empty view may not point to any memory at all, but MySQL expects
+     a valid buffer.  */
+  const char* data = val.data ();
+  if (data == nullptr)
+    data = "";
 
-  resMeta = mysql_stmt_result_metadata (stmt);
-  if (resMeta == nullptr)
-    throw Error ("No result metadata returned for statement query");
+  bnd->buffer_type = type;
+  bnd->buffer = const_cast<char*> (data);
+  bnd->length = sizePtr;
+}
 
-  const unsigned numFields = mysql_num_fields (resMeta);
-  ResizeParams (numFields);
+void
+Statement::AppendCacheKey (std::string& key) const
+{
+  CHECK (state == State::PREPARED) << "Statement is not in prepared state";
+  CHECK (!longDataBound) << "Statements with long data cannot be cached";
 
-  /* We process all fields.  While doing so, we store their names, so the user
-     can look up result fields by name (instead of index).  And we also
-     check their type, and apply an appropriate bind for them to local
-     memory (in the instance).  This abstracts the binding part away from
-     the caller, and they can just step through the result and get the
-     values via function calls.  */
-  for (unsigned i = 0; i < numFields; ++i)
+  const auto appendRaw = [&key] (const auto& val)
     {
-      const auto* field = mysql_fetch_field_direct (resMeta, i);
-      resFields.push_back (field);
-      columnsByName.emplace (field->name, i);
+      key.append (reinterpret_cast<const char*> (&val), sizeof (val));
+    };
 
-      auto* bnd = &params[i];
-      bnd->is_null = &isNull[i];
-      switch (field->type)
+  key += preparedSql;
+  key.push_back ('\0');
+
+  for (unsigned i = 0; i < numParams; ++i)
+    {
+      const auto& bnd = params[i];
+      appendRaw (bnd.buffer_type);
+
+      switch (bnd.buffer_type)
         {
-        case MYSQL_TYPE_TINY:
-        case MYSQL_TYPE_SHORT:
-        case MYSQL_TYPE_LONG:
-        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_NULL:
+          break;
+
         case MYSQL_TYPE_LONGLONG:
-          bnd->buffer_type = MYSQL_TYPE_LONGLONG;
-          bnd->buffer = &intParams[i];
+          appendRaw (intParams[i]);
+          appendRaw (bnd.is_unsigned);
           break;
 
-        case MYSQL_TYPE_STRING:
-        case MYSQL_TYPE_VAR_STRING:
-        case MYSQL_TYPE_TINY_BLOB:
-        case MYSQL_TYPE_BLOB:
-        case MYSQL_TYPE_MEDIUM_BLOB:
-        case MYSQL_TYPE_LONG_BLOB:
-          stringParams[i].resize (field->max_length);
-          bnd->buffer_type = MYSQL_TYPE_LONG_BLOB;
-          bnd->buffer = const_cast<char*> (stringParams[i].data ());
-          bnd->buffer_length = stringParams[i].size ();
-          bnd->length = GetBindLengthPtr (&intParams[i]);
+        case MYSQL_TYPE_DOUBLE:
+          appendRaw (doubleParams[i]);
           break;
 
+        case MYSQL_TYPE_DATE:
+        case MYSQL_TYPE_TIME:
+        case MYSQL_TYPE_DATETIME:
+        case MYSQL_TYPE_TIMESTAMP:
+          {
+            /* The struct may have padding, so we use the fields.  */
+            const auto& t = timeParams[i];
+            for (const unsigned long f : {t.year, t.month, t.day,
+                                          t.hour, t.minute, t.second})
+              appendRaw (f);
+            appendRaw (t.second_part);
+            appendRaw (t.neg);
+            break;
+          }
+
         default:
-          LOG (FATAL)
-              << "Output type of " << field->type << " is not yet implemented";
+          CHECK (bnd.length != nullptr)
+              << "Unexpected bound parameter type " << bnd.buffer_type;
+          appendRaw (*bnd.length);
+          key.append (static_cast<const char*> (bnd.buffer), *bnd.length);
+          break;
         }
     }
-
-  if (!params.empty () && mysql_stmt_bind_result (stmt, params.data ()) != 0)
-    throw StmtError (stmt);
 }
 
-bool
-Statement::Fetch ()
+void
+Statement::BindForExecute ()
 {
-  CHECK (state == State::QUERIED) << "Statement is not in queried state";
+  CHECK (state == State::PREPARED) << "Statement is not in prepared state";
 
-  const int res = mysql_stmt_fetch (stmt);
-  if (res == MYSQL_NO_DATA)
+  /* For direct execution, the number of parameters is not yet known
+     from the server, and has to be set explicitly before binding.  */
+  if (directPending)
     {
-      state = State::FINISHED;
-      return false;
+      unsigned int n = numParams;
+      CHECK_EQ (mysql_stmt_attr_set (stmt, STMT_ATTR_PREBIND_PARAMS, &n), 0);
     }
 
-  /* Truncation should be impossible since we set the buffer sizes
-     explicitly large enough.  */
-  CHECK_NE (res, MYSQL_DATA_TRUNCATED) << "MySQL data truncated";
+  /* If long data has been sent, the parameters are bound already.  */
+  if (longDataBound)
+    {
+      longDataBound = false;
+      return;
+    }
 
-  if (res != 0)
+  if (numParams > 0 && mysql_stmt_bind_param (stmt, params.data ()) != 0)
     throw StmtError (stmt);
+}
 
-  return true;
+void
+Statement::Execute ()
+{
+  trace.Start ();
+  ExecuteInternal ();
+  FinishTrace (false);
 }
 
-unsigned
-Statement::GetIndex (const std::string& col) const
+void
+Statement::ExecuteInternal ()
 {
-  CHECK (state == State::QUERIED) << "Statement is not in queried state";
-  auto mit = columnsByName.find (col);
-  CHECK (mit != columnsByName.end ())
-      << "Column '" << col << "' is not in the result set";
-  return mit->second;
+  auto traceStart = trace.Now ();
+  try
+    {
+      BindForExecute ();
+    }
+  catch (...)
+    {
+      FinishTrace (true);
+      throw;
+    }
+  if (trace)
+    {
+      trace.Record (TraceSink::EventType::BIND, traceStart);
+      traceStart = trace.Now ();
+    }
+
+  internal::PhaseTimer timer;
+  int rc;
+  if (directPending)
+    {
+      rc = mariadb_stmt_execute_direct (stmt, preparedSql.data (),
+                                        preparedSql.size ());
+      if (rc == 0)
+        directPending = false;
+    }
+  else
+    rc = mysql_stmt_execute (stmt);
+
+  if (timer)
+    timer.Finish (GetFingerprint (), MetricsSink::Phase::EXECUTE, rc != 0);
+  if (trace)
+    trace.Record (TraceSink::EventType::EXECUTE, traceStart);
+  if (rc != 0)
+    {
+      FinishTrace (true);
+      throw StmtError (stmt);
+    }
+
+  state = State::FINISHED;
 }
 
-bool
-Statement::IsNull (const std::string& col) const
+void
+Statement::ClearBatch ()
 {
-  return isNull[GetIndex (col)];
+  for (auto& batch : batchParams)
+    {
+      batch.type = MYSQL_TYPE_NULL;
+      batch.isUnsigned = false;
+      batch.ints.clear ();
+      batch.doubles.clear ();
+      batch.times.clear ();
+      batch.strings.clear ();
+      batch.buffers.clear ();
+      batch.lengths.clear ();
+      batch.indicators.clear ();
+    }
+  batchRows = 0;
 }
 
-template <>
-  int64_t
-  Statement::Get<int64_t> (const std::string& col) const
+void
+Statement::AddBatchRow ()
 {
-  const unsigned ind = GetIndex (col);
-  CHECK (!isNull[ind]) << "Column '" << col << "' is null";
-  CHECK_EQ (params[ind].buffer_type, MYSQL_TYPE_LONGLONG)
-      << "Column '" << col << "' is not of integer type";
+  CHECK (state == State::PREPARED) << "Statement is not in prepared state";
+  CHECK_GT (numParams, 0u) << "Batch execution requires parameters";
+  CHECK (!longDataBound) << "Long data is not supported in batches";
+
+  batchParams.resize (numParams);
+  for (unsigned i = 0; i < numParams; ++i)
+    {
+      auto& batch = batchParams[i];
+      const auto type = params[i].buffer_type;
+
+      long long int intValue = 0;
+      double doubleValue = 0.0;
+      MYSQL_TIME timeValue = MYSQL_TIME ();
+      std::string strValue;
+      unsigned long length = 0;
+      char indicator = STMT_INDICATOR_NONE;
+      switch (type)
+        {
+        case MYSQL_TYPE_NULL:
+          indicator = STMT_INDICATOR_NULL;
+          break;
+
+        case MYSQL_TYPE_LONGLONG:
+          if (batch.type == MYSQL_TYPE_NULL)
+            batch.isUnsigned = params[i].is_unsigned;
+          CHECK_EQ (batch.isUnsigned, static_cast<bool> (params[i].is_unsigned))
+              << "Inconsistent signedness for batch parameter " << i;
+          intValue = intParams[i];
+          break;
+
+        case MYSQL_TYPE_DOUBLE:
+          doubleValue = doubleParams[i];
+          break;
+
+        case MYSQL_TYPE_DATE:
+        case MYSQL_TYPE_TIME:
+        case MYSQL_TYPE_DATETIME:
+        case MYSQL_TYPE_TIMESTAMP:
+          timeValue = timeParams[i];
+          break;
+
+        case MYSQL_TYPE_STRING:
+        case MYSQL_TYPE_BLOB:
+        case MYSQL_TYPE_NEWDECIMAL:
+          length = *params[i].length;
+          /* If the value is held by the statement itself, we can move
+             it into the batch.  If it was bound as view, we have
+             to copy it though.  */
+          if (params[i].buffer == stringParams[i].data ())
+            strValue = std::move (stringParams[i]);
+          else
+            strValue.assign (static_cast<const char*> (params[i].buffer),
+                             length);
+          break;
+
+        default:
+          LOG (FATAL)
+              << "Batch parameter type " << type << " is not supported";
+        }
+
+      if (type != MYSQL_TYPE_NULL)
+        {
+          if (batch.type == MYSQL_TYPE_NULL)
+            batch.type = type;
+          CHECK_EQ (batch.type, type)
+              << "Inconsistent types for batch parameter " << i;
+        }
+
+      batch.ints.push_back (intValue);
+      batch.doubles.push_back (doubleValue);
+      batch.times.push_back (timeValue);
+      batch.strings.push_back (std::move (strValue));
+      batch.lengths.push_back (length);
+      batch.indicators.push_back (indicator);
+    }
+
+  ++batchRows;
+  ResizeParams (numParams);
+}
+
+uint64_t
+Statement::ExecuteBatch ()
+{
+  CHECK (state == State::PREPARED) << "Statement is not in prepared state";
+  CHECK_GT (batchRows, 0u) << "No rows have been added to the batch";
+
+  /* Set up the parameter binds to point to the column-wise arrays holding
+     the values for all rows.  */
+  ResizeParams (numParams);
+  for (unsigned i = 0; i < numParams; ++i)
+    {
+      auto& batch = batchParams[i];
+      auto* bnd = &params[i];
+      bnd->u.indicator = batch.indicators.data ();
+
+      switch (batch.type)
+        {
+        case MYSQL_TYPE_STRING:
+        case MYSQL_TYPE_BLOB:
+        case MYSQL_TYPE_NEWDECIMAL:
+          batch.buffers.clear ();
+          for (auto& str : batch.strings)
+            batch.buffers.push_back (const_cast<char*> (str.data ()));
+          bnd->buffer_type = batch.type;
+          bnd->buffer = batch.buffers.data ();
+          bnd->length = batch.lengths.data ();
+          break;
+
+        case MYSQL_TYPE_DOUBLE:
+          bnd->buffer_type = MYSQL_TYPE_DOUBLE;
+          bnd->buffer = batch.doubles.data ();
+          break;
+
+        case MYSQL_TYPE_DATE:
+        case MYSQL_TYPE_TIME:
+        case MYSQL_TYPE_DATETIME:
+        case MYSQL_TYPE_TIMESTAMP:
+          bnd->buffer_type = batch.type;
+          bnd->buffer = batch.times.data ();
+          break;
+
+        default:
+          /* Parameters that are NULL in all rows are simply bound as
+             integers, the values are never used anyway.  */
+          bnd->buffer_type = MYSQL_TYPE_LONGLONG;
+          bnd->buffer = batch.ints.data ();
+          bnd->is_unsigned = batch.isUnsigned;
+          break;
+        }
+    }
+
+  unsigned int arraySize = batchRows;
+  CHECK_EQ (mysql_stmt_attr_set (stmt, STMT_ATTR_ARRAY_SIZE, &arraySize), 0);
+
+  /* Make sure to unset the array size in any case, so that the statement
+     can be used for normal executions again after a reset.  */
+  try
+    {
+      Execute ();
+    }
+  catch (...)
+    {
+      arraySize = 0;
+      mysql_stmt_attr_set (stmt, STMT_ATTR_ARRAY_SIZE, &arraySize);
+      ClearBatch ();
+      throw;
+    }
+
+  arraySize = 0;
+  CHECK_EQ (mysql_stmt_attr_set (stmt, STMT_ATTR_ARRAY_SIZE, &arraySize), 0);
+  ClearBatch ();
+
+  return mysql_stmt_affected_rows (stmt);
+}
+
+void
+Statement::SetPrefetchRows (const unsigned long rows)
+{
+  CHECK_GT (rows, 0u) << "Prefetch rows must be positive";
+  prefetchRows = rows;
+}
+
+void
+Statement::SetOutputBufferLimit (const size_t maxBytes)
+{
+  CHECK_GT (maxBytes, 0u) << "Output buffer limit must be positive";
+  maxOutputBuffer = maxBytes;
+}
+
+void
+Statement::SetInlineBufferSize (const size_t bytes)
+{
+  CHECK_GT (bytes, 0u) << "Inline buffer size must be positive";
+  inlineBufferSize = bytes;
+}
+
+void
+Statement::SetCursorAttributes (const ResultMode mode)
+{
+  /* The cursor type stays set on the statement also for later executions,
+     so we have to explicitly unset it if no cursor is wanted.  */
+  const unsigned long cursorType
+      = (mode == ResultMode::CURSOR
+            ? CURSOR_TYPE_READ_ONLY : CURSOR_TYPE_NO_CURSOR);
+  CHECK_EQ (mysql_stmt_attr_set (stmt, STMT_ATTR_CURSOR_TYPE, &cursorType),
+            0);
+
+  if (mode == ResultMode::CURSOR)
+    {
+      CHECK_EQ (mysql_stmt_attr_set (stmt, STMT_ATTR_PREFETCH_ROWS,
+                                     &prefetchRows),
+                0);
+    }
+}
+
+void
+Statement::Query (const ResultMode mode)
+{
+  SetCursorAttributes (mode);
+  trace.Start ();
+  ExecuteInternal ();
+
+  if (mode == ResultMode::BUFFERED)
+    {
+      internal::PhaseTimer timer;
+      const auto traceStart = trace.Now ();
+      const int rc = mysql_stmt_store_result (stmt);
+      if (timer)
+        timer.Finish (GetFingerprint (), MetricsSink::Phase::STORE_RESULT,
+                      rc != 0);
+      if (trace)
+        trace.Record (TraceSink::EventType::STORE_RESULT, traceStart);
+      if (rc != 0)
+        {
+          FinishTrace (true);
+          throw StmtError (stmt);
+        }
+    }
+
+  try
+    {
+      SetUpResult (mode);
+    }
+  catch (...)
+    {
+      FinishTrace (true);
+      throw;
+    }
+}
+
+void
+Statement::SetUpResult (const ResultMode mode)
+{
+  state = State::QUERIED;
+
+  resMeta = mysql_stmt_result_metadata (stmt);
+  if (resMeta == nullptr)
+    throw Error ("No result metadata returned for statement query");
+
+  const unsigned numFields = mysql_num_fields (resMeta);
+  ResizeParams (numFields);
+
+  /* The map of column names is only rebuilt if the result columns
+     are different from the previous query (e.g. after the statement
+     has been re-prepared with a different SQL string).  When the same
+     statement is just re-executed, we can keep it.  */
+  bool sameColumns = (columnNames.size () == numFields);
+  resFields.clear ();
+  for (unsigned i = 0; i < numFields; ++i)
+    {
+      const auto* field = mysql_fetch_field_direct (resMeta, i);
+      resFields.push_back (field);
+      if (sameColumns && columnNames[i] != field->name)
+        sameColumns = false;
+    }
+  if (!sameColumns)
+    {
+      /* The map keys are views into columnNames, so all names have to be
+         in place (without reallocations) before the map is filled.  */
+      columnNames.clear ();
+      columnsByName.clear ();
+      columnNames.reserve (numFields);
+      for (unsigned i = 0; i < numFields; ++i)
+        columnNames.emplace_back (resFields[i]->name);
+      for (unsigned i = 0; i < numFields; ++i)
+        columnsByName.emplace (columnNames[i], i);
+    }
+
+  /* We process all fields, check their type, and apply an appropriate bind
+     for them to local memory (in the instance).  This abstracts the binding
+     part away from the caller, and they can just step through the result
+     and get the values via function calls.  */
+  for (unsigned i = 0; i < numFields; ++i)
+    {
+      const auto* field = resFields[i];
+
+      auto* bnd = &params[i];
+      bnd->is_null = &isNull[i];
+      bnd->error = &truncated[i];
+      overflowed[i] = 0;
+      switch (field->type)
+        {
+        case MYSQL_TYPE_TINY:
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONGLONG:
+          bnd->buffer_type = MYSQL_TYPE_LONGLONG;
+          bnd->buffer = &intParams[i];
+          bnd->is_unsigned = (field->flags & UNSIGNED_FLAG) != 0;
+          break;
+
+        case MYSQL_TYPE_FLOAT:
+        case MYSQL_TYPE_DOUBLE:
+          bnd->buffer_type = MYSQL_TYPE_DOUBLE;
+          bnd->buffer = &doubleParams[i];
+          break;
+
+        case MYSQL_TYPE_DATE:
+        case MYSQL_TYPE_TIME:
+        case MYSQL_TYPE_DATETIME:
+        case MYSQL_TYPE_TIMESTAMP:
+          bnd->buffer_type = field->type;
+          bnd->buffer = &timeParams[i];
+          break;
+
+        case MYSQL_TYPE_DECIMAL:
+        case MYSQL_TYPE_NEWDECIMAL:
+        case MYSQL_TYPE_STRING:
+        case MYSQL_TYPE_VAR_STRING:
+        case MYSQL_TYPE_TINY_BLOB:
+        case MYSQL_TYPE_BLOB:
+        case MYSQL_TYPE_MEDIUM_BLOB:
+        case MYSQL_TYPE_LONG_BLOB:
+          /* When streaming (or using a cursor), we use whatever capacity
+             the buffer has already from previous queries, to avoid
+             truncations.  */
+          if (mode == ResultMode::BUFFERED)
+            resultBuffers[i].resize (std::min<size_t> (
+                field->max_length,
+                std::min (maxOutputBuffer, inlineBufferSize)));
+          else
+            resultBuffers[i].resize (std::min (
+                std::max<size_t> (
+                    resultBuffers[i].capacity (),
+                    std::min (field->length, STREAMING_BUFFER_SIZE)),
+                std::min (maxOutputBuffer, inlineBufferSize)));
+          bnd->buffer_type = MYSQL_TYPE_LONG_BLOB;
+          bnd->buffer = resultBuffers[i].data ();
+          bnd->buffer_length = resultBuffers[i].size ();
+          bnd->length = GetBindLengthPtr (&intParams[i]);
+          break;
+
+        default:
+          LOG (FATAL)
+              << "Output type of " << field->type << " is not yet implemented";
+        }
+    }
+
+  if (numFields > 0 && mysql_stmt_bind_result (stmt, params.data ()) != 0)
+    throw StmtError (stmt);
+}
+
+bool
+Statement::Fetch ()
+{
+  CHECK (state == State::QUERIED) << "Statement is not in queried state";
+
+  internal::PhaseTimer timer;
+  if (!timer && !trace)
+    return ProcessFetch (mysql_stmt_fetch (stmt));
+
+  const auto traceStart = trace.Now ();
+  bool res;
+  if (timer)
+    fetchMetrics.active = true;
+  try
+    {
+      res = ProcessFetch (mysql_stmt_fetch (stmt));
+    }
+  catch (...)
+    {
+      if (timer)
+        {
+          fetchMetrics.duration += timer.Elapsed ();
+          RecordFetchMetrics (true);
+        }
+      if (trace)
+        {
+          trace.RecordFetch (traceStart, false, 0);
+          FinishTrace (true);
+        }
+      throw;
+    }
+
+  const uint64_t rowBytes = (res ? GetRowBytes () : 0);
+  if (timer)
+    {
+      fetchMetrics.duration += timer.Elapsed ();
+      if (res)
+        {
+          ++fetchMetrics.rows;
+          fetchMetrics.bytes += rowBytes;
+        }
+      else
+        RecordFetchMetrics (false);
+    }
+  if (trace)
+    {
+      trace.RecordFetch (traceStart, res, rowBytes);
+      if (!res)
+        FinishTrace (false);
+    }
+
+  return res;
+}
+
+const std::string&
+Statement::GetFingerprint ()
+{
+  if (fingerprint.empty ())
+    fingerprint = FingerprintSql (preparedSql);
+  return fingerprint;
+}
+
+void
+Statement::FinishTrace (const bool error)
+{
+  trace.Finish (error,
+                [this] () -> std::string_view { return GetFingerprint (); },
+                [this] ()
+                  {
+                    return stmt == nullptr ? 0u
+                                           : mysql_stmt_warning_count (stmt);
+                  });
+}
+
+void
+Statement::RecordFetchMetrics (const bool error)
+{
+  if (!fetchMetrics.active)
+    return;
+
+  auto* sink = GetMetricsSink ();
+  if (sink != nullptr)
+    {
+      MetricsSink::Event ev;
+      ev.fingerprint = GetFingerprint ();
+      ev.phase = MetricsSink::Phase::FETCH;
+      ev.duration = fetchMetrics.duration;
+      ev.rows = fetchMetrics.rows;
+      ev.bytes = fetchMetrics.bytes;
+      ev.error = error;
+      sink->Record (ev);
+    }
+
+  fetchMetrics = FetchMetrics ();
+}
+
+uint64_t
+Statement::GetRowBytes () const
+{
+  uint64_t res = 0;
+  for (size_t i = 0; i < resFields.size (); ++i)
+    {
+      if (isNull[i])
+        continue;
+
+      switch (params[i].buffer_type)
+        {
+        case MYSQL_TYPE_LONG_BLOB:
+          res += *params[i].length;
+          break;
+        case MYSQL_TYPE_LONGLONG:
+          res += sizeof (intParams[i]);
+          break;
+        case MYSQL_TYPE_DOUBLE:
+          res += sizeof (doubleParams[i]);
+          break;
+        default:
+          res += sizeof (timeParams[i]);
+          break;
+        }
+    }
+
+  return res;
+}
+
+Statement::RowRange
+Statement::Rows ()
+{
+  CHECK (state == State::QUERIED) << "Statement is not in queried state";
+  return RowRange (*this);
+}
+
+size_t
+Statement::FetchBatch (ResultBatch& batch, const size_t maxRows)
+{
+  CHECK_GT (maxRows, 0u) << "Batches must have room for at least one row";
+  CHECK (state == State::QUERIED || state == State::FINISHED)
+      << "Statement is not in queried state";
+
+  const size_t numColumns = resFields.size ();
+  batch.Reset (numColumns);
+  for (size_t i = 0; i < numColumns; ++i)
+    switch (params[i].buffer_type)
+      {
+      case MYSQL_TYPE_LONGLONG:
+        /* Only BIGINT UNSIGNED can exceed the range of int64_t.  */
+        if (params[i].is_unsigned
+              && resFields[i]->type == MYSQL_TYPE_LONGLONG)
+          batch.SetType (i, ResultBatch::Type::UINT);
+        else
+          batch.SetType (i, ResultBatch::Type::INT);
+        break;
+      case MYSQL_TYPE_DOUBLE:
+        batch.SetType (i, ResultBatch::Type::DOUBLE);
+        break;
+      case MYSQL_TYPE_DATE:
+      case MYSQL_TYPE_TIME:
+      case MYSQL_TYPE_DATETIME:
+      case MYSQL_TYPE_TIMESTAMP:
+        batch.SetType (i, ResultBatch::Type::TIME);
+        break;
+      case MYSQL_TYPE_LONG_BLOB:
+        batch.SetType (i, ResultBatch::Type::STRING);
+        break;
+      default:
+        LOG (FATAL)
+            << "Type of column '" << resFields[i]->name
+            << "' is not supported in batches";
+      }
+
+  /* The Fetch calls for this batch are merged into one trace event.  */
+  trace.CloseFetch ();
+  deferTruncated = true;
+  try
+    {
+      while (state == State::QUERIED && batch.GetNumRows () < maxRows
+               && Fetch ())
+        {
+          batch.AddRow ();
+          for (size_t i = 0; i < numColumns; ++i)
+            {
+              if (isNull[i])
+                {
+                  batch.AppendNull (i);
+                  continue;
+                }
+
+              switch (batch.columns[i].type)
+                {
+                case ResultBatch::Type::INT:
+                  batch.AppendInt (i, intParams[i]);
+                  continue;
+                case ResultBatch::Type::UINT:
+                  batch.AppendUint (i, static_cast<uint64_t> (intParams[i]));
+                  continue;
+                case ResultBatch::Type::DOUBLE:
+                  batch.AppendDouble (i, doubleParams[i]);
+                  continue;
+                case ResultBatch::Type::TIME:
+                  batch.AppendTime (i, timeParams[i]);
+                  continue;
+                case ResultBatch::Type::STRING:
+                  break;
+                }
+
+              if (!truncated[i])
+                batch.AppendString (i, GetValueData (i), *params[i].length);
+              else
+                {
+                  /* Values that did not fit into the bound buffer are
+                     fetched straight into the batch's column data.  */
+                  MYSQL_BIND bnd = params[i];
+                  bnd.buffer_length = *params[i].length;
+                  bnd.buffer = batch.AppendStringSpace (i, bnd.buffer_length);
+                  /* The bound buffer still only holds a prefix, so the
+                     column stays marked as truncated for accessors on
+                     the statement's current row.  */
+                  if (mysql_stmt_fetch_column (stmt, &bnd, i, 0) != 0)
+                    throw StmtError (stmt);
+                }
+            }
+        }
+    }
+  catch (...)
+    {
+      deferTruncated = false;
+      throw;
+    }
+  deferTruncated = false;
+  trace.CloseFetch ();
+
+  return batch.GetNumRows ();
+}
+
+bool
+Statement::ProcessFetch (const int res)
+{
+  if (res == MYSQL_NO_DATA)
+    {
+      state = State::FINISHED;
+      return false;
+    }
+
+  ClearOverflow ();
+
+  /* Truncation can happen if the result is streamed, and a value is larger
+     than the current buffer of the column.  */
+  if (res == MYSQL_DATA_TRUNCATED)
+    FetchTruncated ();
+  else if (res != 0)
+    throw StmtError (stmt);
+
+  return true;
+}
+
+void
+Statement::FetchTruncated ()
+{
+  bool grown = false;
+  for (unsigned i = 0; i < resFields.size (); ++i)
+    {
+      if (!truncated[i])
+        continue;
+
+      auto* bnd = &params[i];
+      CHECK_EQ (bnd->buffer_type, MYSQL_TYPE_LONG_BLOB)
+          << "Non-string column '" << resFields[i]->name << "' truncated";
+
+      /* The length pointer has been filled in with the full length of
+         the value during the fetch.  If it is above the limit, we leave
+         the value truncated, and it has to be read with ReadColumn.  */
+      if (deferTruncated || *bnd->length > maxOutputBuffer)
+        continue;
+
+      /* Values larger than the inline buffer are fetched into the overflow
+         buffer, keeping the inline one as it is.  */
+      if (*bnd->length > inlineBufferSize)
+        {
+          auto& buf = overflowBuffers[i];
+          buf.resize (*bnd->length);
+
+          MYSQL_BIND ob = *bnd;
+          ob.buffer = buf.data ();
+          ob.buffer_length = buf.size ();
+          if (mysql_stmt_fetch_column (stmt, &ob, i, 0) != 0)
+            throw StmtError (stmt);
+
+          overflowed[i] = 1;
+          truncated[i] = 0;
+          continue;
+        }
+
+      resultBuffers[i].resize (*bnd->length);
+      bnd->buffer = resultBuffers[i].data ();
+      bnd->buffer_length = resultBuffers[i].size ();
+      grown = true;
+
+      if (mysql_stmt_fetch_column (stmt, bnd, i, 0) != 0)
+        throw StmtError (stmt);
+      truncated[i] = 0;
+    }
+
+  /* Bind the result again, so that the grown buffers are used directly
+     for the following rows.  */
+  if (grown && mysql_stmt_bind_result (stmt, params.data ()) != 0)
+    throw StmtError (stmt);
+}
+
+void
+Statement::ClearOverflow ()
+{
+  /* Overflow buffers are kept for reuse unless they are much larger
+     than the inline buffers (which is only possible if they are set).  */
+  const size_t retain
+      = inlineBufferSize > std::numeric_limits<size_t>::max () / 4
+          ? inlineBufferSize : 4 * inlineBufferSize;
+
+  for (unsigned i = 0; i < resFields.size (); ++i)
+    {
+      if (!overflowed[i])
+        continue;
+
+      overflowed[i] = 0;
+      if (overflowBuffers[i].capacity () > retain)
+        std::string ().swap (overflowBuffers[i]);
+    }
+}
+
+const char*
+Statement::GetValueData (const Column ind) const
+{
+  return overflowed[ind] ? overflowBuffers[ind].data ()
+                         : resultBuffers[ind].data ();
+}
+
+/* ************************************************************************** */
+
+/**
+ * Async implementation of Statement::Execute.
+ */
+class Statement::ExecuteOp : public AsyncOperation::Impl
+{
+
+private:
+
+  Statement& stmt;
+
+  /** The return value of the MySQL execute call.  */
+  int rc;
+
+  int
+  ProcessDone ()
+  {
+    if (rc != 0)
+      throw StmtError (stmt.stmt);
+    stmt.state = State::FINISHED;
+    return 0;
+  }
+
+public:
+
+  explicit ExecuteOp (Statement& s)
+    : stmt(s)
+  {}
+
+  int
+  Start () override
+  {
+    CHECK (!stmt.directPending)
+        << "Direct execution is not supported asynchronously";
+    stmt.BindForExecute ();
+    const int status = mysql_stmt_execute_start (&rc, stmt.stmt);
+    if (status != 0)
+      return status;
+    return ProcessDone ();
+  }
+
+  int
+  Continue (const int ready) override
+  {
+    const int status = mysql_stmt_execute_cont (&rc, stmt.stmt, ready);
+    if (status != 0)
+      return status;
+    return ProcessDone ();
+  }
+
+};
+
+/**
+ * Async implementation of Statement::Query.  This executes the statement,
+ * then stores the result (if it is buffered), and finally sets up the
+ * result binds (which does not block).
+ */
+class Statement::QueryOp : public AsyncOperation::Impl
+{
+
+private:
+
+  Statement& stmt;
+  const ResultMode mode;
+
+  /** The return value of the current MySQL call.  */
+  int rc;
+
+  /** Set to true when the execute step is done.  */
+  bool executed = false;
+
+  int
+  ProcessDone ()
+  {
+    if (rc != 0)
+      throw StmtError (stmt.stmt);
+
+    if (!executed)
+      {
+        executed = true;
+        stmt.state = State::FINISHED;
+
+        if (mode == ResultMode::BUFFERED)
+          {
+            const int status
+                = mysql_stmt_store_result_start (&rc, stmt.stmt);
+            if (status != 0)
+              return status;
+            return ProcessDone ();
+          }
+      }
+
+    stmt.SetUpResult (mode);
+    return 0;
+  }
+
+public:
+
+  explicit QueryOp (Statement& s, const ResultMode m)
+    : stmt(s), mode(m)
+  {}
+
+  int
+  Start () override
+  {
+    CHECK (!stmt.directPending)
+        << "Direct execution is not supported asynchronously";
+    stmt.SetCursorAttributes (mode);
+    stmt.BindForExecute ();
+    const int status = mysql_stmt_execute_start (&rc, stmt.stmt);
+    if (status != 0)
+      return status;
+    return ProcessDone ();
+  }
+
+  int
+  Continue (const int ready) override
+  {
+    const int status
+        = executed ? mysql_stmt_store_result_cont (&rc, stmt.stmt, ready)
+                   : mysql_stmt_execute_cont (&rc, stmt.stmt, ready);
+    if (status != 0)
+      return status;
+    return ProcessDone ();
+  }
+
+};
+
+/**
+ * Async implementation of Statement::Fetch.
+ */
+class Statement::FetchOp : public AsyncOperation::Impl
+{
+
+private:
+
+  Statement& stmt;
+
+  /** The return value of the MySQL fetch call.  */
+  int rc;
+
+  /** Whether or not a row has been fetched.  */
+  bool fetched = false;
+
+public:
+
+  explicit FetchOp (Statement& s)
+    : stmt(s)
+  {}
+
+  int
+  Start () override
+  {
+    CHECK (stmt.state == State::QUERIED)
+        << "Statement is not in queried state";
+    const int status = mysql_stmt_fetch_start (&rc, stmt.stmt);
+    if (status == 0)
+      fetched = stmt.ProcessFetch (rc);
+    return status;
+  }
+
+  int
+  Continue (const int ready) override
+  {
+    const int status = mysql_stmt_fetch_cont (&rc, stmt.stmt, ready);
+    if (status == 0)
+      fetched = stmt.ProcessFetch (rc);
+    return status;
+  }
+
+  bool
+  GetResult () const override
+  {
+    return fetched;
+  }
+
+};
+
+AsyncOperation
+Statement::ExecuteAsync ()
+{
+  return AsyncOperation (handle, std::make_unique<ExecuteOp> (*this));
+}
+
+AsyncOperation
+Statement::QueryAsync (const ResultMode mode)
+{
+  return AsyncOperation (handle, std::make_unique<QueryOp> (*this, mode));
+}
+
+AsyncOperation
+Statement::FetchAsync ()
+{
+  return AsyncOperation (handle, std::make_unique<FetchOp> (*this));
+}
+
+/* ************************************************************************** */
+
+unsigned
+Statement::GetIndex (const std::string& col) const
+{
+  CHECK (state == State::QUERIED) << "Statement is not in queried state";
+  auto mit = columnsByName.find (col);
+  CHECK (mit != columnsByName.end ())
+      << "Column '" << col << "' is not in the result set";
+  return mit->second;
+}
+
+void
+Statement::CheckColumn (const Column ind) const
+{
+  CHECK (state == State::QUERIED) << "Statement is not in queried state";
+  CHECK_LT (ind, resFields.size ()) << "Column index out of bounds";
+}
+
+void
+Statement::CheckNumColumns (const size_t num) const
+{
+  CHECK_EQ (num, resFields.size ())
+      << "Row type does not match the number of result columns";
+}
+
+Statement::Column
+Statement::ResolveColumn (const std::string& col) const
+{
+  return GetIndex (col);
+}
+
+bool
+Statement::IsNull (const Column ind) const
+{
+  CheckColumn (ind);
+  return isNull[ind];
+}
+
+bool
+Statement::IsTruncated (const Column ind) const
+{
+  CheckColumn (ind);
+  return truncated[ind];
+}
+
+size_t
+Statement::GetLength (const Column ind) const
+{
+  CheckColumn (ind);
+  const char* col = resFields[ind]->name;
+  CHECK (!isNull[ind]) << "Column '" << col << "' is null";
+  CHECK_EQ (params[ind].buffer_type, MYSQL_TYPE_LONG_BLOB)
+      << "Column '" << col << "' is not of string type";
+
+  return *params[ind].length;
+}
+
+size_t
+Statement::ReadColumn (const Column ind, const size_t offset,
+                       char* out, const size_t len)
+{
+  const size_t total = GetLength (ind);
+  CHECK_LE (offset, total) << "Read offset beyond the end of the value";
+
+  const size_t toRead = std::min (len, total - offset);
+  if (toRead == 0)
+    return 0;
+
+  /* If the full value is in our buffer already, just copy from there.
+     Otherwise fetch the part from the connector's row data.  */
+  if (!truncated[ind])
+    {
+      std::memcpy (out, GetValueData (ind) + offset, toRead);
+      return toRead;
+    }
+
+  MYSQL_BIND bnd;
+  std::memset (&bnd, 0, sizeof (bnd));
+  unsigned long fetched;
+  bnd.buffer_type = MYSQL_TYPE_LONG_BLOB;
+  bnd.buffer = out;
+  bnd.buffer_length = toRead;
+  bnd.length = &fetched;
+
+  if (mysql_stmt_fetch_column (stmt, &bnd, ind, offset) != 0)
+    throw StmtError (stmt);
+
+  return toRead;
+}
+
+template <>
+  int64_t
+  Statement::Get<int64_t> (const Column ind) const
+{
+  CheckColumn (ind);
+  const char* col = resFields[ind]->name;
+  CHECK (!isNull[ind]) << "Column '" << col << "' is null";
+  CHECK_EQ (params[ind].buffer_type, MYSQL_TYPE_LONGLONG)
+      << "Column '" << col << "' is not of integer type";
 
   const auto value = intParams[ind];
+  CHECK (!params[ind].is_unsigned || value >= 0)
+      << "Value of '" << col << "' is out of bounds for int64_t";
   CHECK_GE (value, std::numeric_limits<int64_t>::min ())
       << "Value of '" << col << "' is out of bounds for int64_t";
   CHECK_LE (value, std::numeric_limits<int64_t>::max ())
@@ -337,30 +1710,140 @@ template <>
   return value;
 }
 
+template <>
+  uint64_t
+  Statement::Get<uint64_t> (const Column ind) const
+{
+  CheckColumn (ind);
+  const char* col = resFields[ind]->name;
+  CHECK (!isNull[ind]) << "Column '" << col << "' is null";
+  CHECK_EQ (params[ind].buffer_type, MYSQL_TYPE_LONGLONG)
+      << "Column '" << col << "' is not of integer type";
+
+  const auto value = intParams[ind];
+  if (params[ind].is_unsigned)
+    return static_cast<uint64_t> (value);
+
+  CHECK_GE (value, 0)
+      << "Value of '" << col << "' is out of bounds for uint64_t";
+  return value;
+}
+
+template <>
+  double
+  Statement::Get<double> (const Column ind) const
+{
+  CheckColumn (ind);
+  const char* col = resFields[ind]->name;
+  CHECK (!isNull[ind]) << "Column '" << col << "' is null";
+  CHECK_EQ (params[ind].buffer_type, MYSQL_TYPE_DOUBLE)
+      << "Column '" << col << "' is not of floating-point type";
+
+  return doubleParams[ind];
+}
+
+template <>
+  float
+  Statement::Get<float> (const Column ind) const
+{
+  return Get<double> (ind);
+}
+
+template <>
+  MYSQL_TIME
+  Statement::Get<MYSQL_TIME> (const Column ind) const
+{
+  CheckColumn (ind);
+  const char* col = resFields[ind]->name;
+  CHECK (!isNull[ind]) << "Column '" << col << "' is null";
+  CHECK (IsTimeBufferType (params[ind].buffer_type))
+      << "Column '" << col << "' is not of date/time type";
+
+  return timeParams[ind];
+}
+
+template <>
+  std::chrono::system_clock::time_point
+  Statement::Get<std::chrono::system_clock::time_point> (
+      const Column ind) const
+{
+  const auto t = Get<MYSQL_TIME> (ind);
+  CHECK (t.time_type == MYSQL_TIMESTAMP_DATE
+            || t.time_type == MYSQL_TIMESTAMP_DATETIME)
+      << "Column '" << resFields[ind]->name << "' is not a point in time";
+  CHECK (!t.neg);
+
+  using namespace std::chrono;
+  const int64_t days = DaysFromCivil (t.year, t.month, t.day);
+  const int64_t secs
+      = ((days * 24 + t.hour) * 60 + t.minute) * 60 + t.second;
+  const microseconds sinceEpoch
+      = seconds (secs) + microseconds (t.second_part);
+
+  return system_clock::time_point (
+      duration_cast<system_clock::duration> (sinceEpoch));
+}
+
+template <>
+  Decimal
+  Statement::Get<Decimal> (const Column ind) const
+{
+  return Decimal::Parse (GetView (ind));
+}
+
 template <>
   bool
-  Statement::Get<bool> (const std::string& col) const
+  Statement::Get<bool> (const Column ind) const
 {
-  const auto val = Get<int64_t> (col);
+  const auto val = Get<int64_t> (ind);
   return val != 0;
 }
 
 template <>
   std::string
-  Statement::Get<std::string> (const std::string& col) const
+  Statement::Get<std::string> (const Column ind) const
+{
+  return std::string (GetView (ind));
+}
+
+template <>
+  std::string_view
+  Statement::Get<std::string_view> (const Column ind) const
 {
-  const unsigned ind = GetIndex (col);
+  return GetView (ind);
+}
+
+std::string
+Statement::GetBlob (const Column ind) const
+{
+  return Get<std::string> (ind);
+}
+
+std::string_view
+Statement::GetView (const Column ind) const
+{
+  CheckColumn (ind);
+  const char* col = resFields[ind]->name;
   CHECK (!isNull[ind]) << "Column '" << col << "' is null";
   CHECK_EQ (params[ind].buffer_type, MYSQL_TYPE_LONG_BLOB)
       << "Column '" << col << "' is not of string type";
+  CHECK (!truncated[ind])
+      << "Column '" << col << "' is truncated, use ReadColumn";
 
-  return stringParams[ind].substr (0, intParams[ind]);
+  return std::string_view (GetValueData (ind), *params[ind].length);
 }
 
-std::string
-Statement::GetBlob (const std::string& col) const
+std::string_view
+Statement::GetBlobView (const Column ind) const
+{
+  return GetView (ind);
+}
+
+void
+Statement::GetInto (const Column ind, std::string& out) const
 {
-  return Get<std::string> (col);
+  const auto view = GetView (ind);
+  out.assign (view.data (), view.size ());
 }
 
 } // namespace mypp
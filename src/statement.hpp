@@ -5,15 +5,41 @@
 #ifndef MYPP_STATEMENT_HPP
 #define MYPP_STATEMENT_HPP
 
+#include "async.hpp"
+#include "decimal.hpp"
+#include "metrics.hpp"
+#include "resultbatch.hpp"
+#include "tracing.hpp"
+
 #include <mysql.h>
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace mypp
 {
 
+class Connection;
+
+namespace internal
+{
+template <typename T>
+  struct TypedValue;
+} // namespace internal
+
+template <typename P, typename R>
+  class TypedStatement;
+
 /**
  * RAII wrapper and helper class for a prepared statement.
  */
@@ -40,25 +66,250 @@ public:
     FINISHED,
   };
 
+  /**
+   * How the result set of a query is transferred to the client.
+   */
+  enum class ResultMode
+  {
+    /**
+     * The full result set is received and stored on the client when the
+     * statement is queried, before the first row is fetched.  The output
+     * buffers are sized to exactly fit the largest value of each column.
+     */
+    BUFFERED,
+    /**
+     * Rows are received from the server one by one as they are fetched.
+     * This keeps client memory bounded for large result sets, but the
+     * connection cannot be used for anything else until all rows have
+     * been fetched or the statement is reset.  Output buffers start small
+     * and grow as needed when larger values are encountered.
+     */
+    STREAMING,
+    /**
+     * A read-only cursor is opened on the server, and rows are fetched from
+     * it in chunks of a configurable size (see SetPrefetchRows).  This bounds
+     * client memory like STREAMING, while amortising round trips over
+     * many rows.  The connection can be used for other things in between
+     * fetches.  Buffers are handled like for STREAMING.
+     */
+    CURSOR,
+  };
+
+  /**
+   * Handle for an output column, as returned by ResolveColumn.  This is the
+   * column's index in the result set, and can be used instead of the name
+   * when accessing values, to avoid looking up the name for every row.
+   */
+  using Column = unsigned;
+
+  /**
+   * Range over the remaining result rows of a queried statement, as
+   * returned by Rows.  Iterating it fetches the rows one by one, and
+   * dereferencing an iterator gives the statement itself (positioned at
+   * the row), so that the values can be read with Get and friends.  This is
+   * a single-pass range, i.e. begin must only be called once.
+   */
+  class RowRange
+  {
+
+  public:
+
+    /**
+     * Input iterator over the rows.  The end iterator is the one without
+     * a statement, and other iterators become equal to it once all rows
+     * have been fetched.
+     */
+    class Iterator
+    {
+
+    private:
+
+      /** The statement, null for the end iterator.  */
+      Statement* stmt = nullptr;
+
+    public:
+
+      using iterator_category = std::input_iterator_tag;
+      using value_type = Statement;
+      using difference_type = std::ptrdiff_t;
+      using pointer = Statement*;
+      using reference = Statement&;
+
+      Iterator () = default;
+
+      explicit Iterator (Statement& s)
+        : stmt(&s)
+      {
+        ++*this;
+      }
+
+      Statement&
+      operator* () const
+      {
+        return *stmt;
+      }
+
+      Statement*
+      operator-> () const
+      {
+        return stmt;
+      }
+
+      Iterator&
+      operator++ ()
+      {
+        if (!stmt->Fetch ())
+          stmt = nullptr;
+        return *this;
+      }
+
+      friend bool
+      operator== (const Iterator& a, const Iterator& b)
+      {
+        return a.stmt == b.stmt;
+      }
+
+      friend bool
+      operator!= (const Iterator& a, const Iterator& b)
+      {
+        return !(a == b);
+      }
+
+    };
+
+  private:
+
+    /** The statement iterated over.  */
+    Statement& stmt;
+
+  public:
+
+    explicit RowRange (Statement& s)
+      : stmt(s)
+    {}
+
+    Iterator
+    begin ()
+    {
+      return Iterator (stmt);
+    }
+
+    Iterator
+    end ()
+    {
+      return Iterator ();
+    }
+
+  };
+
 private:
 
   /** The associated MYSQL connection handle.  */
   MYSQL* const handle;
 
+  /**
+   * The Connection this statement is registered with for re-preparation
+   * on reconnect, if any.  It is reset to null if the connection is
+   * destructed before the statement.
+   */
+  Connection* conn = nullptr;
+
   /** The underlying MYSQL_STMT handle.  */
   MYSQL_STMT* stmt = nullptr;
 
+  /**
+   * The memory resource used for the bind structs, result buffers and
+   * result metadata of this statement.
+   */
+  std::pmr::memory_resource* const memory;
+
   /** The state of this statement.  */
   State state;
 
   /** Number of input parameters in the prepared SQL.  */
   unsigned numParams;
 
+  /** The SQL string the statement has been prepared with.  */
+  std::string preparedSql;
+
+  /**
+   * The fingerprint of preparedSql for metrics.  It is only computed when
+   * first needed, i.e. if metrics are enabled.
+   */
+  std::string fingerprint;
+
+  /**
+   * Metrics accumulated over the Fetch calls for the current result set,
+   * which are reported together once the result is done.
+   */
+  struct FetchMetrics
+  {
+
+    /** Set if there is data to report.  */
+    bool active = false;
+
+    /** Total time spent fetching.  */
+    std::chrono::nanoseconds duration{0};
+
+    /** Number of rows fetched.  */
+    uint64_t rows = 0;
+
+    /** Number of bytes of values fetched.  */
+    uint64_t bytes = 0;
+
+  };
+
+  /** Accumulated fetch metrics for the current result.  */
+  FetchMetrics fetchMetrics;
+
+  /** The trace of the current query.  */
+  internal::QueryTrace trace;
+
+  /** Number of rows to fetch at once from a cursor.  */
+  unsigned long prefetchRows = 1'000;
+
+  /**
+   * Set to true if the statement has been prepared with PrepareDirect,
+   * and not yet executed (i.e. it is not yet prepared on the server).
+   */
+  bool directPending = false;
+
+  /**
+   * Set to true once long data has been sent for a parameter.  The
+   * parameters have been bound on the MYSQL_STMT at that point already,
+   * and must not be re-bound until after execution (as that would
+   * discard the long data in the connector).
+   */
+  bool longDataBound = false;
+
+  /**
+   * Maximum size of the buffer for a string output column.  Values larger
+   * than that stay truncated after fetching, and can only be read in
+   * chunks with ReadColumn.
+   */
+  size_t maxOutputBuffer = std::numeric_limits<size_t>::max ();
+
+  /**
+   * Size of the inline buffers bound for string output columns, if set
+   * with SetInlineBufferSize.  Values larger than that are fetched into
+   * the overflow buffers instead of growing the inline ones.
+   */
+  size_t inlineBufferSize = std::numeric_limits<size_t>::max ();
+
+  /**
+   * Set while FetchBatch is running.  Truncated values are then not
+   * re-fetched by Fetch, since FetchBatch fetches them directly into
+   * the batch.
+   */
+  bool deferTruncated = false;
+
   /**
    * The parameter BIND structs.  They are used for input parameters before
    * the statement is executed, and then for output parameters afterwards.
+   * This and the other params vectors may be larger than the number of
+   * parameters or result columns actually in use.
    */
-  std::vector<MYSQL_BIND> params;
+  std::pmr::vector<MYSQL_BIND> params;
 
   /**
    * For parameters that are integers, this holds a copy of the
@@ -70,52 +321,300 @@ private:
    * the MYSQL_TYPE_LONGLONG for the buffer, and is assumed to be large enough
    * to hold any kind of data we might want (such as int64_t).
    */
-  std::vector<long long int> intParams;
+  std::pmr::vector<long long int> intParams;
 
   /**
-   * For parameters that are string (TEXT or BLOB), this holds a copy
-   * of the data and is the memory that the buffer points to.
+   * For input parameters that are string (TEXT or BLOB), this holds a copy
+   * of the data and is the memory that the buffer points to.  These are
+   * plain strings (not using the memory resource) so that values can be
+   * moved in when binding them.
    */
   std::vector<std::string> stringParams;
 
+  /**
+   * For string output columns, the memory that the buffer points to.
+   */
+  std::pmr::vector<std::pmr::string> resultBuffers;
+
+  /**
+   * For string output columns whose value in the current row did not fit
+   * into the inline buffer, the full value.  These are plain strings, so
+   * that memory for large values can be released again.
+   */
+  std::vector<std::string> overflowBuffers;
+
+  /** For output columns, whether the value is in overflowBuffers.  */
+  std::pmr::vector<my_bool> overflowed;
+
+  /** For floating-point parameters, the value the buffer points to.  */
+  std::pmr::vector<double> doubleParams;
+
+  /** For date and time parameters, the value the buffer points to.  */
+  std::pmr::vector<MYSQL_TIME> timeParams;
+
   /** For output parameters, whether or not they are null.  */
-  std::vector<my_bool> isNull;
+  std::pmr::vector<my_bool> isNull;
+
+  /** For output parameters, whether or not the value has been truncated.  */
+  std::pmr::vector<my_bool> truncated;
+
+  /**
+   * The values of one parameter for all rows of a pending batch execution.
+   * They are stored column-wise, as needed for MariaDB's array binding.
+   */
+  struct BatchParam
+  {
+
+    /**
+     * The buffer type of the parameter, or MYSQL_TYPE_NULL if it has only
+     * been bound to NULL so far.
+     */
+    enum_field_types type = MYSQL_TYPE_NULL;
+
+    /** For integer parameters, whether they are unsigned.  */
+    bool isUnsigned = false;
+
+    /** The values for integer parameters.  */
+    std::vector<long long int> ints;
+
+    /** The values for floating-point parameters.  */
+    std::vector<double> doubles;
+
+    /** The values for date/time parameters.  */
+    std::vector<MYSQL_TIME> times;
+
+    /** The values for string parameters.  */
+    std::vector<std::string> strings;
+
+    /** Pointers to the data of each string, as needed for binding.  */
+    std::vector<char*> buffers;
+
+    /** The lengths of each string.  */
+    std::vector<unsigned long> lengths;
+
+    /** Indicators per row (telling MySQL which values are NULL).  */
+    std::vector<char> indicators;
+
+  };
+
+  /** The parameter values of rows added for a batch execution.  */
+  std::vector<BatchParam> batchParams;
+
+  /** Number of rows added for batch execution.  */
+  unsigned batchRows = 0;
 
   /** The result metadata, if the statement has been queried.  */
   MYSQL_RES* resMeta = nullptr;
 
   /** The result metadata column fields.  */
-  std::vector<const MYSQL_FIELD*> resFields;
+  std::pmr::vector<const MYSQL_FIELD*> resFields;
 
-  /** Map of result column names to their indices.  */
-  std::unordered_map<std::string, unsigned> columnsByName;
+  /** The names of the result columns, in order.  */
+  std::pmr::vector<std::pmr::string> columnNames;
+
+  /**
+   * Map of result column names to their indices.  The keys point into
+   * the strings in columnNames.
+   */
+  std::pmr::unordered_map<std::string_view, unsigned> columnsByName;
+
+  /** Implementations of the async operations on statements.  */
+  class ExecuteOp;
+  class QueryOp;
+  class FetchOp;
+
+  /** The typed layer accesses the buffers directly.  */
+  template <typename T>
+    friend struct internal::TypedValue;
+  template <typename P, typename R>
+    friend class TypedStatement;
+
+  friend class Connection;
+  friend class ResultCache;
 
   /**
    * Initialises the statement.
    */
   void Init ();
 
+  /**
+   * Recreates the statement on its (reconnected) connection handle.  If the
+   * statement was prepared before, it is prepared again with the same SQL
+   * and left in prepared state with all bindings cleared.  If preparing
+   * fails, the statement is left in initialised state and an Error
+   * is thrown.
+   */
+  void Reprepare ();
+
   /**
    * Cleans up the statement.
    */
   void CleanUp ();
 
   /**
-   * Resizes the params vector, and zeros it.
+   * Updates the internal state after the statement has been prepared.
+   */
+  void SetPrepared (unsigned n, const std::string& sql, bool direct);
+
+  /**
+   * Makes sure the params vectors have room for at least the given number
+   * of entries, and zeros all the MYSQL_BIND structs.  The vectors are
+   * never shrunk, so that allocated memory is reused.
    */
   void ResizeParams (size_t num);
 
+  /**
+   * Clears all rows that have been added for batch execution.
+   */
+  void ClearBatch ();
+
+  /**
+   * Binds the given parameter to the string held in stringParams for it,
+   * with the given buffer type.
+   */
+  void BindStringParam (unsigned num, enum_field_types type);
+
+  /**
+   * Binds the given parameter directly to the memory of the passed view,
+   * with the given buffer type.
+   */
+  void BindViewParam (unsigned num, std::string_view val,
+                      enum_field_types type);
+
   /**
    * Returns the index of the named output column.
    */
   unsigned GetIndex (const std::string& col) const;
 
+  /**
+   * Verifies that the given index is valid for the current result set.
+   */
+  void CheckColumn (Column ind) const;
+
+  /**
+   * Appends a serialisation of the prepared SQL and all currently bound
+   * parameter values to the given string, which identifies the query
+   * result for caching.
+   */
+  void AppendCacheKey (std::string& key) const;
+
+  /**
+   * Verifies that the current result set has exactly the given number
+   * of columns.
+   */
+  void CheckNumColumns (size_t num) const;
+
+  /**
+   * Fills in all elements of a tuple from the output columns of the
+   * current result row, in order.
+   */
+  template <typename Tuple, size_t... I>
+    void
+    GetRow (Tuple& row, std::index_sequence<I...>) const
+  {
+    ((std::get<I> (row) = Get<std::tuple_element_t<I, Tuple>> (I)), ...);
+  }
+
+  /**
+   * Verifies the statement is in the right state for executing it, and binds
+   * the input parameters.
+   */
+  void BindForExecute ();
+
+  /**
+   * Sets the cursor-related statement attributes as needed for a query
+   * with the given mode.
+   */
+  void SetCursorAttributes (ResultMode mode);
+
+  /**
+   * Returns the fingerprint of the prepared SQL.
+   */
+  const std::string& GetFingerprint ();
+
+  /**
+   * Reports the accumulated fetch metrics (if any) to the metrics sink,
+   * and clears them.
+   */
+  void RecordFetchMetrics (bool error);
+
+  /**
+   * Finishes the trace of the current query, if any.
+   */
+  void FinishTrace (bool error);
+
+  /**
+   * Executes the statement (as part of Execute or Query), recording
+   * the trace events.
+   */
+  void ExecuteInternal ();
+
+  /**
+   * Returns the total size in bytes of the values in the current row,
+   * for metrics.
+   */
+  uint64_t GetRowBytes () const;
+
+  /**
+   * Sends data for a parameter bound with BindLongData.
+   */
+  void SendLongData (unsigned num, std::string_view data);
+
+  /**
+   * Sets up the result of a query after the statement has been executed
+   * (and the result has been stored, if the mode is BUFFERED).
+   */
+  void SetUpResult (ResultMode mode);
+
+  /**
+   * Processes the return code of mysql_stmt_fetch.  Returns true if a row
+   * has been fetched.
+   */
+  bool ProcessFetch (int res);
+
+  /**
+   * Re-fetches all output columns that have been truncated in the current
+   * row, after growing their buffers to fit the actual values.
+   */
+  void FetchTruncated ();
+
+  /**
+   * Clears the overflow state of all columns before fetching the next row,
+   * releasing overflow buffers that have grown large.
+   */
+  void ClearOverflow ();
+
+  /**
+   * Returns a pointer to the current (not truncated) value of a string
+   * output column, which is either in the inline or the overflow buffer.
+   */
+  const char* GetValueData (Column ind) const;
+
 public:
 
   /**
-   * Initialises the statement for a given database connection.
+   * Initialises the statement for a given database connection.  All memory
+   * for bind structs, result buffers and result metadata is allocated from
+   * the given memory resource, which must outlive the statement.
+   *
+   * Since these buffers are kept and reused when the statement is reset
+   * and queried again, a std::pmr::monotonic_buffer_resource (possibly
+   * with an initial buffer) works well for statements that are executed
+   * repeatedly, while a std::pmr::unsynchronized_pool_resource also
+   * recycles memory if the result shape changes.
    */
-  Statement (MYSQL* h);
+  Statement (MYSQL* h,
+             std::pmr::memory_resource* mem
+                = std::pmr::get_default_resource ());
+
+  /**
+   * Initialises the statement for the given Connection, and registers it
+   * there.  When the connection is re-established with Connection::Reconnect,
+   * the statement is prepared again automatically.
+   */
+  explicit Statement (Connection& c,
+                      std::pmr::memory_resource* mem
+                        = std::pmr::get_default_resource ());
 
   /**
    * Frees the internal MYSQL_STMT handle and cleans up everything.
@@ -146,6 +645,44 @@ public:
    */
   void Prepare (unsigned numParams, const std::string& sql);
 
+  /**
+   * Prepares the statement like Prepare, but without contacting the server
+   * yet.  Instead, the statement is prepared and executed together in
+   * a single round trip when it is first executed or queried (using
+   * mariadb_stmt_execute_direct).  Errors in the SQL string are thus only
+   * reported at that time.  Afterwards, the statement can be reset and
+   * reused like a normally prepared one.  This does not work with the
+   * async methods.
+   */
+  void PrepareDirect (unsigned numParams, const std::string& sql);
+
+  /**
+   * Sets the number of rows fetched at once from the server when a query
+   * is done in CURSOR mode.
+   */
+  void SetPrefetchRows (unsigned long rows);
+
+  /**
+   * Limits the size of the buffers for string output columns.  Values that
+   * are larger are not fetched into memory as a whole, but have to be read
+   * in chunks with ReadColumn instead.  In combination with STREAMING or
+   * CURSOR mode, this bounds the client memory needed for large BLOBs.
+   */
+  void SetOutputBufferLimit (size_t maxBytes);
+
+  /**
+   * Sets a fixed size for the buffers bound for string output columns.
+   * By default, the buffers are sized to fit the largest value of a
+   * buffered result (and grown as needed when streaming), so that a single
+   * large value makes the statement keep a large buffer.  With an inline
+   * size, values up to it are fetched directly, while larger ones are
+   * re-fetched (with mysql_stmt_fetch_column) into a separate overflow
+   * buffer for the current row only.  FetchBatch then fetches large values
+   * directly into the batch's contiguous column data.  This makes memory
+   * use follow the actual values instead of the largest one.
+   */
+  void SetInlineBufferSize (size_t bytes);
+
   /**
    * Resets the statement back to the state after initially being prepared,
    * with all bindings cleared as well.  New parameters can be bound, and then
@@ -164,47 +701,289 @@ public:
   void BindNull (unsigned num);
 
   /**
-   * Binds the given parameter to a type (such as int64_t or std::string).
+   * Binds the given parameter to a type.  Supported are int64_t, uint64_t,
+   * bool, double, float, std::string, MYSQL_TIME, Decimal and
+   * std::chrono::system_clock::time_point (as UTC DATETIME).
    */
   template <typename T>
     void Bind (unsigned num, const T& val);
 
+  /**
+   * Binds the given parameter to a string, taking over its memory instead
+   * of making a copy.
+   */
+  void Bind (unsigned num, std::string&& val);
+
   /**
    * Binds the given parameter to a BLOB.
    */
   void BindBlob (unsigned num, const std::string& val);
 
+  /**
+   * Binds the given parameter to a BLOB, taking over the memory of the
+   * passed string instead of making a copy.
+   */
+  void BindBlob (unsigned num, std::string&& val);
+
+  /**
+   * Binds the given parameter to a string, pointing directly to the memory
+   * of the passed view.  No copy is made, so the caller must make sure
+   * that the memory stays valid and unchanged until the statement has
+   * been executed.
+   */
+  void BindView (unsigned num, std::string_view val);
+
+  /**
+   * Binds the given parameter to a BLOB, pointing directly to the
+   * memory of the passed view.  The same lifetime requirements as
+   * with BindView apply.
+   */
+  void BindBlobView (unsigned num, std::string_view val);
+
+  /**
+   * Writer for streaming the value of a parameter to the server in chunks,
+   * as returned by BindLongData.  The instance must not outlive the
+   * statement, and is only valid until the statement is executed or reset.
+   */
+  class LongDataWriter
+  {
+
+  private:
+
+    /** The statement this is for.  */
+    Statement& stmt;
+
+    /** The parameter being written.  */
+    const unsigned num;
+
+    explicit LongDataWriter (Statement& s, const unsigned n)
+      : stmt(s), num(n)
+    {}
+
+    friend class Statement;
+
+  public:
+
+    /**
+     * Appends the given data to the parameter's value, sending it to the
+     * server right away (so that it does not have to be kept in memory).
+     */
+    void Write (std::string_view data);
+
+  };
+
+  /**
+   * Binds the given parameter to a BLOB, whose value is then sent to the
+   * server in chunks through the returned writer before executing the
+   * statement (with mysql_stmt_send_long_data).  If nothing is written,
+   * the value is empty.  All other parameters must be bound before the first
+   * data is written, since the parameters cannot be bound anymore after
+   * that until the statement has been executed.
+   */
+  LongDataWriter BindLongData (unsigned num);
+
   /**
    * Executes the statement, not expecting a result (e.g. an UPDATE).
    */
   void Execute ();
 
   /**
-   * Executes the statement, expecting a result (i.e. a SELECT).
+   * Adds the currently bound parameters as one row to a batch execution.
+   * Afterwards, all bindings are cleared, and the parameters of the next
+   * row can be bound.  The type of each parameter must be the same for
+   * all rows, except that any value can be NULL.
+   */
+  void AddBatchRow ();
+
+  /**
+   * Executes the statement for all rows that have been added with
+   * AddBatchRow, sending them to the server in a single bulk operation
+   * (using MariaDB's array binding).  Returns the total number of rows
+   * affected by the batch; per-row counts are not reported by the server
+   * for bulk operations.
+   */
+  uint64_t ExecuteBatch ();
+
+  /**
+   * Executes the statement, expecting a result (i.e. a SELECT).  The mode
+   * specifies whether the result set is buffered on the client right away,
+   * or streamed from the server row by row as Fetch is called.
    */
-  void Query ();
+  void Query (ResultMode mode = ResultMode::BUFFERED);
 
   /**
    * Fetches the next result row.  Returns false if no more is available.
    */
   bool Fetch ();
 
+  /**
+   * Starts executing the statement like Execute, but without blocking.
+   * This requires the connection to be in non-blocking mode.
+   */
+  AsyncOperation ExecuteAsync ();
+
+  /**
+   * Starts querying the statement like Query, but without blocking.
+   * This requires the connection to be in non-blocking mode.
+   */
+  AsyncOperation QueryAsync (ResultMode mode = ResultMode::BUFFERED);
+
+  /**
+   * Starts fetching the next row like Fetch, but without blocking.  After
+   * the operation is done, its result indicates whether or not a row has
+   * been fetched.  This requires the connection to be in non-blocking mode.
+   */
+  AsyncOperation FetchAsync ();
+
+  /**
+   * Fetches the next result row, and stores all its column values (in order)
+   * into the given tuple.  The tuple must have exactly as many elements as
+   * there are columns in the result.  Returns false if no more rows are
+   * available (and then leaves the tuple unchanged).
+   *
+   * Elements of type std::string_view point into the statement's buffers,
+   * with the same lifetime restrictions as GetView.
+   */
+  template <typename... Ts>
+    bool
+    FetchInto (std::tuple<Ts...>& row)
+  {
+    if (!Fetch ())
+      return false;
+
+    CheckNumColumns (sizeof... (Ts));
+    GetRow (row, std::index_sequence_for<Ts...> ());
+    return true;
+  }
+
+  /**
+   * Fetches up to maxRows of the remaining result rows at once, and stores
+   * them column-major into the given batch (replacing what it held before).
+   * Returns the number of rows fetched, which is zero once all rows
+   * have been fetched.  Integer columns are stored as INT (or UINT for
+   * BIGINT UNSIGNED), floating-point columns as DOUBLE, date/time columns
+   * as TIME and all other columns (including DECIMAL) as STRING.
+   */
+  size_t FetchBatch (ResultBatch& batch, size_t maxRows);
+
+  /**
+   * Returns a range over the remaining result rows, for use like
+   *
+   *   stmt.Query ();
+   *   for (const auto& row : stmt.Rows ())
+   *     process (row.Get<int64_t> ("id"));
+   */
+  RowRange Rows ();
+
+  /**
+   * Looks up the named output column and returns a handle for it.  The
+   * handle is valid for the current result set, i.e. until the statement
+   * is reset or re-prepared.
+   */
+  Column ResolveColumn (const std::string& col) const;
+
   /**
    * Checks if the given output column of the current result row is null.
    */
-  bool IsNull (const std::string& col) const;
+  bool IsNull (Column ind) const;
+  bool
+  IsNull (const std::string& col) const
+  {
+    return IsNull (GetIndex (col));
+  }
 
   /**
    * Returns the value of the given output column in the current result row.
-   * It must not be null and the type must match.
+   * It must not be null and the type must match.  The supported types are
+   * the same as for Bind, plus std::string_view (like GetView).  Integer
+   * columns can be read as int64_t or uint64_t as long as the value fits.
+   * DATE and DATETIME/TIMESTAMP columns can be read as MYSQL_TIME or
+   * std::chrono::system_clock::time_point (for which they are interpreted
+   * as UTC), and TIME columns only as MYSQL_TIME.
    */
   template <typename T>
-    T Get (const std::string& col) const;
+    T Get (Column ind) const;
+  template <typename T>
+    T
+    Get (const std::string& col) const
+  {
+    return Get<T> (GetIndex (col));
+  }
 
   /**
    * Returns the value of the given output column as BLOB.
    */
-  std::string GetBlob (const std::string& col) const;
+  std::string GetBlob (Column ind) const;
+  std::string
+  GetBlob (const std::string& col) const
+  {
+    return GetBlob (GetIndex (col));
+  }
+
+  /**
+   * Returns true if the value of the given string output column in the
+   * current row has not been fetched in full, because it is larger than
+   * the limit set with SetOutputBufferLimit.  It can then only be read
+   * with ReadColumn.
+   */
+  bool IsTruncated (Column ind) const;
+
+  /**
+   * Returns the full length in bytes of the given string output column's
+   * value in the current row (even if it is truncated).
+   */
+  size_t GetLength (Column ind) const;
+
+  /**
+   * Reads up to len bytes of the given string output column's value in the
+   * current row, starting at the given offset, into out.  Returns the
+   * number of bytes read, which is only less than len if the end of
+   * the value is reached.  This works also for truncated values.
+   */
+  size_t ReadColumn (Column ind, size_t offset, char* out, size_t len);
+  size_t
+  ReadColumn (const std::string& col, const size_t offset,
+              char* out, const size_t len)
+  {
+    return ReadColumn (GetIndex (col), offset, out, len);
+  }
+
+  /**
+   * Returns a view of the given string output column's value in the current
+   * result row, without copying it.  The view points into the statement's
+   * internal buffer, and is only valid until the next call to Fetch, Reset
+   * or Prepare (or until the statement is destructed).  The value must
+   * not be truncated (see IsTruncated).
+   */
+  std::string_view GetView (Column ind) const;
+  std::string_view
+  GetView (const std::string& col) const
+  {
+    return GetView (GetIndex (col));
+  }
+
+  /**
+   * Returns a view of the given output column as BLOB, with the same
+   * lifetime restrictions as GetView.
+   */
+  std::string_view GetBlobView (Column ind) const;
+  std::string_view
+  GetBlobView (const std::string& col) const
+  {
+    return GetBlobView (GetIndex (col));
+  }
+
+  /**
+   * Copies the value of the given string output column into the
+   * provided string.  This allows reusing the memory of that string
+   * across multiple rows, instead of allocating a fresh copy each time.
+   */
+  void GetInto (Column ind, std::string& out) const;
+  void
+  GetInto (const std::string& col, std::string& out) const
+  {
+    GetInto (GetIndex (col), out);
+  }
 
 };
 
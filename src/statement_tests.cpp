@@ -4,34 +4,53 @@
 
 #include "statement.hpp"
 
+#include "error.hpp"
 #include "tempdb.hpp"
+#include "testutils.hpp"
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <new>
 
-namespace mypp
-{
 namespace
 {
 
-/** Environment variable holding the connection URL for the temp db.  */
-constexpr const char* ENV = "MYPP_TEST_TEMPDB";
-
 /**
- * Gets the URL to use for the temp db.
+ * Number of heap allocations made through the global operator new.  This is
+ * used to verify that certain code paths do not allocate.
  */
-std::string
-GetTempDbUrl ()
+std::atomic<size_t> numAllocations(0);
+
+} // anonymous namespace
+
+void*
+operator new (const size_t size)
 {
-  const char* url = std::getenv (ENV);
-  CHECK (url != nullptr)
-      << "Please set the environment variable '" << ENV << "'"
-      << " to a MySQL URL for use in tests";
-  return url;
+  ++numAllocations;
+  void* res = std::malloc (size == 0 ? 1 : size);
+  if (res == nullptr)
+    throw std::bad_alloc ();
+  return res;
 }
 
+void
+operator delete (void* ptr) noexcept
+{
+  std::free (ptr);
+}
+
+namespace mypp
+{
+namespace
+{
+
 class StatementTests : public testing::Test
 {
 
@@ -291,5 +310,973 @@ TEST_F (StatementTests, Unicode)
   EXPECT_FALSE (stmt.Fetch ());
 }
 
+TEST_F (StatementTests, Views)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `name` VARCHAR(64) NOT NULL,
+      `data` BLOB NOT NULL
+    )
+  )");
+
+  const std::string data("x\0\xFFy", 4);
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (2, R"(
+    INSERT INTO `test`
+      (`id`, `name`, `data`) VALUES
+      (1, ?, ?),
+      (2, 'bar', '')
+  )");
+  stmt.Bind<std::string> (0, "foo");
+  stmt.BindBlob (1, data);
+  stmt.Execute ();
+
+  stmt.Prepare (0, R"(
+    SELECT `name`, `data`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query ();
+
+  std::string buf;
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.GetView ("name"), "foo");
+  EXPECT_EQ (stmt.GetBlobView ("data"), data);
+  stmt.GetInto ("data", buf);
+  EXPECT_EQ (buf, data);
+
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.GetView ("name"), "bar");
+  EXPECT_EQ (stmt.GetBlobView ("data"), "");
+  stmt.GetInto ("name", buf);
+  EXPECT_EQ (buf, "bar");
+
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, ColumnIndices)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `name` VARCHAR(64) NULL
+    );
+    INSERT INTO `test`
+      (`id`, `name`) VALUES
+      (1, 'foo'),
+      (2, NULL);
+  )");
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (0, R"(
+    SELECT `name`, `id`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query ();
+
+  const auto id = stmt.ResolveColumn ("id");
+  const auto name = stmt.ResolveColumn ("name");
+  EXPECT_EQ (id, 1);
+  EXPECT_EQ (name, 0);
+
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> (id), 1);
+  EXPECT_FALSE (stmt.IsNull (name));
+  EXPECT_EQ (stmt.Get<std::string> (name), "foo");
+  EXPECT_EQ (stmt.GetView (0), "foo");
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> (id), 2);
+  EXPECT_TRUE (stmt.IsNull (name));
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, FetchInto)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `name` VARCHAR(64) NOT NULL,
+      `flag` BOOL NOT NULL
+    );
+    INSERT INTO `test`
+      (`id`, `name`, `flag`) VALUES
+      (1, 'foo', TRUE),
+      (2, 'bar', FALSE);
+  )");
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (0, R"(
+    SELECT `id`, `name`, `flag`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query ();
+
+  std::tuple<int64_t, std::string_view, bool> row;
+  ASSERT_TRUE (stmt.FetchInto (row));
+  EXPECT_EQ (std::get<0> (row), 1);
+  EXPECT_EQ (std::get<1> (row), "foo");
+  EXPECT_TRUE (std::get<2> (row));
+  ASSERT_TRUE (stmt.FetchInto (row));
+  EXPECT_EQ (std::get<0> (row), 2);
+  EXPECT_EQ (std::get<1> (row), "bar");
+  EXPECT_FALSE (std::get<2> (row));
+  EXPECT_FALSE (stmt.FetchInto (row));
+}
+
+TEST_F (StatementTests, PrepareDirect)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `name` VARCHAR(64) NOT NULL
+    )
+  )");
+
+  Statement stmt(*db.Get ());
+  stmt.PrepareDirect (2, R"(
+    INSERT INTO `test`
+      (`id`, `name`) VALUES (?, ?)
+  )");
+  stmt.Bind<int64_t> (0, 1);
+  stmt.Bind<std::string> (1, "foo");
+  stmt.Execute ();
+
+  /* After the first execution, the statement is prepared normally
+     and can be reused.  */
+  stmt.Reset ();
+  stmt.Bind<int64_t> (0, 2);
+  stmt.Bind<std::string> (1, "bar");
+  stmt.Execute ();
+
+  stmt.PrepareDirect (1, R"(
+    SELECT `name`
+      FROM `test`
+      WHERE `id` = ?
+  )");
+  stmt.Bind<int64_t> (0, 2);
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<std::string> ("name"), "bar");
+  EXPECT_FALSE (stmt.Fetch ());
+
+  stmt.PrepareDirect (0, "INVALID SQL");
+  EXPECT_THROW (stmt.Execute (), Error);
+}
+
+TEST_F (StatementTests, MoveAndViewBinds)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `name` VARCHAR(64) NOT NULL,
+      `data` BLOB NOT NULL
+    )
+  )");
+
+  const std::string data("x\0\xFFy", 4);
+  const std::string name = "bar";
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (2, R"(
+    INSERT INTO `test`
+      (`id`, `name`, `data`) VALUES (1, ?, ?)
+  )");
+  stmt.Bind (0, std::string ("foo"));
+  stmt.BindBlob (1, std::string (data));
+  stmt.Execute ();
+
+  stmt.Prepare (2, R"(
+    INSERT INTO `test`
+      (`id`, `name`, `data`) VALUES (2, ?, ?)
+  )");
+  stmt.BindView (0, name);
+  stmt.BindBlobView (1, std::string_view (data));
+  stmt.Execute ();
+
+  stmt.Prepare (0, R"(
+    SELECT `name`, `data`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<std::string> ("name"), "foo");
+  EXPECT_EQ (stmt.GetBlob ("data"), data);
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<std::string> ("name"), name);
+  EXPECT_EQ (stmt.GetBlob ("data"), data);
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, BatchExecution)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `name` VARCHAR(64) NULL,
+      `data` BLOB NULL
+    )
+  )");
+
+  const std::string data("x\0\xFFy", 4);
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (3, R"(
+    INSERT INTO `test`
+      (`id`, `name`, `data`) VALUES (?, ?, ?)
+  )");
+
+  stmt.Bind<int64_t> (0, 1);
+  stmt.Bind<std::string> (1, "foo");
+  stmt.BindBlob (2, data);
+  stmt.AddBatchRow ();
+
+  stmt.Bind<int64_t> (0, 2);
+  stmt.BindNull (1);
+  stmt.BindNull (2);
+  stmt.AddBatchRow ();
+
+  stmt.Bind<int64_t> (0, 3);
+  stmt.Bind<std::string> (1, "bar");
+  stmt.BindBlob (2, "");
+  stmt.AddBatchRow ();
+
+  EXPECT_EQ (stmt.ExecuteBatch (), 3);
+
+  /* The statement can be used for normal execution again afterwards.  */
+  stmt.Reset ();
+  stmt.Bind<int64_t> (0, 4);
+  stmt.Bind<std::string> (1, "baz");
+  stmt.BindNull (2);
+  stmt.Execute ();
+
+  stmt.Prepare (0, R"(
+    SELECT `id`, `name`, `data`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 1);
+  EXPECT_EQ (stmt.Get<std::string> ("name"), "foo");
+  EXPECT_EQ (stmt.GetBlob ("data"), data);
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 2);
+  EXPECT_TRUE (stmt.IsNull ("name"));
+  EXPECT_TRUE (stmt.IsNull ("data"));
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 3);
+  EXPECT_EQ (stmt.Get<std::string> ("name"), "bar");
+  EXPECT_EQ (stmt.GetBlob ("data"), "");
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 4);
+  EXPECT_EQ (stmt.Get<std::string> ("name"), "baz");
+  EXPECT_TRUE (stmt.IsNull ("data"));
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, NoAllocationsOnReexecute)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `data` BLOB NOT NULL
+    )
+  )");
+
+  const std::string data(1'000, 'x');
+
+  Statement insert(*db.Get ());
+  insert.Prepare (2, R"(
+    INSERT INTO `test`
+      (`id`, `data`) VALUES (?, ?)
+  )");
+  const auto doInsert = [&] (const int64_t id)
+    {
+      insert.Reset ();
+      insert.Bind (0, id);
+      insert.BindBlob (1, data);
+      insert.Execute ();
+    };
+
+  Statement select(*db.Get ());
+  select.Prepare (1, R"(
+    SELECT `id`, `data`
+      FROM `test`
+      WHERE `id` = ?
+  )");
+  const auto doSelect = [&] (const int64_t id)
+    {
+      select.Reset ();
+      select.Bind (0, id);
+      select.Query ();
+      ASSERT_TRUE (select.Fetch ());
+      EXPECT_EQ (select.Get<int64_t> ("id"), id);
+      EXPECT_EQ (select.GetView ("data").size (), data.size ());
+      EXPECT_FALSE (select.Fetch ());
+    };
+
+  /* The first execution sets up the buffers.  */
+  doInsert (1);
+  doSelect (1);
+
+  const size_t before = numAllocations.load ();
+  for (int64_t id = 2; id <= 10; ++id)
+    {
+      doInsert (id);
+      doSelect (id);
+    }
+  EXPECT_EQ (numAllocations.load (), before);
+}
+
+TEST_F (StatementTests, MemoryResource)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `name` VARCHAR(64) NOT NULL,
+      `data` BLOB NOT NULL
+    );
+    INSERT INTO `test`
+      (`id`, `name`, `data`) VALUES
+      (1, 'foo', REPEAT('x', 1000)),
+      (2, 'bar', REPEAT('y', 2000));
+  )");
+
+  /* All per-statement memory has to come from the arena, as the upstream
+     resource refuses to allocate anything.  */
+  alignas (std::max_align_t) char buffer[64 * 1'024];
+  std::pmr::monotonic_buffer_resource arena(
+      buffer, sizeof (buffer), std::pmr::null_memory_resource ());
+
+  Statement stmt(*db.Get (), &arena);
+  for (int64_t id = 1; id <= 2; ++id)
+    {
+      stmt.Prepare (1, R"(
+        SELECT `id`, `name`, `data`
+          FROM `test`
+          WHERE `id` = ?
+      )");
+      stmt.Bind (0, id);
+      stmt.Query ();
+      ASSERT_TRUE (stmt.Fetch ());
+      EXPECT_EQ (stmt.Get<int64_t> ("id"), id);
+      EXPECT_EQ (stmt.GetView ("name"), id == 1 ? "foo" : "bar");
+      EXPECT_EQ (stmt.GetView ("data").size (), 1'000 * id);
+      EXPECT_FALSE (stmt.Fetch ());
+    }
+
+  stmt.Prepare (0, "SELECT `name` AS `other` FROM `test` ORDER BY `id`");
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<std::string> ("other"), "foo");
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<std::string> ("other"), "bar");
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, ExtendedTypes)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `dbl` DOUBLE NULL,
+      `flt` FLOAT NULL,
+      `big` BIGINT UNSIGNED NULL,
+      `dt` DATETIME(6) NULL,
+      `d` DATE NULL,
+      `tm` TIME NULL,
+      `dec` DECIMAL(12, 3) NULL
+    )
+  )");
+
+  using Clock = std::chrono::system_clock;
+  const Clock::time_point when
+      = Clock::time_point (std::chrono::seconds (1'700'000'000))
+          + std::chrono::microseconds (123'456);
+  const Clock::time_point beforeEpoch
+      = Clock::time_point (std::chrono::seconds (-86'401));
+
+  MYSQL_TIME timeOfDay;
+  std::memset (&timeOfDay, 0, sizeof (timeOfDay));
+  timeOfDay.hour = 13;
+  timeOfDay.minute = 5;
+  timeOfDay.second = 59;
+  timeOfDay.time_type = MYSQL_TIMESTAMP_TIME;
+
+  const uint64_t bigValue = std::numeric_limits<uint64_t>::max ();
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (8, R"(
+    INSERT INTO `test`
+      (`id`, `dbl`, `flt`, `big`, `dt`, `d`, `tm`, `dec`)
+      VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+  )");
+  stmt.Bind<int64_t> (0, 1);
+  stmt.Bind (1, -1.25);
+  stmt.Bind (2, 0.5f);
+  stmt.Bind (3, bigValue);
+  stmt.Bind (4, when);
+  stmt.Bind (5, beforeEpoch);
+  stmt.Bind (6, timeOfDay);
+  stmt.Bind (7, Decimal (-12'340, 3));
+  stmt.Execute ();
+
+  stmt.Prepare (0, R"(
+    SELECT `dbl`, `flt`, `big`, `dt`, `d`, `tm`, `dec`,
+           `id`, CAST(`id` AS UNSIGNED) AS `uid`
+      FROM `test`
+  )");
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<double> ("dbl"), -1.25);
+  EXPECT_EQ (stmt.Get<float> ("flt"), 0.5f);
+  EXPECT_EQ (stmt.Get<uint64_t> ("big"), bigValue);
+  EXPECT_EQ (stmt.Get<Clock::time_point> ("dt"), when);
+  EXPECT_EQ (stmt.Get<Clock::time_point> ("d"),
+             Clock::time_point (std::chrono::hours (-48)));
+  const auto tm = stmt.Get<MYSQL_TIME> ("tm");
+  EXPECT_EQ (tm.hour, 13);
+  EXPECT_EQ (tm.minute, 5);
+  EXPECT_EQ (tm.second, 59);
+  EXPECT_EQ (stmt.Get<Decimal> ("dec"), Decimal (-12'340, 3));
+  EXPECT_EQ (stmt.Get<std::string> ("dec"), "-12.340");
+  EXPECT_EQ (stmt.Get<uint64_t> ("id"), 1);
+  EXPECT_EQ (stmt.Get<int64_t> ("uid"), 1);
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, LongData)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `data` LONGBLOB NOT NULL
+    )
+  )");
+
+  constexpr size_t chunkSize = 64 * 1'024;
+  constexpr size_t numChunks = 32;
+  const auto chunkByte = [] (const size_t i)
+    {
+      return static_cast<char> ('a' + i % 26);
+    };
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (2, R"(
+    INSERT INTO `test`
+      (`id`, `data`) VALUES (?, ?)
+  )");
+  stmt.Bind<int64_t> (0, 1);
+  {
+    auto writer = stmt.BindLongData (1);
+    for (size_t i = 0; i < numChunks; ++i)
+      writer.Write (std::string (chunkSize, chunkByte (i)));
+  }
+  stmt.Execute ();
+
+  /* The statement can be reused normally afterwards, and long data
+     that is never written results in an empty value.  */
+  stmt.Reset ();
+  stmt.Bind<int64_t> (0, 2);
+  stmt.BindBlob (1, "small");
+  stmt.Execute ();
+  stmt.Reset ();
+  stmt.Bind<int64_t> (0, 3);
+  stmt.BindLongData (1);
+  stmt.Execute ();
+
+  stmt.Prepare (0, R"(
+    SELECT `id`, `data`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.SetOutputBufferLimit (chunkSize);
+  stmt.Query (Statement::ResultMode::STREAMING);
+
+  ASSERT_TRUE (stmt.Fetch ());
+  const auto col = stmt.ResolveColumn ("data");
+  EXPECT_TRUE (stmt.IsTruncated (col));
+  ASSERT_EQ (stmt.GetLength (col), chunkSize * numChunks);
+  std::string buf(chunkSize, '\0');
+  for (size_t i = 0; i < numChunks; ++i)
+    {
+      ASSERT_EQ (stmt.ReadColumn (col, i * chunkSize, buf.data (), chunkSize),
+                 chunkSize);
+      EXPECT_EQ (buf, std::string (chunkSize, chunkByte (i)));
+    }
+  EXPECT_EQ (stmt.ReadColumn (col, chunkSize * numChunks, buf.data (), 1),
+             0);
+
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_FALSE (stmt.IsTruncated (col));
+  EXPECT_EQ (stmt.GetView (col), "small");
+  EXPECT_EQ (stmt.ReadColumn (col, 1, buf.data (), chunkSize), 4);
+  EXPECT_EQ (buf.substr (0, 4), "mall");
+
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.GetView (col), "");
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, StreamingQuery)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `data` LONGBLOB NULL
+    )
+  )");
+
+  const std::string shortData = "abc";
+  const std::string longData(10'000, 'x');
+  const std::string longerData(50'000, 'y');
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (3, R"(
+    INSERT INTO `test`
+      (`id`, `data`) VALUES
+      (1, ?),
+      (2, ?),
+      (3, NULL),
+      (4, ?),
+      (5, '')
+  )");
+  stmt.BindBlob (0, shortData);
+  stmt.BindBlob (1, longerData);
+  stmt.BindBlob (2, longData);
+  stmt.Execute ();
+
+  stmt.Prepare (0, R"(
+    SELECT `id`, `data`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query (Statement::ResultMode::STREAMING);
+
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 1);
+  EXPECT_EQ (stmt.GetBlob ("data"), shortData);
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 2);
+  EXPECT_EQ (stmt.GetBlob ("data"), longerData);
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 3);
+  EXPECT_TRUE (stmt.IsNull ("data"));
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 4);
+  EXPECT_EQ (stmt.GetBlob ("data"), longData);
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 5);
+  EXPECT_EQ (stmt.GetBlob ("data"), "");
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, ResetStreamingQuery)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY
+    );
+    INSERT INTO `test`
+      (`id`) VALUES (1), (2), (3);
+  )");
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (0, R"(
+    SELECT `id`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query (Statement::ResultMode::STREAMING);
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("id"), 1);
+
+  /* Resetting the statement without fetching all rows must discard the
+     pending result, so that the connection can be used again.  */
+  stmt.Reset ();
+  db.Get ().Execute ("INSERT INTO `test` (`id`) VALUES (4)");
+
+  stmt.Query (Statement::ResultMode::STREAMING);
+  for (int64_t i = 1; i <= 4; ++i)
+    {
+      ASSERT_TRUE (stmt.Fetch ());
+      EXPECT_EQ (stmt.Get<int64_t> ("id"), i);
+    }
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, CursorQuery)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `data` BLOB NULL
+    )
+  )");
+
+  constexpr int64_t numRows = 250;
+  const std::string longData(1'000, 'x');
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (2, R"(
+    INSERT INTO `test`
+      (`id`, `data`) VALUES (?, ?)
+  )");
+  for (int64_t i = 1; i <= numRows; ++i)
+    {
+      stmt.Bind<int64_t> (0, i);
+      stmt.BindBlob (1, i % 2 == 0 ? longData : "abc");
+      stmt.AddBatchRow ();
+    }
+  stmt.ExecuteBatch ();
+
+  stmt.Prepare (0, R"(
+    SELECT `id`, `data`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.SetPrefetchRows (16);
+  stmt.Query (Statement::ResultMode::CURSOR);
+
+  Statement other(*db.Get ());
+  other.Prepare (0, "SELECT COUNT(*) AS `cnt` FROM `test`");
+
+  for (int64_t i = 1; i <= numRows; ++i)
+    {
+      ASSERT_TRUE (stmt.Fetch ());
+      EXPECT_EQ (stmt.Get<int64_t> ("id"), i);
+      EXPECT_EQ (stmt.GetBlob ("data"), i % 2 == 0 ? longData : "abc");
+
+      /* With a cursor, the connection is free in between fetches.  */
+      if (i % 100 == 0)
+        {
+          other.Query ();
+          ASSERT_TRUE (other.Fetch ());
+          EXPECT_EQ (other.Get<int64_t> ("cnt"), numRows);
+          EXPECT_FALSE (other.Fetch ());
+          other.Reset ();
+        }
+    }
+  EXPECT_FALSE (stmt.Fetch ());
+
+  /* Querying again without cursor must work as well.  */
+  stmt.Reset ();
+  stmt.Query ();
+  for (int64_t i = 1; i <= numRows; ++i)
+    {
+      ASSERT_TRUE (stmt.Fetch ());
+      EXPECT_EQ (stmt.Get<int64_t> ("id"), i);
+    }
+  EXPECT_FALSE (stmt.Fetch ());
+}
+
+TEST_F (StatementTests, FetchBatch)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `num` BIGINT NULL,
+      `data` BLOB NULL
+    )
+  )");
+
+  constexpr int64_t numRows = 20;
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (3, R"(
+    INSERT INTO `test`
+      (`id`, `num`, `data`) VALUES (?, ?, ?)
+  )");
+  for (int64_t i = 0; i < numRows; ++i)
+    {
+      stmt.Bind<int64_t> (0, i);
+      if (i % 3 == 0)
+        {
+          stmt.BindNull (1);
+          stmt.BindNull (2);
+        }
+      else
+        {
+          stmt.Bind<int64_t> (1, -i);
+          stmt.BindBlob (2, std::string (i, 'x'));
+        }
+      stmt.AddBatchRow ();
+    }
+  stmt.ExecuteBatch ();
+
+  stmt.Prepare (0, R"(
+    SELECT `id`, `num`, `data`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query ();
+
+  ResultBatch batch;
+  int64_t next = 0;
+  std::vector<size_t> batchSizes;
+  while (stmt.FetchBatch (batch, 8) > 0)
+    {
+      const size_t rows = batch.GetNumRows ();
+      batchSizes.push_back (rows);
+
+      ASSERT_EQ (batch.GetNumColumns (), 3);
+      EXPECT_EQ (batch.GetType (0), ResultBatch::Type::INT);
+      EXPECT_EQ (batch.GetType (1), ResultBatch::Type::INT);
+      EXPECT_EQ (batch.GetType (2), ResultBatch::Type::STRING);
+
+      const int64_t* ids = batch.GetInts (0);
+      const int64_t* nums = batch.GetInts (1);
+      const size_t* offsets = batch.GetOffsets (2);
+      EXPECT_EQ (offsets[0], 0);
+
+      for (size_t r = 0; r < rows; ++r, ++next)
+        {
+          EXPECT_EQ (ids[r], next);
+          EXPECT_FALSE (batch.IsNull (0, r));
+          if (next % 3 == 0)
+            {
+              EXPECT_TRUE (batch.IsNull (1, r));
+              EXPECT_TRUE (batch.IsNull (2, r));
+              EXPECT_EQ (nums[r], 0);
+              EXPECT_EQ (batch.GetView (2, r), "");
+            }
+          else
+            {
+              EXPECT_FALSE (batch.IsNull (1, r));
+              EXPECT_FALSE (batch.IsNull (2, r));
+              EXPECT_EQ (nums[r], -next);
+              EXPECT_EQ (batch.GetView (2, r), std::string (next, 'x'));
+            }
+        }
+    }
+
+  EXPECT_EQ (next, numRows);
+  EXPECT_EQ (batchSizes, std::vector<size_t> ({8, 8, 4}));
+  EXPECT_EQ (batch.GetNumRows (), 0);
+}
+
+TEST_F (StatementTests, FetchBatchTypes)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `small` TINYINT UNSIGNED NULL,
+      `big` BIGINT UNSIGNED NULL,
+      `real` DOUBLE NULL,
+      `dt` DATETIME NULL,
+      `dec` DECIMAL(10, 2) NULL
+    )
+  )");
+
+  using Clock = std::chrono::system_clock;
+  const Clock::time_point base(std::chrono::seconds (1'700'000'000));
+  constexpr uint64_t bigBase = uint64_t (1) << 63;
+  constexpr int numRows = 3;
+
+  /* The values are inserted as batch, which supports the same types.  */
+  Statement stmt(*db.Get ());
+  stmt.Prepare (6, R"(
+    INSERT INTO `test`
+      (`id`, `small`, `big`, `real`, `dt`, `dec`)
+      VALUES (?, ?, ?, ?, ?, ?)
+  )");
+  for (int i = 0; i < numRows; ++i)
+    {
+      stmt.Bind<int64_t> (0, i);
+      if (i == 1)
+        for (unsigned p = 1; p < 6; ++p)
+          stmt.BindNull (p);
+      else
+        {
+          stmt.Bind<uint64_t> (1, 200 + i);
+          stmt.Bind<uint64_t> (2, bigBase + i);
+          stmt.Bind<double> (3, i + 0.5);
+          stmt.Bind<Clock::time_point> (4, base + std::chrono::seconds (i));
+          stmt.Bind<std::string> (5, std::to_string (i) + ".25");
+        }
+      stmt.AddBatchRow ();
+    }
+  stmt.ExecuteBatch ();
+
+  stmt.Prepare (0, R"(
+    SELECT `small`, `big`, `real`, `dt`, `dec`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.Query ();
+
+  ResultBatch batch;
+  ASSERT_EQ (stmt.FetchBatch (batch, numRows), numRows);
+  EXPECT_EQ (batch.GetType (0), ResultBatch::Type::INT);
+  EXPECT_EQ (batch.GetType (1), ResultBatch::Type::UINT);
+  EXPECT_EQ (batch.GetType (2), ResultBatch::Type::DOUBLE);
+  EXPECT_EQ (batch.GetType (3), ResultBatch::Type::TIME);
+  EXPECT_EQ (batch.GetType (4), ResultBatch::Type::STRING);
+
+  for (const int r : {0, 2})
+    {
+      EXPECT_EQ (batch.GetInts (0)[r], 200 + r);
+      EXPECT_EQ (batch.GetUints (1)[r], bigBase + r);
+      EXPECT_EQ (batch.GetDoubles (2)[r], r + 0.5);
+      /* 1'700'000'000 is 2023-11-14 22:13:20 UTC.  */
+      const MYSQL_TIME& t = batch.GetTimes (3)[r];
+      EXPECT_EQ (t.year, 2023);
+      EXPECT_EQ (t.month, 11);
+      EXPECT_EQ (t.day, 14);
+      EXPECT_EQ (t.hour, 22);
+      EXPECT_EQ (t.minute, 13);
+      EXPECT_EQ (t.second, 20 + r);
+      EXPECT_EQ (batch.GetView (4, r), std::to_string (r) + ".25");
+    }
+
+  for (size_t c = 0; c < batch.GetNumColumns (); ++c)
+    EXPECT_TRUE (batch.IsNull (c, 1));
+  EXPECT_EQ (batch.GetUints (1)[1], 0);
+  EXPECT_EQ (batch.GetDoubles (2)[1], 0.0);
+}
+
+TEST_F (StatementTests, InlineBuffers)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY,
+      `data` LONGBLOB NULL
+    )
+  )");
+
+  const std::vector<std::string> values =
+    {
+      "abc",
+      std::string (100'000, 'x'),
+      std::string (64, 'y'),
+      "",
+      std::string (65, 'z'),
+    };
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (2, R"(
+    INSERT INTO `test`
+      (`id`, `data`) VALUES (?, ?)
+  )");
+  for (size_t i = 0; i < values.size (); ++i)
+    {
+      stmt.Bind<int64_t> (0, i);
+      stmt.BindBlob (1, values[i]);
+      stmt.AddBatchRow ();
+    }
+  stmt.ExecuteBatch ();
+
+  stmt.Prepare (0, R"(
+    SELECT `id`, `data`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  stmt.SetInlineBufferSize (64);
+
+  for (const auto mode : {Statement::ResultMode::BUFFERED,
+                          Statement::ResultMode::STREAMING})
+    {
+      stmt.Reset ();
+      stmt.Query (mode);
+
+      const auto col = stmt.ResolveColumn ("data");
+      size_t next = 0;
+      while (stmt.Fetch ())
+        {
+          ASSERT_LT (next, values.size ());
+          EXPECT_FALSE (stmt.IsTruncated (col));
+          EXPECT_EQ (stmt.GetView (col), values[next]);
+
+          if (!values[next].empty ())
+            {
+              char last;
+              ASSERT_EQ (stmt.ReadColumn (col, values[next].size () - 1,
+                                          &last, 1),
+                         1);
+              EXPECT_EQ (last, values[next].back ());
+            }
+
+          ++next;
+        }
+      EXPECT_EQ (next, values.size ());
+
+      /* Large values are fetched straight into batches, even if they
+         exceed the output buffer limit.  */
+      stmt.Reset ();
+      stmt.SetOutputBufferLimit (16);
+      stmt.Query (mode);
+
+      ResultBatch batch;
+      ASSERT_EQ (stmt.FetchBatch (batch, values.size () + 1), values.size ());
+      for (size_t r = 0; r < values.size (); ++r)
+        EXPECT_EQ (batch.GetView (1, r), values[r]);
+
+      /* After a batch that ends on a large value, the statement's current
+         row still has it marked as truncated, and ReadColumn returns
+         the full value.  */
+      stmt.Reset ();
+      stmt.Query (mode);
+      ASSERT_EQ (stmt.FetchBatch (batch, 2), 2);
+      EXPECT_EQ (batch.GetView (1, 1), values[1]);
+      ASSERT_TRUE (stmt.IsTruncated (col));
+      std::string data(stmt.GetLength (col), '\0');
+      ASSERT_EQ (stmt.ReadColumn (col, 0, data.data (), data.size ()),
+                 values[1].size ());
+      EXPECT_EQ (data, values[1]);
+
+      /* A following small value can be read directly again.  */
+      ASSERT_EQ (stmt.FetchBatch (batch, 1), 1);
+      EXPECT_FALSE (stmt.IsTruncated (col));
+      EXPECT_EQ (stmt.GetView (col), values[2]);
+      while (stmt.Fetch ())
+        ;
+
+      stmt.SetOutputBufferLimit (std::numeric_limits<size_t>::max ());
+    }
+}
+
+TEST_F (StatementTests, RowRange)
+{
+  db.Get ().Execute (R"(
+    CREATE TABLE `test` (
+      `id` INT NOT NULL PRIMARY KEY
+    );
+    INSERT INTO `test` (`id`) VALUES (1), (2), (3);
+  )");
+
+  Statement stmt(*db.Get ());
+  stmt.Prepare (1, R"(
+    SELECT `id`
+      FROM `test`
+      WHERE `id` >= ?
+      ORDER BY `id`
+  )");
+
+  for (const auto mode : {Statement::ResultMode::BUFFERED,
+                          Statement::ResultMode::STREAMING})
+    {
+      stmt.Reset ();
+      stmt.Bind<int64_t> (0, 2);
+      stmt.Query (mode);
+
+      std::vector<int64_t> ids;
+      for (const auto& row : stmt.Rows ())
+        ids.push_back (row.Get<int64_t> ("id"));
+      EXPECT_EQ (ids, std::vector<int64_t> ({2, 3}));
+      EXPECT_EQ (stmt.GetState (), Statement::State::FINISHED);
+    }
+
+  stmt.Reset ();
+  stmt.Bind<int64_t> (0, 10);
+  stmt.Query ();
+  auto rows = stmt.Rows ();
+  EXPECT_TRUE (rows.begin () == rows.end ());
+}
+
 } // anonymous namespace
 } // namespace mypp
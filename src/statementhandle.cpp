@@ -0,0 +1,21 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "statementhandle.hpp"
+
+namespace mypp
+{
+
+StatementHandle::StatementHandle (ConnectionPool& p, const std::string& s,
+                                  const unsigned n)
+  : pool(p), sql(s), numParams(n)
+{}
+
+Statement&
+StatementHandle::Get ()
+{
+  return pool.GetThreadConnection ().GetCached (sql, numParams);
+}
+
+} // namespace mypp
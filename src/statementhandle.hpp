@@ -0,0 +1,75 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_STATEMENTHANDLE_HPP
+#define MYPP_STATEMENTHANDLE_HPP
+
+#include "pool.hpp"
+#include "statement.hpp"
+
+#include <string>
+
+namespace mypp
+{
+
+/**
+ * A named query that can be used from many threads at once.  Each thread
+ * calling Get receives its own prepared instance of the statement, on the
+ * connection that the pool has bound to that thread (see
+ * ConnectionPool::GetThreadConnection).  The statement is taken from that
+ * connection's statement cache, so it is prepared once per connection and
+ * then reused.  After the first call from a thread, Get does not take
+ * any lock.
+ *
+ * All handles on the same pool share the thread's connection, so a thread
+ * can use several handles together (e.g. in one transaction).  Since the
+ * statements live in the connection's cache, they may be evicted (and
+ * then prepared again) if a thread uses more handles than the cache
+ * capacity allows.
+ */
+class StatementHandle
+{
+
+private:
+
+  /** The pool providing connections.  */
+  ConnectionPool& pool;
+
+  /** The SQL of the statement.  */
+  const std::string sql;
+
+  /** The number of parameters.  */
+  const unsigned numParams;
+
+public:
+
+  explicit StatementHandle (ConnectionPool& p, const std::string& s,
+                            unsigned n);
+
+  StatementHandle (const StatementHandle&) = delete;
+  void operator= (const StatementHandle&) = delete;
+
+  /**
+   * Returns the calling thread's instance of the statement, prepared and
+   * with all bindings cleared.  The reference may only be used from the
+   * calling thread, and stays valid until the next call to Get for
+   * another handle (which might evict it from the cache) or until the
+   * thread's connection is released.
+   */
+  Statement& Get ();
+
+  /**
+   * Returns the SQL of the statement.
+   */
+  const std::string&
+  GetSql () const
+  {
+    return sql;
+  }
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_STATEMENTHANDLE_HPP
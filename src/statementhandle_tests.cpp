@@ -0,0 +1,122 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "statementhandle.hpp"
+
+#include "pool.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace mypp
+{
+namespace
+{
+
+class StatementHandleTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  StatementHandleTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `test` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `value` INT NOT NULL
+      );
+      INSERT INTO `test` (`id`, `value`)
+        VALUES (1, 10), (2, 20), (3, 30);
+    )");
+  }
+
+  /**
+   * Returns the URL for our temp db with the given options.
+   */
+  static std::string
+  GetUrl (const std::string& opt)
+  {
+    return AddUrlOption (GetTempDbUrl (), opt);
+  }
+
+};
+
+TEST_F (StatementHandleTests, ReusedPerThread)
+{
+  ConnectionPool pool(GetUrl ("pool_max=4"));
+  StatementHandle handle(pool, "SELECT `value` FROM `test` WHERE `id` = ?", 1);
+  StatementHandle other(pool, "SELECT COUNT(*) AS `cnt` FROM `test`", 0);
+
+  Statement& stmt = handle.Get ();
+  EXPECT_EQ (&handle.Get (), &stmt);
+  EXPECT_NE (&other.Get (), &stmt);
+  EXPECT_EQ (pool.GetNumConnections (), 1);
+
+  Statement* fromThread = nullptr;
+  std::thread ([&handle, &fromThread] ()
+    {
+      fromThread = &handle.Get ();
+    }).join ();
+  EXPECT_NE (fromThread, &stmt);
+  EXPECT_EQ (pool.GetNumConnections (), 2);
+
+  stmt.Bind<int64_t> (0, 2);
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  EXPECT_EQ (stmt.Get<int64_t> ("value"), 20);
+  EXPECT_FALSE (stmt.Fetch ());
+
+  /* The cache returns the statement again with bindings cleared.  */
+  Statement& again = handle.Get ();
+  EXPECT_EQ (&again, &stmt);
+  again.Bind<int64_t> (0, 3);
+  again.Query ();
+  ASSERT_TRUE (again.Fetch ());
+  EXPECT_EQ (again.Get<int64_t> ("value"), 30);
+  EXPECT_FALSE (again.Fetch ());
+}
+
+TEST_F (StatementHandleTests, Concurrent)
+{
+  constexpr int numThreads = 8;
+  constexpr int perThread = 100;
+
+  ConnectionPool pool(GetUrl ("pool_max=8"));
+  StatementHandle handle(pool, "SELECT `value` FROM `test` WHERE `id` = ?", 1);
+
+  std::atomic<int> failures(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; ++t)
+    threads.emplace_back ([&handle, &failures, t] ()
+      {
+        for (int i = 0; i < perThread; ++i)
+          {
+            const int id = 1 + (t + i) % 3;
+            auto& stmt = handle.Get ();
+            stmt.Bind<int64_t> (0, id);
+            stmt.Query ();
+            if (!stmt.Fetch () || stmt.Get<int64_t> ("value") != 10 * id)
+              ++failures;
+            while (stmt.Fetch ())
+              ++failures;
+          }
+      });
+  for (auto& t : threads)
+    t.join ();
+
+  EXPECT_EQ (failures, 0);
+  EXPECT_LE (pool.GetNumConnections (), numThreads);
+}
+
+} // anonymous namespace
+} // namespace mypp
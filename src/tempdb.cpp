@@ -27,6 +27,10 @@ TempDb::TempDb (const std::string& url)
 
   CHECK (!parser.HasTable ()) << "Explicit table passed to TempDb";
 
+  ConnectionOptions options;
+  options.ParseUrl (parser);
+  connection.SetOptions (options);
+
   Construct (parser.GetHost (), parser.GetPort (),
              parser.GetUser (), parser.GetPassword (), parser.GetDatabase ());
 }
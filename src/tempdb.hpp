@@ -66,7 +66,8 @@ public:
                    const std::string& db);
 
   /**
-   * Constructs the instance based on a URL.
+   * Constructs the instance based on a URL.  Connection options given
+   * in it (see ConnectionOptions) are applied as well.
    */
   explicit TempDb (const std::string& url);
 
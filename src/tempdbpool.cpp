@@ -0,0 +1,291 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "tempdbpool.hpp"
+
+#include "error.hpp"
+#include "statement.hpp"
+
+#include <glog/logging.h>
+
+#include <utility>
+
+namespace mypp
+{
+
+/* ************************************************************************** */
+
+TempDbPool::Lease::Lease (TempDbPool& p, Database&& d)
+  : pool(&p), db(std::move (d))
+{}
+
+TempDbPool::Lease::Lease (Lease&& o)
+  : pool(o.pool), db(std::move (o.db))
+{
+  o.pool = nullptr;
+}
+
+TempDbPool::Lease&
+TempDbPool::Lease::operator= (Lease&& o)
+{
+  if (this == &o)
+    return *this;
+
+  Return ();
+
+  pool = o.pool;
+  db = std::move (o.db);
+  o.pool = nullptr;
+
+  return *this;
+}
+
+TempDbPool::Lease::~Lease ()
+{
+  Return ();
+}
+
+void
+TempDbPool::Lease::Return ()
+{
+  if (pool == nullptr)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(pool->mut);
+    pool->toDrop.push_back (std::move (db));
+    --pool->numLeased;
+  }
+  pool->cv.notify_all ();
+
+  pool = nullptr;
+}
+
+/* ************************************************************************** */
+
+TempDbPool::TempDbPool (const std::string& u, const SetupFcn& setup,
+                        const size_t numWorkers, const size_t n)
+  : numReady(n)
+{
+  url.Parse (u);
+  CHECK (!url.HasTable ()) << "Explicit table passed to TempDbPool";
+  CHECK_GT (numWorkers, 0u) << "TempDbPool needs at least one worker";
+  CHECK_GT (numReady, 0u) << "TempDbPool needs to keep databases ready";
+
+  options.ParseUrl (url);
+
+  templateName = url.GetDatabase () + "_tpl";
+  templateConnection.SetOptions (options);
+  templateConnection.Connect (url.GetHost (), url.GetPort (),
+                              url.GetUser (), url.GetPassword (), "");
+  templateConnection.Execute ("CREATE DATABASE `" + templateName + "`");
+
+  try
+    {
+      templateConnection.SetDefaultDatabase (templateName);
+      setup (templateConnection);
+
+      /* Tables are created with foreign key checks disabled, so that
+         their order does not matter.  */
+      cloneSql = "SET FOREIGN_KEY_CHECKS = 0;\n";
+
+      std::vector<std::string> tables;
+      Statement stmt(templateConnection);
+      stmt.Prepare (1, R"(
+        SELECT `TABLE_NAME` AS `name`
+          FROM `information_schema`.`TABLES`
+          WHERE `TABLE_SCHEMA` = ? AND `TABLE_TYPE` = 'BASE TABLE'
+          ORDER BY `TABLE_NAME`
+      )");
+      stmt.Bind<std::string> (0, templateName);
+      stmt.Query ();
+      while (stmt.Fetch ())
+        tables.push_back (stmt.Get<std::string> ("name"));
+
+      for (const auto& t : tables)
+        {
+          Statement show(templateConnection);
+          show.Prepare (0, "SHOW CREATE TABLE `" + t + "`");
+          show.Query ();
+          CHECK (show.Fetch ());
+          cloneSql += show.Get<std::string> ("Create Table") + ";\n";
+          CHECK (!show.Fetch ());
+          cloneSql += "INSERT INTO `" + t + "`"
+                        " SELECT * FROM `" + templateName + "`.`" + t + "`;\n";
+        }
+
+      cloneSql += "SET FOREIGN_KEY_CHECKS = 1";
+    }
+  catch (...)
+    {
+      templateConnection.Execute ("DROP DATABASE `" + templateName + "`");
+      throw;
+    }
+
+  pendingClones = numReady;
+  for (size_t i = 0; i < numWorkers; ++i)
+    workers.emplace_back ([this] () { RunWorker (); });
+}
+
+TempDbPool::~TempDbPool ()
+{
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    CHECK_EQ (numLeased, 0)
+        << "TempDbPool destructed while leases are still active";
+    shutdown = true;
+  }
+  cv.notify_all ();
+
+  for (auto& w : workers)
+    w.join ();
+
+  /* The workers have dropped everything returned from leases, but the
+     databases still ready have to be cleaned up.  */
+  for (auto& db : ready)
+    Drop (db);
+
+  try
+    {
+      templateConnection.Execute ("DROP DATABASE `" + templateName + "`");
+    }
+  catch (const Error& exc)
+    {
+      LOG (ERROR) << "Error dropping template database: " << exc.what ();
+    }
+}
+
+std::unique_ptr<Connection>
+TempDbPool::OpenConnection (const std::string& db) const
+{
+  auto res = std::make_unique<Connection> ();
+  res->SetOptions (options);
+  res->Connect (url.GetHost (), url.GetPort (),
+                url.GetUser (), url.GetPassword (), db);
+  return res;
+}
+
+TempDbPool::Database
+TempDbPool::Clone (const std::string& name) const
+{
+  Database res;
+  res.name = name;
+  res.connection = OpenConnection ("");
+
+  res.connection->Execute ("CREATE DATABASE `" + name + "`");
+  try
+    {
+      res.connection->SetDefaultDatabase (name);
+      res.connection->Execute (cloneSql);
+    }
+  catch (...)
+    {
+      Drop (res);
+      throw;
+    }
+
+  return res;
+}
+
+void
+TempDbPool::Drop (Database& db)
+{
+  try
+    {
+      /* The connection may have been left broken by the test.  */
+      if (!db.connection->Ping ())
+        db.connection->Reconnect ();
+      db.connection->Execute ("DROP DATABASE `" + db.name + "`");
+    }
+  catch (const Error& exc)
+    {
+      LOG (ERROR) << "Error dropping temporary database: " << exc.what ();
+    }
+
+  db.connection.reset ();
+}
+
+void
+TempDbPool::RunWorker ()
+{
+  std::unique_lock<std::mutex> lock(mut);
+  while (true)
+    {
+      /* Clones are done first, since tests may be waiting for them.
+         After shutdown, only the remaining drops are processed.  */
+      if (!shutdown && pendingClones > 0)
+        {
+          --pendingClones;
+          const std::string name
+              = url.GetDatabase () + "_" + std::to_string (nextIndex++);
+
+          lock.unlock ();
+          try
+            {
+              Database db = Clone (name);
+              lock.lock ();
+              ready.push_back (std::move (db));
+            }
+          catch (...)
+            {
+              LOG (WARNING) << "Cloning temporary database " << name
+                            << " failed";
+              lock.lock ();
+              cloneErrors.push_back (std::current_exception ());
+            }
+
+          cv.notify_all ();
+          continue;
+        }
+
+      if (!toDrop.empty ())
+        {
+          Database db = std::move (toDrop.front ());
+          toDrop.pop_front ();
+
+          lock.unlock ();
+          Drop (db);
+          lock.lock ();
+          continue;
+        }
+
+      if (shutdown)
+        break;
+
+      cv.wait (lock);
+    }
+}
+
+TempDbPool::Lease
+TempDbPool::Acquire ()
+{
+  std::unique_lock<std::mutex> lock(mut);
+  cv.wait (lock, [this] ()
+    {
+      return !ready.empty () || !cloneErrors.empty ();
+    });
+
+  /* The failed clone's slot is filled again, so that a transient error
+     only fails this call and not all later ones.  */
+  if (ready.empty ())
+    {
+      const auto err = std::move (cloneErrors.front ());
+      cloneErrors.pop_front ();
+      ++pendingClones;
+      lock.unlock ();
+      cv.notify_all ();
+      std::rethrow_exception (err);
+    }
+
+  Database db = std::move (ready.front ());
+  ready.pop_front ();
+  ++numLeased;
+  ++pendingClones;
+  lock.unlock ();
+  cv.notify_all ();
+
+  return Lease (*this, std::move (db));
+}
+
+} // namespace mypp
@@ -0,0 +1,247 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_TEMPDBPOOL_HPP
+#define MYPP_TEMPDBPOOL_HPP
+
+#include "connection.hpp"
+#include "url.hpp"
+
+#include <mysql.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mypp
+{
+
+/**
+ * A provider of temporary databases (like TempDb) for test fleets, which
+ * avoids running the schema setup for every test.  The setup is run only
+ * once on a template database when the pool is constructed.  Worker threads
+ * then clone the template into fresh databases in the background, so that
+ * a number of them are always ready to be handed out.  When a lease is
+ * returned, its database is dropped asynchronously as well.
+ *
+ * Cloning copies all base tables of the template (including their data and
+ * foreign keys), but no views, triggers or routines.
+ *
+ * All database names are derived from the database in the URL, which is
+ * used as prefix.  No database with that prefix should exist yet.
+ */
+class TempDbPool
+{
+
+public:
+
+  /** Function that sets up the schema on the template database.  */
+  using SetupFcn = std::function<void (Connection& conn)>;
+
+private:
+
+  /**
+   * A cloned database, together with a connection that has it set
+   * as default database.
+   */
+  struct Database
+  {
+
+    /** The name of the database.  */
+    std::string name;
+
+    /** The open connection to it.  */
+    std::unique_ptr<Connection> connection;
+
+  };
+
+  /** The parsed URL with the connection settings.  */
+  UrlParser url;
+
+  /** The connection options parsed from the URL.  */
+  ConnectionOptions options;
+
+  /** Connection used for the template database.  */
+  Connection templateConnection;
+
+  /** The name of the template database.  */
+  std::string templateName;
+
+  /**
+   * SQL executed on a freshly created database to replicate the
+   * template's tables and their content.
+   */
+  std::string cloneSql;
+
+  /** Number of ready databases to keep.  */
+  size_t numReady;
+
+  /** Lock for the queues and state below.  */
+  std::mutex mut;
+
+  /** Notified when a database becomes ready or work is queued.  */
+  std::condition_variable cv;
+
+  /** Databases that are ready to be handed out.  */
+  std::deque<Database> ready;
+
+  /** Number of clones that are requested but not yet done.  */
+  size_t pendingClones = 0;
+
+  /** Databases returned by leases, which need to be dropped.  */
+  std::deque<Database> toDrop;
+
+  /** Counter for generating unique database names.  */
+  uint64_t nextIndex = 0;
+
+  /** Number of leases currently active.  */
+  size_t numLeased = 0;
+
+  /** Set when the pool is destructed, to stop the workers.  */
+  bool shutdown = false;
+
+  /**
+   * Errors of failed clones that have not yet been reported.  Each of them
+   * is handed to one Acquire call that finds no ready database.
+   */
+  std::deque<std::exception_ptr> cloneErrors;
+
+  /** The worker threads.  */
+  std::vector<std::thread> workers;
+
+  /**
+   * Opens a new connection to the server, with the given default database
+   * (or none if empty).
+   */
+  std::unique_ptr<Connection> OpenConnection (const std::string& db) const;
+
+  /**
+   * Creates a new database as clone of the template.
+   */
+  Database Clone (const std::string& name) const;
+
+  /**
+   * Drops the given database, logging errors instead of throwing.
+   */
+  static void Drop (Database& db);
+
+  /**
+   * Main loop of the worker threads.
+   */
+  void RunWorker ();
+
+public:
+
+  /**
+   * RAII lease of a temporary database from the pool.  When it goes out
+   * of scope, the database is dropped in the background.
+   */
+  class Lease
+  {
+
+  private:
+
+    /** The pool this belongs to.  */
+    TempDbPool* pool = nullptr;
+
+    /** The database held.  */
+    Database db;
+
+    explicit Lease (TempDbPool& p, Database&& d);
+
+    /**
+     * Hands the database back to the pool for dropping, if there is one.
+     */
+    void Return ();
+
+    friend class TempDbPool;
+
+  public:
+
+    Lease () = default;
+    Lease (Lease&& o);
+    Lease& operator= (Lease&& o);
+
+    Lease (const Lease&) = delete;
+    void operator= (const Lease&) = delete;
+
+    ~Lease ();
+
+    /**
+     * Returns true if this lease holds a database.
+     */
+    explicit
+    operator bool () const
+    {
+      return pool != nullptr;
+    }
+
+    /**
+     * Returns the connection to the database.
+     */
+    Connection&
+    Get ()
+    {
+      return *db.connection;
+    }
+
+    /**
+     * Returns the underlying MYSQL handle.
+     */
+    MYSQL*
+    GetMySql ()
+    {
+      return **db.connection;
+    }
+
+    /**
+     * Returns the name of the database.
+     */
+    const std::string&
+    GetDatabase () const
+    {
+      return db.name;
+    }
+
+  };
+
+  /**
+   * Constructs the pool based on a URL.  This creates the template database
+   * and runs the setup function on it, and then starts the given number of
+   * worker threads, which keep numReady databases ready.  Throws if setting
+   * up the template fails.
+   */
+  explicit TempDbPool (const std::string& url, const SetupFcn& setup,
+                       size_t numWorkers = 4, size_t numReady = 4);
+
+  /**
+   * Stops the workers, and drops all remaining databases including
+   * the template.  All leases must have been returned already.
+   */
+  ~TempDbPool ();
+
+  TempDbPool (const TempDbPool&) = delete;
+  void operator= (const TempDbPool&) = delete;
+
+  /**
+   * Returns a fresh clone of the template database.  This blocks if
+   * none is ready yet.  If cloning has failed in a worker thread, the
+   * error is rethrown here (once for each failed clone), and a new clone
+   * is scheduled in its place so that later calls can succeed again.
+   */
+  Lease Acquire ();
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_TEMPDBPOOL_HPP
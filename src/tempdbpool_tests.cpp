@@ -0,0 +1,196 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "tempdbpool.hpp"
+
+#include "error.hpp"
+#include "statement.hpp"
+#include "testutils.hpp"
+#include "url.hpp"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mypp
+{
+namespace
+{
+
+class TempDbPoolTests : public testing::Test
+{
+
+protected:
+
+  /** Connection to the server for checking which databases exist.  */
+  Connection conn;
+
+  TempDbPoolTests ()
+  {
+    UrlParser url;
+    url.Parse (GetTempDbUrl ());
+    conn.Connect (url.GetHost (), url.GetPort (),
+                  url.GetUser (), url.GetPassword (), "");
+  }
+
+  /**
+   * Sets up the test schema, with a foreign key and some seed data.
+   */
+  static void
+  SetUpSchema (Connection& c)
+  {
+    c.Execute (R"(
+      CREATE TABLE `parent` (
+        `id` INT NOT NULL PRIMARY KEY
+      ) ENGINE=InnoDB;
+      CREATE TABLE `child` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `parent` INT NOT NULL,
+        FOREIGN KEY (`parent`) REFERENCES `parent` (`id`)
+      ) ENGINE=InnoDB;
+      INSERT INTO `parent` (`id`) VALUES (1), (2);
+      INSERT INTO `child` (`id`, `parent`) VALUES (10, 1);
+    )");
+  }
+
+  /**
+   * Returns the number of rows in the given table.
+   */
+  static int64_t
+  CountRows (Connection& c, const std::string& table)
+  {
+    Statement stmt(c);
+    stmt.Prepare (0, "SELECT COUNT(*) AS `cnt` FROM `" + table + "`");
+    stmt.Query ();
+    CHECK (stmt.Fetch ());
+    return stmt.Get<int64_t> ("cnt");
+  }
+
+  /**
+   * Returns true if the given database exists.
+   */
+  bool
+  DatabaseExists (const std::string& name)
+  {
+    Statement stmt(conn);
+    stmt.Prepare (1, R"(
+      SELECT COUNT(*) AS `cnt`
+        FROM `information_schema`.`SCHEMATA`
+        WHERE `SCHEMA_NAME` = ?
+    )");
+    stmt.Bind (0, name);
+    stmt.Query ();
+    CHECK (stmt.Fetch ());
+    return stmt.Get<int64_t> ("cnt") > 0;
+  }
+
+};
+
+TEST_F (TempDbPoolTests, ClonesSchemaAndData)
+{
+  TempDbPool pool(GetTempDbUrl (), &SetUpSchema, 2, 2);
+
+  auto first = pool.Acquire ();
+  auto second = pool.Acquire ();
+  ASSERT_TRUE (first);
+  ASSERT_TRUE (second);
+  EXPECT_NE (first.GetDatabase (), second.GetDatabase ());
+
+  for (auto* lease : {&first, &second})
+    {
+      EXPECT_EQ (CountRows (lease->Get (), "parent"), 2);
+      EXPECT_EQ (CountRows (lease->Get (), "child"), 1);
+    }
+
+  /* The databases are independent, and foreign keys are in place.  */
+  first.Get ().Execute ("DELETE FROM `child`");
+  EXPECT_EQ (CountRows (first.Get (), "child"), 0);
+  EXPECT_EQ (CountRows (second.Get (), "child"), 1);
+  EXPECT_THROW (second.Get ().Execute (R"(
+    INSERT INTO `child` (`id`, `parent`) VALUES (11, 42)
+  )"), Error);
+}
+
+TEST_F (TempDbPoolTests, DropsDatabases)
+{
+  std::set<std::string> names;
+  {
+    TempDbPool pool(GetTempDbUrl (), &SetUpSchema, 2, 1);
+    for (int i = 0; i < 3; ++i)
+      {
+        auto lease = pool.Acquire ();
+        names.insert (lease.GetDatabase ());
+        EXPECT_TRUE (DatabaseExists (lease.GetDatabase ()));
+      }
+  }
+
+  EXPECT_EQ (names.size (), 3);
+  for (const auto& n : names)
+    EXPECT_FALSE (DatabaseExists (n));
+
+  UrlParser url;
+  url.Parse (GetTempDbUrl ());
+  EXPECT_FALSE (DatabaseExists (url.GetDatabase () + "_tpl"));
+}
+
+TEST_F (TempDbPoolTests, ConcurrentLeases)
+{
+  TempDbPool pool(GetTempDbUrl (), &SetUpSchema);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i)
+    threads.emplace_back ([&pool] ()
+      {
+        auto lease = pool.Acquire ();
+        lease.Get ().Execute ("INSERT INTO `parent` (`id`) VALUES (3)");
+        EXPECT_EQ (CountRows (lease.Get (), "parent"), 3);
+      });
+
+  for (auto& t : threads)
+    t.join ();
+}
+
+TEST_F (TempDbPoolTests, CloneErrorIsReportedOnce)
+{
+  UrlParser url;
+  url.Parse (GetTempDbUrl ());
+
+  /* The first clone fails, since a database with its name exists.  */
+  const std::string blocker = url.GetDatabase () + "_0";
+  conn.Execute ("CREATE DATABASE `" + blocker + "`");
+
+  {
+    TempDbPool pool(GetTempDbUrl (), &SetUpSchema, 1, 1);
+    EXPECT_THROW (pool.Acquire (), Error);
+
+    /* Further clones are still made, and later calls succeed.  */
+    for (int i = 0; i < 3; ++i)
+      {
+        auto lease = pool.Acquire ();
+        EXPECT_EQ (CountRows (lease.Get (), "parent"), 2);
+      }
+  }
+
+  conn.Execute ("DROP DATABASE `" + blocker + "`");
+}
+
+TEST_F (TempDbPoolTests, SetupError)
+{
+  UrlParser url;
+  url.Parse (GetTempDbUrl ());
+
+  EXPECT_THROW (TempDbPool (GetTempDbUrl (), [] (Connection& c)
+    {
+      c.Execute ("INVALID SQL");
+    }), Error);
+  EXPECT_FALSE (DatabaseExists (url.GetDatabase () + "_tpl"));
+}
+
+} // anonymous namespace
+} // namespace mypp
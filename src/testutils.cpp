@@ -0,0 +1,40 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "testutils.hpp"
+
+#include <glog/logging.h>
+
+#include <cstdlib>
+
+namespace mypp
+{
+
+namespace
+{
+
+/** Environment variable holding the connection URL for the temp db.  */
+constexpr const char* ENV = "MYPP_TEST_TEMPDB";
+
+} // anonymous namespace
+
+std::string
+GetTempDbUrl ()
+{
+  const char* url = std::getenv (ENV);
+  CHECK (url != nullptr)
+      << "Please set the environment variable '" << ENV << "'"
+      << " to a MySQL URL for use in tests";
+  return url;
+}
+
+std::string
+AddUrlOption (const std::string& url, const std::string& opt)
+{
+  if (url.find ('?') == std::string::npos)
+    return url + "?" + opt;
+  return url + "&" + opt;
+}
+
+} // namespace mypp
@@ -0,0 +1,27 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_TESTUTILS_HPP
+#define MYPP_TESTUTILS_HPP
+
+#include <string>
+
+namespace mypp
+{
+
+/**
+ * Returns the URL to use for temporary databases in tests.  It is read from
+ * the MYPP_TEST_TEMPDB environment variable.
+ */
+std::string GetTempDbUrl ();
+
+/**
+ * Appends the given "key=value" option to a URL, taking into account
+ * whether or not it has options already.
+ */
+std::string AddUrlOption (const std::string& url, const std::string& opt);
+
+} // namespace mypp
+
+#endif // MYPP_TESTUTILS_HPP
@@ -0,0 +1,186 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "tracing.hpp"
+
+#include <glog/logging.h>
+
+#include <functional>
+#include <random>
+#include <thread>
+
+namespace mypp
+{
+
+namespace internal
+{
+std::atomic<TraceSink*> traceSink(nullptr);
+} // namespace internal
+
+void
+SetTraceSink (TraceSink* sink)
+{
+  internal::traceSink.store (sink, std::memory_order_release);
+}
+
+TraceSink::TraceSink (const std::chrono::nanoseconds threshold,
+                      const double rate)
+  : slowThreshold(threshold), sampleRate(rate)
+{
+  CHECK_GE (sampleRate, 0.0);
+  CHECK_LE (sampleRate, 1.0);
+}
+
+const char*
+TraceSink::GetEventName (const EventType type)
+{
+  switch (type)
+    {
+    case EventType::PREPARE:
+      return "prepare";
+    case EventType::BIND:
+      return "bind";
+    case EventType::EXECUTE:
+      return "execute";
+    case EventType::STORE_RESULT:
+      return "store_result";
+    case EventType::FETCH:
+      return "fetch";
+    }
+
+  LOG (FATAL) << "Unknown event type " << static_cast<int> (type);
+}
+
+namespace internal
+{
+
+bool
+SampleTrace (const double rate)
+{
+  if (rate <= 0.0)
+    return false;
+  if (rate >= 1.0)
+    return true;
+
+  thread_local std::minstd_rand rng(
+      std::hash<std::thread::id> () (std::this_thread::get_id ()));
+  return std::uniform_real_distribution<double> (0.0, 1.0) (rng) < rate;
+}
+
+TraceSink::Event*
+QueryTrace::AddEvent (const TraceSink::EventType type,
+                      const Clock::time_point from, const Clock::time_point to)
+{
+  if (numEvents == MAX_EVENTS)
+    {
+      ++droppedEvents;
+      return nullptr;
+    }
+
+  auto& ev = events[numEvents++];
+  ev.type = type;
+  ev.offset = from - start;
+  ev.duration = to - from;
+  ev.rows = 0;
+  ev.bytes = 0;
+
+  return &ev;
+}
+
+void
+QueryTrace::BeginPrepare ()
+{
+  hasPrepare = false;
+  prepareStart = (GetTraceSink () != nullptr
+                    ? Clock::now () : Clock::time_point ());
+}
+
+void
+QueryTrace::EndPrepare ()
+{
+  if (prepareStart == Clock::time_point ())
+    return;
+
+  hasPrepare = true;
+  prepareDuration = Clock::now () - prepareStart;
+}
+
+void
+QueryTrace::Start ()
+{
+  sink = GetTraceSink ();
+  if (sink == nullptr)
+    {
+      hasPrepare = false;
+      prepareStart = Clock::time_point ();
+      return;
+    }
+
+  numEvents = 0;
+  droppedEvents = 0;
+  fetchOpen = false;
+  rows = 0;
+  bytes = 0;
+
+  if (hasPrepare)
+    {
+      start = prepareStart;
+      AddEvent (TraceSink::EventType::PREPARE, prepareStart,
+                prepareStart + prepareDuration);
+      hasPrepare = false;
+    }
+  else
+    start = Clock::now ();
+  prepareStart = Clock::time_point ();
+}
+
+void
+QueryTrace::Record (const TraceSink::EventType type,
+                    const Clock::time_point from)
+{
+  CHECK (sink != nullptr);
+  fetchOpen = false;
+  AddEvent (type, from, Clock::now ());
+}
+
+void
+QueryTrace::RecordFetch (const Clock::time_point from, const bool gotRow,
+                         const uint64_t rowBytes)
+{
+  CHECK (sink != nullptr);
+
+  const auto to = Clock::now ();
+  if (gotRow)
+    {
+      ++rows;
+      bytes += rowBytes;
+    }
+
+  if (fetchOpen)
+    {
+      auto& ev = events[numEvents - 1];
+      ev.duration += to - from;
+      if (gotRow)
+        {
+          ++ev.rows;
+          ev.bytes += rowBytes;
+        }
+      return;
+    }
+
+  auto* ev = AddEvent (TraceSink::EventType::FETCH, from, to);
+  if (ev == nullptr)
+    return;
+
+  fetchOpen = true;
+  if (gotRow)
+    {
+      ev->rows = 1;
+      ev->bytes = rowBytes;
+    }
+}
+
+} // namespace internal
+
+} // namespace mypp
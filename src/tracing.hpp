@@ -0,0 +1,366 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_TRACING_HPP
+#define MYPP_TRACING_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace mypp
+{
+
+/**
+ * Interface for receiving traces of individual statement executions.
+ * In contrast to MetricsSink (which aggregates), this gets the detailed
+ * timeline of single queries, but only for those that are slower than
+ * a threshold or randomly sampled.  The data recorded for each query
+ * is kept in a fixed-size buffer in the Statement, so that queries which
+ * are not emitted cost a few clock reads but no allocations.
+ *
+ * The data of a Span maps directly onto an OpenTelemetry span:  The name
+ * (the SQL fingerprint), start and end time, the events with their
+ * offsets, the counters as attributes and the error flag as status.
+ *
+ * An instance can be installed globally with SetTraceSink.  Just like
+ * for metrics, the hook costs one atomic load per query if no sink
+ * is installed, and is removed completely with MYPP_DISABLE_METRICS.
+ * Emit may be called concurrently from all threads that use mypp.
+ */
+class TraceSink
+{
+
+public:
+
+  /**
+   * The types of events recorded for a query.
+   */
+  enum class EventType
+  {
+    /** Preparing the statement (if it was prepared for this query).  */
+    PREPARE,
+    /** Binding the input parameters.  */
+    BIND,
+    /** Executing the statement on the server.  */
+    EXECUTE,
+    /** Receiving a buffered result set.  */
+    STORE_RESULT,
+    /**
+     * Fetching rows.  There is one event per FetchBatch call, while
+     * consecutive row-by-row Fetch calls are merged into one event.
+     */
+    FETCH,
+  };
+
+  /**
+   * One recorded event (phase) of a traced query.
+   */
+  struct Event
+  {
+
+    /** The type of event.  */
+    EventType type;
+
+    /** Start of the event relative to the start of the span.  */
+    std::chrono::nanoseconds offset;
+
+    /** Duration of the event.  */
+    std::chrono::nanoseconds duration;
+
+    /** For FETCH, the number of rows fetched.  */
+    uint64_t rows;
+
+    /** For FETCH, the number of bytes of values fetched.  */
+    uint64_t bytes;
+
+  };
+
+  /**
+   * Data about one traced query.  The pointers and views are only valid
+   * during the call to Emit.
+   */
+  struct Span
+  {
+
+    /** Fingerprint of the SQL (see FingerprintSql).  */
+    std::string_view name;
+
+    /** Wall-clock time when the query started.  */
+    std::chrono::system_clock::time_point start;
+
+    /** Total duration of the query.  */
+    std::chrono::nanoseconds duration;
+
+    /** The recorded events, in order.  */
+    const Event* events;
+    size_t numEvents;
+
+    /** Number of events that did not fit into the buffer.  */
+    uint64_t droppedEvents;
+
+    /** Total number of rows fetched.  */
+    uint64_t rows;
+
+    /** Total number of bytes of values fetched.  */
+    uint64_t bytes;
+
+    /** Number of warnings reported by the server.  */
+    unsigned warnings;
+
+    /** Whether the query failed with an error.  */
+    bool error;
+
+    /**
+     * True if the span is emitted because it exceeded the slow threshold,
+     * and false if it has been sampled.
+     */
+    bool slow;
+
+  };
+
+private:
+
+  /** Queries taking at least this long are always emitted.  */
+  const std::chrono::nanoseconds slowThreshold;
+
+  /** Fraction of other queries that are emitted.  */
+  const double sampleRate;
+
+public:
+
+  /**
+   * Constructs the sink with the given threshold for slow queries and
+   * the rate (between 0 and 1) at which faster ones are sampled.
+   */
+  explicit TraceSink (std::chrono::nanoseconds threshold, double rate);
+
+  virtual ~TraceSink () = default;
+
+  /**
+   * Returns the name of an event type, for use as OpenTelemetry
+   * event name (e.g. "store_result").
+   */
+  static const char* GetEventName (EventType type);
+
+  std::chrono::nanoseconds
+  GetSlowThreshold () const
+  {
+    return slowThreshold;
+  }
+
+  double
+  GetSampleRate () const
+  {
+    return sampleRate;
+  }
+
+  /**
+   * Receives a span selected for emission.
+   */
+  virtual void Emit (const Span& span) = 0;
+
+};
+
+/**
+ * Installs the given sink for receiving traces, or disables tracing if
+ * null is passed.  The sink must stay alive until it has been uninstalled
+ * and no more calls to it are in progress.
+ */
+void SetTraceSink (TraceSink* sink);
+
+namespace internal
+{
+
+/** The currently installed trace sink (if any).  */
+extern std::atomic<TraceSink*> traceSink;
+
+} // namespace internal
+
+/**
+ * Returns the currently installed trace sink, or null if there is none.
+ */
+inline TraceSink*
+GetTraceSink ()
+{
+#ifdef MYPP_DISABLE_METRICS
+  return nullptr;
+#else
+  return internal::traceSink.load (std::memory_order_acquire);
+#endif
+}
+
+namespace internal
+{
+
+/**
+ * Returns true with the given probability, using a thread-local
+ * random generator.
+ */
+bool SampleTrace (double rate);
+
+/**
+ * The trace data recorded for the current query of a Statement.  It is
+ * active from the start of a query until it is finished, and only if
+ * a sink was installed when it started.
+ */
+class QueryTrace
+{
+
+public:
+
+  using Clock = std::chrono::steady_clock;
+
+  /** Maximum number of events recorded per query.  */
+  static constexpr size_t MAX_EVENTS = 16;
+
+private:
+
+  /** The sink of the current query, null if not active.  */
+  TraceSink* sink = nullptr;
+
+  /** The start time of the query.  */
+  Clock::time_point start;
+
+  /** The recorded events.  */
+  std::array<TraceSink::Event, MAX_EVENTS> events;
+  size_t numEvents = 0;
+  uint64_t droppedEvents = 0;
+
+  /** Set while the last event is a FETCH that Fetch calls add to.  */
+  bool fetchOpen = false;
+
+  /** Total rows and bytes fetched.  */
+  uint64_t rows = 0;
+  uint64_t bytes = 0;
+
+  /** Set if the statement has been prepared since the last query.  */
+  bool hasPrepare = false;
+
+  /** Start time and duration of the last prepare.  */
+  Clock::time_point prepareStart;
+  std::chrono::nanoseconds prepareDuration{0};
+
+  /**
+   * Appends a new event, or returns null if the buffer is full.
+   */
+  TraceSink::Event* AddEvent (TraceSink::EventType type,
+                              Clock::time_point from, Clock::time_point to);
+
+public:
+
+  QueryTrace () = default;
+
+  QueryTrace (const QueryTrace&) = delete;
+  void operator= (const QueryTrace&) = delete;
+
+  /**
+   * Returns true if the current query is traced.
+   */
+  explicit operator bool () const
+  {
+    return sink != nullptr;
+  }
+
+  /**
+   * Returns the current time if tracing is active, and a default value
+   * otherwise (so that no clock is read when not tracing).
+   */
+  Clock::time_point
+  Now () const
+  {
+    return sink != nullptr ? Clock::now () : Clock::time_point ();
+  }
+
+  /**
+   * Starts timing a prepare call, if a sink is installed.
+   */
+  void BeginPrepare ();
+
+  /**
+   * Marks the prepare call as done successfully, so that it becomes part
+   * of the next traced query.
+   */
+  void EndPrepare ();
+
+  /**
+   * Starts tracing a query if a sink is installed.  A previous trace still
+   * active is discarded.
+   */
+  void Start ();
+
+  /**
+   * Records an event that started at the given time and ends now.  Must
+   * only be called if active.
+   */
+  void Record (TraceSink::EventType type, Clock::time_point from);
+
+  /**
+   * Records a Fetch call that started at the given time, merging it into
+   * the current FETCH event if there is one.  Must only be called if active.
+   */
+  void RecordFetch (Clock::time_point from, bool gotRow, uint64_t rowBytes);
+
+  /**
+   * Ends the current FETCH event, so that further Fetch calls start
+   * a new one.
+   */
+  void
+  CloseFetch ()
+  {
+    fetchOpen = false;
+  }
+
+  /**
+   * Finishes the trace if it is active, and emits it if it is slow or
+   * sampled.  The name and warning count are only queried (by calling
+   * the functions) if the span is emitted.
+   */
+  template <typename NameFcn, typename WarningsFcn>
+    void Finish (bool error, const NameFcn& name,
+                 const WarningsFcn& warnings);
+
+};
+
+template <typename NameFcn, typename WarningsFcn>
+  void
+  QueryTrace::Finish (const bool error, const NameFcn& name,
+                      const WarningsFcn& warnings)
+{
+  if (sink == nullptr)
+    return;
+
+  const auto end = Clock::now ();
+  const auto duration = end - start;
+
+  TraceSink::Span span;
+  span.slow = (duration >= sink->GetSlowThreshold ());
+  if (span.slow || SampleTrace (sink->GetSampleRate ()))
+    {
+      span.name = name ();
+      span.start = std::chrono::system_clock::now ()
+          - std::chrono::duration_cast<std::chrono::system_clock::duration> (
+                duration);
+      span.duration = duration;
+      span.events = events.data ();
+      span.numEvents = numEvents;
+      span.droppedEvents = droppedEvents;
+      span.rows = rows;
+      span.bytes = bytes;
+      span.warnings = warnings ();
+      span.error = error;
+      sink->Emit (span);
+    }
+
+  sink = nullptr;
+}
+
+} // namespace internal
+
+} // namespace mypp
+
+#endif // MYPP_TRACING_HPP
@@ -0,0 +1,310 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "tracing.hpp"
+
+#include "error.hpp"
+#include "resultbatch.hpp"
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace mypp
+{
+namespace
+{
+
+using EventType = TraceSink::EventType;
+
+/**
+ * Trace sink that just stores copies of all spans it receives.
+ */
+class RecordingSink : public TraceSink
+{
+
+public:
+
+  /**
+   * Copy of a received span, with owned data.
+   */
+  struct Recorded
+  {
+    std::string name;
+    std::chrono::nanoseconds duration;
+    std::vector<Event> events;
+    uint64_t rows;
+    uint64_t bytes;
+    unsigned warnings;
+    bool error;
+    bool slow;
+
+    /**
+     * Returns the types of all events in order.
+     */
+    std::vector<EventType>
+    GetTypes () const
+    {
+      std::vector<EventType> res;
+      for (const auto& ev : events)
+        res.push_back (ev.type);
+      return res;
+    }
+  };
+
+  std::vector<Recorded> spans;
+
+  explicit RecordingSink (const std::chrono::nanoseconds threshold,
+                          const double rate)
+    : TraceSink(threshold, rate)
+  {}
+
+  void
+  Emit (const Span& span) override
+  {
+    Recorded r;
+    r.name = span.name;
+    r.duration = span.duration;
+    r.events.assign (span.events, span.events + span.numEvents);
+    r.rows = span.rows;
+    r.bytes = span.bytes;
+    r.warnings = span.warnings;
+    r.error = span.error;
+    r.slow = span.slow;
+    spans.push_back (std::move (r));
+  }
+
+};
+
+/** Threshold that no query reaches.  */
+constexpr auto NEVER_SLOW = std::chrono::nanoseconds::max ();
+
+TEST (TraceSinkTests, EventNames)
+{
+  EXPECT_STREQ (TraceSink::GetEventName (EventType::PREPARE), "prepare");
+  EXPECT_STREQ (TraceSink::GetEventName (EventType::STORE_RESULT),
+                "store_result");
+  EXPECT_STREQ (TraceSink::GetEventName (EventType::FETCH), "fetch");
+}
+
+class TracingTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  TracingTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `test` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `name` VARCHAR(64) NOT NULL
+      );
+      INSERT INTO `test` (`id`, `name`)
+        VALUES (1, 'foo'), (2, 'bar'), (3, 'baz');
+    )");
+  }
+
+  ~TracingTests ()
+  {
+    SetTraceSink (nullptr);
+  }
+
+};
+
+TEST_F (TracingTests, NoSink)
+{
+  Statement stmt(db.Get ());
+  stmt.Prepare (0, "SELECT `id` FROM `test`");
+  stmt.Query ();
+  while (stmt.Fetch ())
+    ;
+
+  /* Installing a sink afterwards does not pick up anything from
+     the previous query.  */
+  RecordingSink sink(NEVER_SLOW, 1.0);
+  SetTraceSink (&sink);
+  stmt.Reset ();
+  stmt.Query ();
+  while (stmt.Fetch ())
+    ;
+
+  ASSERT_EQ (sink.spans.size (), 1);
+  EXPECT_EQ (sink.spans[0].GetTypes (),
+             (std::vector<EventType> {EventType::BIND, EventType::EXECUTE,
+                                      EventType::STORE_RESULT,
+                                      EventType::FETCH}));
+}
+
+TEST_F (TracingTests, FullQuery)
+{
+  RecordingSink sink(NEVER_SLOW, 1.0);
+  SetTraceSink (&sink);
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (1, "SELECT `name` FROM `test` WHERE `id` <= ? ORDER BY `id`");
+  stmt.Bind<int64_t> (0, 2);
+  stmt.Query ();
+  while (stmt.Fetch ())
+    ;
+
+  ASSERT_EQ (sink.spans.size (), 1);
+  const auto& span = sink.spans[0];
+  EXPECT_EQ (span.name,
+             "SELECT `name` FROM `test` WHERE `id` <= ? ORDER BY `id`");
+  EXPECT_EQ (span.GetTypes (),
+             (std::vector<EventType> {EventType::PREPARE, EventType::BIND,
+                                      EventType::EXECUTE,
+                                      EventType::STORE_RESULT,
+                                      EventType::FETCH}));
+  EXPECT_EQ (span.rows, 2);
+  EXPECT_EQ (span.bytes, 6);
+  EXPECT_EQ (span.events.back ().rows, 2);
+  EXPECT_FALSE (span.error);
+  EXPECT_FALSE (span.slow);
+
+  /* Events are in order and within the span.  */
+  std::chrono::nanoseconds last(0);
+  for (const auto& ev : span.events)
+    {
+      EXPECT_GE (ev.offset, last);
+      last = ev.offset + ev.duration;
+    }
+  EXPECT_LE (last, span.duration);
+
+  /* A re-execution does not include the prepare.  */
+  stmt.Reset ();
+  stmt.Bind<int64_t> (0, 1);
+  stmt.Query ();
+  ASSERT_TRUE (stmt.Fetch ());
+  stmt.Reset ();
+
+  ASSERT_EQ (sink.spans.size (), 2);
+  EXPECT_EQ (sink.spans[1].events.front ().type, EventType::BIND);
+  EXPECT_EQ (sink.spans[1].rows, 1);
+}
+
+TEST_F (TracingTests, Execute)
+{
+  RecordingSink sink(NEVER_SLOW, 1.0);
+  SetTraceSink (&sink);
+
+  Statement stmt(db.Get ());
+  stmt.PrepareDirect (0, "UPDATE `test` SET `name` = 'x' WHERE `id` = 1");
+  stmt.Execute ();
+
+  ASSERT_EQ (sink.spans.size (), 1);
+  EXPECT_EQ (sink.spans[0].GetTypes (),
+             (std::vector<EventType> {EventType::BIND, EventType::EXECUTE}));
+  EXPECT_FALSE (sink.spans[0].error);
+}
+
+TEST_F (TracingTests, Error)
+{
+  RecordingSink sink(NEVER_SLOW, 1.0);
+  SetTraceSink (&sink);
+
+  Statement stmt(db.Get ());
+  stmt.PrepareDirect (0, "INSERT INTO `test` (`id`, `name`) VALUES (1, 'x')");
+  EXPECT_THROW (stmt.Execute (), Error);
+
+  ASSERT_EQ (sink.spans.size (), 1);
+  EXPECT_TRUE (sink.spans[0].error);
+}
+
+TEST_F (TracingTests, FetchBatches)
+{
+  RecordingSink sink(NEVER_SLOW, 1.0);
+  SetTraceSink (&sink);
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (0, "SELECT `id` FROM `test` ORDER BY `id`");
+  stmt.Query ();
+
+  ResultBatch batch;
+  while (stmt.FetchBatch (batch, 2) > 0)
+    ;
+
+  ASSERT_EQ (sink.spans.size (), 1);
+  const auto& span = sink.spans[0];
+  EXPECT_EQ (span.rows, 3);
+
+  std::vector<uint64_t> batchRows;
+  for (const auto& ev : span.events)
+    if (ev.type == EventType::FETCH)
+      batchRows.push_back (ev.rows);
+  EXPECT_EQ (batchRows, (std::vector<uint64_t> {2, 1}));
+}
+
+TEST_F (TracingTests, Warnings)
+{
+  RecordingSink sink(NEVER_SLOW, 1.0);
+  SetTraceSink (&sink);
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (0, "SELECT CAST('abc' AS SIGNED) AS `val`");
+  stmt.Query ();
+  while (stmt.Fetch ())
+    ;
+
+  ASSERT_EQ (sink.spans.size (), 1);
+  EXPECT_EQ (sink.spans[0].warnings, 1);
+}
+
+TEST_F (TracingTests, SlowThreshold)
+{
+  RecordingSink sink(std::chrono::milliseconds (100), 0.0);
+  SetTraceSink (&sink);
+
+  Statement stmt(db.Get ());
+  stmt.Prepare (0, "SELECT `id` FROM `test`");
+  stmt.Query ();
+  while (stmt.Fetch ())
+    ;
+  EXPECT_EQ (sink.spans.size (), 0);
+
+  stmt.Prepare (0, "SELECT SLEEP(0.2) AS `slept`");
+  stmt.Query ();
+  while (stmt.Fetch ())
+    ;
+
+  ASSERT_EQ (sink.spans.size (), 1);
+  EXPECT_TRUE (sink.spans[0].slow);
+  EXPECT_GE (sink.spans[0].duration, std::chrono::milliseconds (200));
+}
+
+TEST_F (TracingTests, Sampling)
+{
+  RecordingSink sink(NEVER_SLOW, 0.5);
+  SetTraceSink (&sink);
+
+  constexpr unsigned num = 200;
+  Statement stmt(db.Get ());
+  stmt.Prepare (0, "SELECT `id` FROM `test` WHERE `id` = 1");
+  for (unsigned i = 0; i < num; ++i)
+    {
+      stmt.Reset ();
+      stmt.Query ();
+      while (stmt.Fetch ())
+        ;
+    }
+
+  /* With 200 trials, this is essentially certain.  */
+  EXPECT_GT (sink.spans.size (), num / 5);
+  EXPECT_LT (sink.spans.size (), num * 4 / 5);
+  for (const auto& s : sink.spans)
+    EXPECT_FALSE (s.slow);
+}
+
+} // anonymous namespace
+} // namespace mypp
@@ -0,0 +1,196 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "transaction.hpp"
+
+#include "error.hpp"
+
+#include <glog/logging.h>
+
+#include <sstream>
+
+namespace mypp
+{
+
+namespace
+{
+
+/**
+ * Constructs an Error instance from the MySQL-reported error data
+ * of the given connection, with a description of what failed.
+ */
+Error
+TransactionError (MYSQL* h, const std::string& what)
+{
+  std::ostringstream out;
+  out << "Failed to " << what << ": MySQL error " << mysql_errno (h)
+      << " / " << mysql_sqlstate (h);
+
+  return Error (out.str ());
+}
+
+} // anonymous namespace
+
+Transaction::Transaction (Connection& c)
+  : conn(c)
+{
+  CHECK (!conn.inTransaction) << "A transaction is already active";
+
+  if (mysql_autocommit (*conn, 0) != 0)
+    throw TransactionError (*conn, "disable autocommit");
+
+  conn.inTransaction = true;
+  batchStart = std::chrono::steady_clock::now ();
+}
+
+Transaction::~Transaction ()
+{
+  if (!active)
+    return;
+
+  /* We must not throw from the destructor, so any errors during
+     the implicit rollback are only logged.  */
+  if (mysql_rollback (*conn) != 0)
+    LOG (WARNING)
+        << "Rolling back transaction failed: " << mysql_error (*conn);
+  if (mysql_autocommit (*conn, 1) != 0)
+    LOG (WARNING)
+        << "Restoring autocommit failed: " << mysql_error (*conn);
+
+  conn.inTransaction = false;
+}
+
+std::string
+Transaction::GetSavepointName (const unsigned level)
+{
+  return "mypp_savepoint_" + std::to_string (level);
+}
+
+void
+Transaction::Finish ()
+{
+  active = false;
+  conn.inTransaction = false;
+
+  if (mysql_autocommit (*conn, 1) != 0)
+    throw TransactionError (*conn, "restore autocommit");
+}
+
+void
+Transaction::Commit ()
+{
+  CHECK (active) << "Transaction is not active";
+  CHECK_EQ (numSavepoints, 0) << "Savepoints are still open";
+
+  if (mysql_commit (*conn) != 0)
+    throw TransactionError (*conn, "commit");
+
+  Finish ();
+}
+
+void
+Transaction::Rollback ()
+{
+  CHECK (active) << "Transaction is not active";
+  CHECK_EQ (numSavepoints, 0) << "Savepoints are still open";
+
+  if (mysql_rollback (*conn) != 0)
+    throw TransactionError (*conn, "roll back");
+
+  Finish ();
+}
+
+Transaction::Savepoint
+Transaction::CreateSavepoint ()
+{
+  CHECK (active) << "Transaction is not active";
+  return Savepoint (*this);
+}
+
+Transaction::Savepoint::Savepoint (Transaction& t)
+  : tx(t), level(t.numSavepoints + 1)
+{
+  tx.conn.Execute ("SAVEPOINT `" + GetSavepointName (level) + "`");
+  tx.numSavepoints = level;
+}
+
+Transaction::Savepoint::~Savepoint ()
+{
+  if (finished)
+    return;
+
+  try
+    {
+      Rollback ();
+    }
+  catch (const Error& exc)
+    {
+      LOG (WARNING) << "Rolling back to savepoint failed: " << exc.what ();
+    }
+}
+
+void
+Transaction::Savepoint::Release ()
+{
+  CHECK (!finished) << "Savepoint is already finished";
+  CHECK_EQ (tx.numSavepoints, level) << "Savepoints finished out of order";
+
+  finished = true;
+  tx.numSavepoints = level - 1;
+  tx.conn.Execute ("RELEASE SAVEPOINT `" + GetSavepointName (level) + "`");
+}
+
+void
+Transaction::Savepoint::Rollback ()
+{
+  CHECK (!finished) << "Savepoint is already finished";
+  CHECK_EQ (tx.numSavepoints, level) << "Savepoints finished out of order";
+
+  /* Rolling back to a savepoint keeps it in place, so we release it
+     afterwards as well.  */
+  finished = true;
+  tx.numSavepoints = level - 1;
+  const std::string name = GetSavepointName (level);
+  tx.conn.Execute ("ROLLBACK TO SAVEPOINT `" + name + "`");
+  tx.conn.Execute ("RELEASE SAVEPOINT `" + name + "`");
+}
+
+void
+Transaction::SetBatchCommit (const size_t statements,
+                             const std::chrono::milliseconds interval)
+{
+  CHECK (active) << "Transaction is not active";
+  batchStatements = statements;
+  batchInterval = interval;
+}
+
+bool
+Transaction::StatementDone ()
+{
+  CHECK (active) << "Transaction is not active";
+  ++pendingStatements;
+
+  const bool countReached
+      = batchStatements > 0 && pendingStatements >= batchStatements;
+  bool timeReached = false;
+  if (!countReached && batchInterval.count () > 0)
+    timeReached
+        = std::chrono::steady_clock::now () - batchStart >= batchInterval;
+  if (!countReached && !timeReached)
+    return false;
+
+  CHECK_EQ (numSavepoints, 0) << "Cannot commit a batch with open savepoints";
+
+  /* With autocommit disabled, a new transaction starts implicitly
+     after the commit.  */
+  if (mysql_commit (*conn) != 0)
+    throw TransactionError (*conn, "commit batch");
+
+  ++numBatchCommits;
+  pendingStatements = 0;
+  batchStart = std::chrono::steady_clock::now ();
+  return true;
+}
+
+} // namespace mypp
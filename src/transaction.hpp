@@ -0,0 +1,191 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_TRANSACTION_HPP
+#define MYPP_TRANSACTION_HPP
+
+#include "connection.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mypp
+{
+
+/**
+ * RAII helper for a database transaction on a connection.  Autocommit is
+ * turned off while the instance exists, so that all statements executed on
+ * the connection are part of the transaction.  If the instance is destructed
+ * without committing, the transaction is rolled back.
+ *
+ * Optionally, the transaction can be committed automatically in batches
+ * (see SetBatchCommit), which is useful for long-running ingest loops
+ * that do not need atomicity over all their writes.
+ */
+class Transaction
+{
+
+public:
+
+  /**
+   * A savepoint within the transaction.  When it is destructed without
+   * being released, the transaction is rolled back to it (undoing all
+   * changes made after it was created).  Savepoints can be nested, but
+   * must be finished in the reverse order of their creation.
+   */
+  class Savepoint
+  {
+
+  private:
+
+    /** The transaction this belongs to.  */
+    Transaction& tx;
+
+    /** The nesting level of this savepoint (starting at 1).  */
+    const unsigned level;
+
+    /** Set to true once the savepoint has been released or rolled back.  */
+    bool finished = false;
+
+    explicit Savepoint (Transaction& t);
+
+    friend class Transaction;
+
+  public:
+
+    ~Savepoint ();
+
+    Savepoint (const Savepoint&) = delete;
+    void operator= (const Savepoint&) = delete;
+
+    /**
+     * Releases the savepoint, keeping all changes made after it as
+     * part of the enclosing transaction.
+     */
+    void Release ();
+
+    /**
+     * Rolls the transaction back to the savepoint.
+     */
+    void Rollback ();
+
+  };
+
+private:
+
+  /** The connection this is for.  */
+  Connection& conn;
+
+  /** Set while the transaction is in progress.  */
+  bool active = true;
+
+  /** Number of currently open savepoints.  */
+  unsigned numSavepoints = 0;
+
+  /**
+   * Number of statements after which a batch is committed automatically,
+   * zero if not limited by count.
+   */
+  size_t batchStatements = 0;
+
+  /**
+   * Maximum duration of a batch before it is committed automatically,
+   * zero if not limited by time.
+   */
+  std::chrono::milliseconds batchInterval{0};
+
+  /** Number of statements in the current batch.  */
+  size_t pendingStatements = 0;
+
+  /** Start time of the current batch.  */
+  std::chrono::steady_clock::time_point batchStart;
+
+  /** Number of batches committed automatically.  */
+  uint64_t numBatchCommits = 0;
+
+  /**
+   * Returns the name of the savepoint with the given level.
+   */
+  static std::string GetSavepointName (unsigned level);
+
+  /**
+   * Finishes the transaction, restoring autocommit on the connection.
+   */
+  void Finish ();
+
+public:
+
+  /**
+   * Begins a transaction on the given connection.  There must not be
+   * another transaction active on it already (nested transactions have
+   * to use savepoints).
+   */
+  explicit Transaction (Connection& c);
+
+  /**
+   * Rolls back the transaction if it has not been committed.
+   */
+  ~Transaction ();
+
+  Transaction (const Transaction&) = delete;
+  void operator= (const Transaction&) = delete;
+
+  /**
+   * Returns true if the transaction has not yet been committed or
+   * rolled back.
+   */
+  bool
+  IsActive () const
+  {
+    return active;
+  }
+
+  /**
+   * Commits the transaction.
+   */
+  void Commit ();
+
+  /**
+   * Rolls back the transaction explicitly.
+   */
+  void Rollback ();
+
+  /**
+   * Creates a new savepoint.
+   */
+  Savepoint CreateSavepoint ();
+
+  /**
+   * Enables automatic commits in batches, after the given number of
+   * statements (if non-zero) or when the batch has been open for the given
+   * time (if non-zero), whichever happens first.  The statements are counted
+   * by calls to StatementDone.
+   */
+  void SetBatchCommit (size_t statements, std::chrono::milliseconds interval);
+
+  /**
+   * Notes that one more statement has been executed as part of the
+   * transaction.  If batch commits are enabled and the current batch is
+   * full, it is committed and a new one started.  Returns true if a commit
+   * has been done.  There must not be open savepoints when a batch
+   * is committed.
+   */
+  bool StatementDone ();
+
+  /**
+   * Returns the number of batches that have been committed automatically.
+   */
+  uint64_t
+  GetNumBatchCommits () const
+  {
+    return numBatchCommits;
+  }
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_TRANSACTION_HPP
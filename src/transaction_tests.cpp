@@ -0,0 +1,179 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "transaction.hpp"
+
+#include "statement.hpp"
+#include "tempdb.hpp"
+#include "testutils.hpp"
+#include "url.hpp"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace mypp
+{
+namespace
+{
+
+class TransactionTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  /**
+   * A second connection to the database, which is used to check what
+   * changes are visible outside of the transaction.
+   */
+  Connection other;
+
+  TransactionTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `test` (
+        `id` INT NOT NULL PRIMARY KEY
+      ) ENGINE=InnoDB
+    )");
+
+    UrlParser url;
+    url.Parse (GetTempDbUrl ());
+    other.Connect (url.GetHost (), url.GetPort (),
+                   url.GetUser (), url.GetPassword (), url.GetDatabase ());
+  }
+
+  void
+  Insert (const int64_t id)
+  {
+    auto& stmt = db.Get ().GetCached (R"(
+      INSERT INTO `test` (`id`) VALUES (?)
+    )", 1);
+    stmt.Bind (0, id);
+    stmt.Execute ();
+  }
+
+  /**
+   * Returns the number of rows in the test table, as seen by the
+   * given connection.
+   */
+  static int64_t
+  CountRows (Connection& conn)
+  {
+    Statement stmt(*conn);
+    stmt.Prepare (0, "SELECT COUNT(*) AS `cnt` FROM `test`");
+    stmt.Query ();
+    CHECK (stmt.Fetch ());
+    return stmt.Get<int64_t> ("cnt");
+  }
+
+};
+
+TEST_F (TransactionTests, Commit)
+{
+  Transaction tx(db.Get ());
+  Insert (1);
+  Insert (2);
+  EXPECT_EQ (CountRows (db.Get ()), 2);
+  EXPECT_EQ (CountRows (other), 0);
+
+  tx.Commit ();
+  EXPECT_FALSE (tx.IsActive ());
+  EXPECT_EQ (CountRows (other), 2);
+
+  /* Autocommit is restored afterwards.  */
+  Insert (3);
+  EXPECT_EQ (CountRows (other), 3);
+}
+
+TEST_F (TransactionTests, RollbackOnDestruction)
+{
+  {
+    Transaction tx(db.Get ());
+    Insert (1);
+    EXPECT_EQ (CountRows (db.Get ()), 1);
+  }
+  EXPECT_EQ (CountRows (db.Get ()), 0);
+
+  {
+    Transaction tx(db.Get ());
+    Insert (1);
+    tx.Rollback ();
+  }
+  EXPECT_EQ (CountRows (db.Get ()), 0);
+
+  /* A new transaction can be started after the previous one is done.  */
+  Transaction tx(db.Get ());
+  Insert (2);
+  tx.Commit ();
+  EXPECT_EQ (CountRows (other), 1);
+}
+
+TEST_F (TransactionTests, Savepoints)
+{
+  Transaction tx(db.Get ());
+  Insert (1);
+
+  {
+    auto sp = tx.CreateSavepoint ();
+    Insert (2);
+    {
+      auto inner = tx.CreateSavepoint ();
+      Insert (3);
+    }
+    EXPECT_EQ (CountRows (db.Get ()), 2);
+    sp.Release ();
+  }
+  EXPECT_EQ (CountRows (db.Get ()), 2);
+
+  {
+    auto sp = tx.CreateSavepoint ();
+    Insert (4);
+    sp.Rollback ();
+  }
+  EXPECT_EQ (CountRows (db.Get ()), 2);
+
+  tx.Commit ();
+  EXPECT_EQ (CountRows (other), 2);
+}
+
+TEST_F (TransactionTests, BatchCommitByCount)
+{
+  Transaction tx(db.Get ());
+  tx.SetBatchCommit (3, std::chrono::milliseconds (0));
+
+  for (int64_t id = 1; id <= 7; ++id)
+    {
+      Insert (id);
+      EXPECT_EQ (tx.StatementDone (), id % 3 == 0);
+    }
+  EXPECT_EQ (tx.GetNumBatchCommits (), 2);
+  EXPECT_EQ (CountRows (other), 6);
+
+  tx.Commit ();
+  EXPECT_EQ (CountRows (other), 7);
+}
+
+TEST_F (TransactionTests, BatchCommitByTime)
+{
+  Transaction tx(db.Get ());
+  tx.SetBatchCommit (0, std::chrono::milliseconds (10));
+
+  Insert (1);
+  EXPECT_FALSE (tx.StatementDone ());
+  EXPECT_EQ (CountRows (other), 0);
+
+  std::this_thread::sleep_for (std::chrono::milliseconds (20));
+  Insert (2);
+  EXPECT_TRUE (tx.StatementDone ());
+  EXPECT_EQ (CountRows (other), 2);
+}
+
+} // anonymous namespace
+} // namespace mypp
@@ -0,0 +1,442 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MYPP_TYPED_HPP
+#define MYPP_TYPED_HPP
+
+#include "statement.hpp"
+
+#include <mysql.h>
+
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace mypp
+{
+
+/**
+ * The list of parameter types of a TypedStatement.
+ */
+template <typename... Ts>
+  struct Params
+{};
+
+/**
+ * The list of result column types of a TypedStatement.
+ */
+template <typename... Ts>
+  struct Row
+{};
+
+namespace internal
+{
+
+/**
+ * Binding and fetching of values of a particular type for TypedStatement.
+ * Matches returns whether a result column (as bound by the statement) can
+ * be read as the type, and is used to validate the result once.  Get and
+ * Bind then access the statement's buffers directly, without checking the
+ * state, index or type each time.
+ *
+ * The generic version just falls back to Statement's own Bind and Get,
+ * which do their checks at runtime.
+ */
+template <typename T>
+  struct TypedValue
+{
+
+  static bool
+  Matches (const MYSQL_BIND&)
+  {
+    return true;
+  }
+
+  static T
+  Get (const Statement& s, const Statement::Column ind)
+  {
+    return s.Get<T> (ind);
+  }
+
+  static void
+  Bind (Statement& s, const unsigned num, const T& val)
+  {
+    s.Bind<T> (num, val);
+  }
+
+};
+
+template <>
+  struct TypedValue<int64_t>
+{
+
+  static bool
+  Matches (const MYSQL_BIND& bnd)
+  {
+    return bnd.buffer_type == MYSQL_TYPE_LONGLONG && !bnd.is_unsigned;
+  }
+
+  static int64_t
+  Get (const Statement& s, const Statement::Column ind)
+  {
+    CHECK (!s.isNull[ind]) << "Column '" << s.resFields[ind]->name
+                           << "' is null";
+    return s.intParams[ind];
+  }
+
+  static void
+  Bind (Statement& s, const unsigned num, const int64_t val)
+  {
+    auto& bnd = s.params[num];
+    s.intParams[num] = val;
+    bnd.buffer_type = MYSQL_TYPE_LONGLONG;
+    bnd.buffer = &s.intParams[num];
+    bnd.is_unsigned = 0;
+  }
+
+};
+
+template <>
+  struct TypedValue<uint64_t>
+{
+
+  static bool
+  Matches (const MYSQL_BIND& bnd)
+  {
+    return bnd.buffer_type == MYSQL_TYPE_LONGLONG && bnd.is_unsigned;
+  }
+
+  static uint64_t
+  Get (const Statement& s, const Statement::Column ind)
+  {
+    CHECK (!s.isNull[ind]) << "Column '" << s.resFields[ind]->name
+                           << "' is null";
+    return static_cast<uint64_t> (s.intParams[ind]);
+  }
+
+  static void
+  Bind (Statement& s, const unsigned num, const uint64_t val)
+  {
+    s.Bind<uint64_t> (num, val);
+  }
+
+};
+
+template <>
+  struct TypedValue<bool>
+{
+
+  static bool
+  Matches (const MYSQL_BIND& bnd)
+  {
+    return bnd.buffer_type == MYSQL_TYPE_LONGLONG;
+  }
+
+  static bool
+  Get (const Statement& s, const Statement::Column ind)
+  {
+    CHECK (!s.isNull[ind]) << "Column '" << s.resFields[ind]->name
+                           << "' is null";
+    return s.intParams[ind] != 0;
+  }
+
+  static void
+  Bind (Statement& s, const unsigned num, const bool val)
+  {
+    TypedValue<int64_t>::Bind (s, num, val);
+  }
+
+};
+
+template <>
+  struct TypedValue<double>
+{
+
+  static bool
+  Matches (const MYSQL_BIND& bnd)
+  {
+    return bnd.buffer_type == MYSQL_TYPE_DOUBLE;
+  }
+
+  static double
+  Get (const Statement& s, const Statement::Column ind)
+  {
+    CHECK (!s.isNull[ind]) << "Column '" << s.resFields[ind]->name
+                           << "' is null";
+    return s.doubleParams[ind];
+  }
+
+  static void
+  Bind (Statement& s, const unsigned num, const double val)
+  {
+    auto& bnd = s.params[num];
+    s.doubleParams[num] = val;
+    bnd.buffer_type = MYSQL_TYPE_DOUBLE;
+    bnd.buffer = &s.doubleParams[num];
+  }
+
+};
+
+/**
+ * String views can be used both as parameters (bound without copying, which
+ * is safe since TypedStatement executes right away) and result columns
+ * (with the lifetime restrictions of Statement::GetView).
+ */
+template <>
+  struct TypedValue<std::string_view>
+{
+
+  static bool
+  Matches (const MYSQL_BIND& bnd)
+  {
+    return bnd.buffer_type == MYSQL_TYPE_LONG_BLOB;
+  }
+
+  static std::string_view
+  Get (const Statement& s, const Statement::Column ind)
+  {
+    CHECK (!s.isNull[ind]) << "Column '" << s.resFields[ind]->name
+                           << "' is null";
+    /* Large values may be held in an overflow buffer, or not fetched at
+       all if they exceed the output buffer limit.  */
+    CHECK (!s.truncated[ind]) << "Column '" << s.resFields[ind]->name
+                              << "' is truncated, use ReadColumn";
+    return std::string_view (s.GetValueData (ind), *s.params[ind].length);
+  }
+
+  static void
+  Bind (Statement& s, const unsigned num, const std::string_view val)
+  {
+    s.BindViewParam (num, val, MYSQL_TYPE_STRING);
+  }
+
+};
+
+template <>
+  struct TypedValue<std::string>
+{
+
+  static bool
+  Matches (const MYSQL_BIND& bnd)
+  {
+    return TypedValue<std::string_view>::Matches (bnd);
+  }
+
+  static std::string
+  Get (const Statement& s, const Statement::Column ind)
+  {
+    return std::string (TypedValue<std::string_view>::Get (s, ind));
+  }
+
+  static void
+  Bind (Statement& s, const unsigned num, const std::string& val)
+  {
+    TypedValue<std::string_view>::Bind (s, num, val);
+  }
+
+};
+
+/**
+ * Optional values correspond to nullable parameters and columns.
+ */
+template <typename T>
+  struct TypedValue<std::optional<T>>
+{
+
+  static bool
+  Matches (const MYSQL_BIND& bnd)
+  {
+    return TypedValue<T>::Matches (bnd);
+  }
+
+  static std::optional<T>
+  Get (const Statement& s, const Statement::Column ind)
+  {
+    if (s.isNull[ind])
+      return std::nullopt;
+    return TypedValue<T>::Get (s, ind);
+  }
+
+  static void
+  Bind (Statement& s, const unsigned num, const std::optional<T>& val)
+  {
+    if (val.has_value ())
+      TypedValue<T>::Bind (s, num, *val);
+    else
+      s.params[num].buffer_type = MYSQL_TYPE_NULL;
+  }
+
+};
+
+} // namespace internal
+
+template <typename P, typename R = Row<>>
+  class TypedStatement;
+
+/**
+ * A prepared statement whose parameter and result column types are fixed
+ * at compile time, e.g.
+ *
+ *   TypedStatement<Params<int64_t>, Row<int64_t, std::string>> stmt(
+ *       *conn, "SELECT `id`, `name` FROM `test` WHERE `id` > ?");
+ *   stmt.Query (10);
+ *   std::tuple<int64_t, std::string> row;
+ *   while (stmt.Fetch (row))
+ *     ...
+ *
+ * The parameter count is verified against the server when preparing, and
+ * the result columns against the result metadata on the first query.  After
+ * that, values are bound and fetched directly without further checks on
+ * their types and indices (only NULL values are still detected for columns
+ * that are not std::optional).
+ */
+template <typename... Ps, typename... Rs>
+  class TypedStatement<Params<Ps...>, Row<Rs...>>
+{
+
+public:
+
+  /** The tuple type holding a result row.  */
+  using RowType = std::tuple<Rs...>;
+
+private:
+
+  /** The underlying statement.  */
+  Statement stmt;
+
+  /** How results of queries are transferred.  */
+  Statement::ResultMode mode = Statement::ResultMode::BUFFERED;
+
+  /** Whether the result columns have been validated already.  */
+  bool validated = false;
+
+  /**
+   * Resets the statement if needed and binds all parameters.
+   */
+  template <size_t... I>
+    void
+    BindAll (std::index_sequence<I...>, const Ps&... args)
+  {
+    if (stmt.GetState () != Statement::State::PREPARED)
+      stmt.Reset ();
+    (internal::TypedValue<Ps>::Bind (stmt, I, args), ...);
+  }
+
+  /**
+   * Verifies that the given result column can be read as type T.
+   */
+  template <typename T>
+    void
+    ValidateColumn (const Statement::Column ind) const
+  {
+    CHECK (internal::TypedValue<T>::Matches (stmt.params[ind]))
+        << "Type of column '" << stmt.resFields[ind]->name
+        << "' does not match the row type";
+  }
+
+  /**
+   * Verifies the result columns against the row type, if not yet done.
+   */
+  template <size_t... I>
+    void
+    ValidateResult (std::index_sequence<I...>)
+  {
+    if (validated)
+      return;
+
+    stmt.CheckNumColumns (sizeof... (Rs));
+    (ValidateColumn<Rs> (I), ...);
+    validated = true;
+  }
+
+  template <size_t... I>
+    void
+    GetAll (RowType& row, std::index_sequence<I...>) const
+  {
+    ((std::get<I> (row) = internal::TypedValue<Rs>::Get (stmt, I)), ...);
+  }
+
+public:
+
+  /**
+   * Prepares the statement with the given SQL on a connection.
+   */
+  TypedStatement (MYSQL* h, const std::string& sql)
+    : stmt(h)
+  {
+    stmt.Prepare (sizeof... (Ps), sql);
+    CHECK_EQ (mysql_stmt_param_count (*stmt), sizeof... (Ps))
+        << "Parameter count does not match for:\n" << sql;
+  }
+
+  TypedStatement (const TypedStatement&) = delete;
+  void operator= (const TypedStatement&) = delete;
+
+  /**
+   * Sets the result mode used for subsequent calls to Query.
+   */
+  void
+  SetResultMode (const Statement::ResultMode m)
+  {
+    mode = m;
+  }
+
+  /**
+   * Binds the given parameters and executes the statement, which must
+   * not return a result.
+   */
+  void
+  Execute (const Ps&... args)
+  {
+    BindAll (std::index_sequence_for<Ps...> (), args...);
+    stmt.Execute ();
+  }
+
+  /**
+   * Binds the given parameters and queries the statement.  The rows
+   * can then be retrieved with Fetch.
+   */
+  void
+  Query (const Ps&... args)
+  {
+    BindAll (std::index_sequence_for<Ps...> (), args...);
+    stmt.Query (mode);
+    ValidateResult (std::index_sequence_for<Rs...> ());
+  }
+
+  /**
+   * Fetches the next result row into the given tuple.  Returns false if
+   * there are no more rows (and leaves the tuple unchanged then).
+   */
+  bool
+  Fetch (RowType& row)
+  {
+    if (!stmt.Fetch ())
+      return false;
+
+    GetAll (row, std::index_sequence_for<Rs...> ());
+    return true;
+  }
+
+  /**
+   * Gives access to the underlying statement, e.g. for reading the
+   * values of a result row by name.
+   */
+  Statement&
+  GetStatement ()
+  {
+    return stmt;
+  }
+
+};
+
+} // namespace mypp
+
+#endif // MYPP_TYPED_HPP
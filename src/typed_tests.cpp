@@ -0,0 +1,149 @@
+// Copyright (C) 2024 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "typed.hpp"
+
+#include "tempdb.hpp"
+#include "testutils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+namespace mypp
+{
+namespace
+{
+
+class TypedStatementTests : public testing::Test
+{
+
+protected:
+
+  TempDb db;
+
+  TypedStatementTests ()
+    : db(GetTempDbUrl ())
+  {
+    db.Initialise ();
+    db.Get ().Execute (R"(
+      CREATE TABLE `test` (
+        `id` INT NOT NULL PRIMARY KEY,
+        `name` VARCHAR(64) NULL,
+        `score` DOUBLE NULL
+      )
+    )");
+  }
+
+};
+
+TEST_F (TypedStatementTests, InsertAndQuery)
+{
+  using Insert = TypedStatement<Params<int64_t, std::string_view,
+                                       std::optional<double>>>;
+  Insert insert(*db.Get (), R"(
+    INSERT INTO `test`
+      (`id`, `name`, `score`) VALUES (?, ?, ?)
+  )");
+  insert.Execute (1, "foo", 1.5);
+  insert.Execute (2, "bar", std::nullopt);
+  insert.Execute (3, "baz", -2.0);
+
+  using Select = TypedStatement<Params<int64_t>,
+                                Row<int64_t, std::string,
+                                    std::optional<double>>>;
+  Select select(*db.Get (), R"(
+    SELECT `id`, `name`, `score`
+      FROM `test`
+      WHERE `id` >= ?
+      ORDER BY `id`
+  )");
+
+  Select::RowType row;
+  select.Query (2);
+  ASSERT_TRUE (select.Fetch (row));
+  EXPECT_EQ (row, std::make_tuple (2, "bar", std::nullopt));
+  ASSERT_TRUE (select.Fetch (row));
+  EXPECT_EQ (row, std::make_tuple (3, "baz", -2.0));
+  EXPECT_FALSE (select.Fetch (row));
+
+  /* The statement can be queried again right away.  */
+  select.Query (1);
+  ASSERT_TRUE (select.Fetch (row));
+  EXPECT_EQ (std::get<0> (row), 1);
+  EXPECT_EQ (std::get<1> (row), "foo");
+  EXPECT_EQ (std::get<2> (row), 1.5);
+  EXPECT_EQ (select.GetStatement ().Get<int64_t> ("id"), 1);
+}
+
+TEST_F (TypedStatementTests, StreamingViews)
+{
+  TypedStatement<Params<int64_t, std::string>> insert(*db.Get (), R"(
+    INSERT INTO `test`
+      (`id`, `name`) VALUES (?, ?)
+  )");
+  for (int64_t i = 1; i <= 10; ++i)
+    insert.Execute (i, std::string (i, 'x'));
+
+  TypedStatement<Params<>, Row<std::string_view>> select(*db.Get (), R"(
+    SELECT `name`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  select.SetResultMode (Statement::ResultMode::STREAMING);
+  select.Query ();
+
+  std::tuple<std::string_view> row;
+  size_t len = 0;
+  while (select.Fetch (row))
+    {
+      ++len;
+      EXPECT_EQ (std::get<0> (row), std::string (len, 'x'));
+    }
+  EXPECT_EQ (len, 10);
+}
+
+TEST_F (TypedStatementTests, InlineBufferLimit)
+{
+  TypedStatement<Params<int64_t, std::string>> insert(*db.Get (), R"(
+    INSERT INTO `test`
+      (`id`, `name`) VALUES (?, ?)
+  )");
+  insert.Execute (1, "short");
+  insert.Execute (2, std::string (64, 'x'));
+  insert.Execute (3, "abc");
+
+  /* Values larger than the inline buffer are fetched into an overflow
+     buffer, and the typed accessors read them from there.  */
+  TypedStatement<Params<>, Row<int64_t, std::string_view>> select(
+      *db.Get (), R"(
+    SELECT `id`, `name`
+      FROM `test`
+      ORDER BY `id`
+  )");
+  select.GetStatement ().SetInlineBufferSize (8);
+
+  for (const auto mode : {Statement::ResultMode::BUFFERED,
+                          Statement::ResultMode::STREAMING})
+    {
+      select.SetResultMode (mode);
+      select.Query ();
+
+      std::tuple<int64_t, std::string_view> row;
+      ASSERT_TRUE (select.Fetch (row));
+      EXPECT_EQ (std::get<1> (row), "short");
+      ASSERT_TRUE (select.Fetch (row));
+      EXPECT_EQ (std::get<1> (row), std::string (64, 'x'));
+      ASSERT_TRUE (select.Fetch (row));
+      EXPECT_EQ (std::get<1> (row), "abc");
+      EXPECT_FALSE (select.Fetch (row));
+    }
+}
+
+} // anonymous namespace
+} // namespace mypp
@@ -155,4 +155,23 @@ UrlParser::Parse (const std::string& url)
     throw Error ("Invalid options in URL");
 }
 
+bool
+UrlParser::GetUnsignedOption (const std::string& name,
+                              unsigned long long& value) const
+{
+  const auto mit = options.find (name);
+  if (mit == options.end ())
+    return false;
+
+  std::istringstream input(mit->second);
+  input >> value;
+
+  std::ostringstream output;
+  output << value;
+  if (!input || output.str () != mit->second)
+    throw Error ("Invalid value for URL option '" + name + "'");
+
+  return true;
+}
+
 } // namespace mypp
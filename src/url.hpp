@@ -103,6 +103,14 @@ public:
     return mit->second;
   }
 
+  /**
+   * Parses the value of an option as unsigned integer.  Returns false if
+   * the option is not present, and throws mypp::Error if its value is
+   * not a valid unsigned integer.
+   */
+  bool GetUnsignedOption (const std::string& name,
+                          unsigned long long& value) const;
+
 };
 
 } // namespace mypp
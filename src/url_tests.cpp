@@ -63,6 +63,23 @@ TEST_F (UrlTests, Options)
   EXPECT_EQ (p.GetOption (""), "");
 }
 
+TEST_F (UrlTests, UnsignedOptions)
+{
+  p.Parse ("mysql://a:b@c.d:0/x?num=42&neg=-1&text=abc&space= 1&empty=");
+
+  unsigned long long val = 5;
+  EXPECT_FALSE (p.GetUnsignedOption ("missing", val));
+  EXPECT_EQ (val, 5);
+
+  ASSERT_TRUE (p.GetUnsignedOption ("num", val));
+  EXPECT_EQ (val, 42);
+
+  EXPECT_THROW (p.GetUnsignedOption ("neg", val), Error);
+  EXPECT_THROW (p.GetUnsignedOption ("text", val), Error);
+  EXPECT_THROW (p.GetUnsignedOption ("space", val), Error);
+  EXPECT_THROW (p.GetUnsignedOption ("empty", val), Error);
+}
+
 TEST_F (UrlTests, Invalid)
 {
   EXPECT_THROW (p.Parse ("domob:pwd@example.com:123/database"), Error);